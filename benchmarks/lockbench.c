@@ -0,0 +1,244 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Measure the acquisition latency of a contended mutex, and how
+ * often lockers have to enter the core, optionally with the
+ * adaptive spinning mode enabled.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <error.h>
+#include <evl/evl.h>
+#include <evl/mutex.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+
+#define short_optlist "n:s:c:T:P:"
+
+static const struct option options[] = {
+	{
+		.name = "threads",
+		.has_arg = required_argument,
+		.val = 'n'
+	},
+	{
+		.name = "spin",
+		.has_arg = required_argument,
+		.val = 's'
+	},
+	{
+		.name = "cs-time",
+		.has_arg = required_argument,
+		.val = 'c'
+	},
+	{
+		.name = "timeout",
+		.has_arg = required_argument,
+		.val = 'T'
+	},
+	{
+		.name = "priority",
+		.has_arg = required_argument,
+		.val = 'P'
+	},
+	{ /* Sentinel */ }
+};
+
+static int nrthreads = 2;
+
+static unsigned int spin_ns;
+
+static unsigned int cs_ns = 500;
+
+static int duration = 5;
+
+static int prio = 90;
+
+static struct evl_mutex lock;
+
+static volatile bool done;
+
+struct locker_stats {
+	pthread_t tid;
+	int cpu;
+	long long count;
+	long long sum_ns;
+	long long min_ns;
+	long long max_ns;
+	struct evl_thread_state state;
+};
+
+static inline long long get_ns(void)
+{
+	struct timespec now;
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void *locker(void *arg)
+{
+	struct locker_stats *st = arg;
+	struct sched_param param;
+	long long t0, t1, delta;
+	cpu_set_t affinity;
+	int ret, tfd;
+
+	CPU_ZERO(&affinity);
+	CPU_SET(st->cpu, &affinity);
+	ret = sched_setaffinity(0, sizeof(affinity), &affinity);
+	if (ret)
+		error(1, errno, "sched_setaffinity(%d)", st->cpu);
+
+	param.sched_priority = prio;
+	ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (ret)
+		error(1, ret, "pthread_setschedparam()");
+
+	tfd = evl_attach_self("lockbench:%d.%d", getpid(), st->cpu);
+	if (tfd < 0)
+		error(1, -tfd, "evl_attach_self()");
+
+	st->min_ns = -1ULL >> 1;
+
+	while (!done) {
+		t0 = get_ns();
+		ret = evl_lock_mutex(&lock);
+		if (ret)
+			error(1, -ret, "evl_lock_mutex()");
+		t1 = get_ns();
+		/* Simulate a short critical section. */
+		while (get_ns() - t1 < cs_ns)
+			;
+		evl_unlock_mutex(&lock);
+		delta = t1 - t0;
+		if (delta < st->min_ns)
+			st->min_ns = delta;
+		if (delta > st->max_ns)
+			st->max_ns = delta;
+		st->sum_ns += delta;
+		st->count++;
+	}
+
+	ret = evl_get_state(tfd, &st->state);
+	if (ret)
+		error(1, -ret, "evl_get_state()");
+
+	return NULL;
+}
+
+static void usage(void)
+{
+        fprintf(stderr, "usage: lockbench [options]:\n");
+        fprintf(stderr, "-n --threads=<n>        number of contending threads [=2]\n");
+        fprintf(stderr, "-s --spin=<ns>          adaptive spinning time, 0 disables [=0]\n");
+        fprintf(stderr, "-c --cs-time=<ns>       duration of the critical section [=500]\n");
+        fprintf(stderr, "-T --timeout=<s>        duration of the test [=5]\n");
+        fprintf(stderr, "-P --priority=<prio>    thread priority [=90]\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	long long count = 0, sum = 0, sc = 0, csw = 0;
+	struct locker_stats *stats, *st;
+	int c, n, ret, ncpus;
+
+	opterr = 0;
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_optlist, options, NULL);
+		if (c == EOF)
+			break;
+
+		switch (c) {
+		case 'n':
+			nrthreads = atoi(optarg);
+			if (nrthreads < 2)
+				error(1, EINVAL, "at least two threads needed");
+			break;
+		case 's':
+			spin_ns = atoi(optarg);
+			break;
+		case 'c':
+			cs_ns = atoi(optarg);
+			break;
+		case 'T':
+			duration = atoi(optarg);
+			break;
+		case 'P':
+			prio = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+
+	ret = evl_init();
+	if (ret)
+		error(1, -ret, "evl_init()");
+
+	ret = evl_create_mutex(&lock, EVL_CLOCK_MONOTONIC, 0,
+			spin_ns ? EVL_MUTEX_ADAPTIVE : EVL_MUTEX_NORMAL,
+			"lockbench:%d", getpid());
+	if (ret < 0)
+		error(1, -ret, "evl_create_mutex()");
+
+	if (spin_ns)
+		evl_set_mutex_spin(&lock, spin_ns);
+
+	stats = calloc(nrthreads, sizeof(*stats));
+	if (stats == NULL)
+		error(1, ENOMEM, "calloc");
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (n = 0; n < nrthreads; n++) {
+		st = stats + n;
+		st->cpu = n % ncpus;
+		ret = pthread_create(&st->tid, NULL, locker, st);
+		if (ret)
+			error(1, ret, "pthread_create()");
+	}
+
+	sleep(duration);
+	done = true;
+
+	printf("%-6s %-4s %12s %10s %10s %10s %10s %10s\n",
+		"THREAD", "CPU", "LOCKS", "MIN(ns)", "AVG(ns)", "MAX(ns)",
+		"SYSCALLS", "CTXSW");
+
+	for (n = 0; n < nrthreads; n++) {
+		st = stats + n;
+		pthread_join(st->tid, NULL);
+		printf("%-6d %-4d %12lld %10lld %10lld %10lld %10d %10d\n",
+			n, st->cpu, st->count, st->min_ns,
+			st->count ? st->sum_ns / st->count : 0,
+			st->max_ns, st->state.sc, st->state.csw);
+		count += st->count;
+		sum += st->sum_ns;
+		sc += st->state.sc;
+		csw += st->state.csw;
+	}
+
+	printf("\n%lld locks/s, avg latency %lld ns, "
+		"%.2f core entries, %.2f context switches per 1000 locks "
+		"(spin=%u ns)\n",
+		count / duration, count ? sum / count : 0,
+		count ? sc * 1000.0 / count : 0.0,
+		count ? csw * 1000.0 / count : 0.0, spin_ns);
+
+	evl_close_mutex(&lock);
+
+	return 0;
+}
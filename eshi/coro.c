@@ -0,0 +1,7 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#define __evl_sem_fd(__sem)	((__sem)->active.fd)
+
+#include "../lib/coro.c"
@@ -4,8 +4,11 @@
  * Copyright (C) 2019 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <stdlib.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
+#include <evl/compiler.h>
 #include <evl/event.h>
 #include <sys/eventfd.h>
 #include "internal.h"
@@ -13,9 +16,17 @@
 #define __EVENT_ACTIVE_MAGIC	0xef55ef55
 #define __EVENT_DEAD_MAGIC	0
 
-int evl_create_event(struct evl_event *evt, int clockfd, int flags,
-		const char *fmt, ...)
+/* State of a public event, shared between processes. */
+struct shared_event {
+	struct eshi_shm shm;
+	pthread_cond_t cond;
+};
+
+static int create_event(struct evl_event *evt, int clockfd,
+			const char *name)
 {
+	struct shared_event *shared = NULL;
+	struct eshi_shm *shm = NULL;
 	pthread_condattr_t attr;
 	int ret, fd;
 
@@ -30,36 +41,174 @@ int evl_create_event(struct evl_event *evt, int clockfd, int flags,
 	if (fd < 0)
 		return -errno;
 
+	if (name) {
+		ret = eshi_new_shm(EVL_MONITOR_DEV, name, sizeof(*shared),
+				-clockfd, &shm);
+		if (ret) {
+			close(fd);
+			return ret;
+		}
+		shared = container_of(shm, struct shared_event, shm);
+		evt->active.cond = &shared->cond;
+	} else {
+		evt->active.cond = &evt->active.local;
+	}
+
 	pthread_condattr_init(&attr);
-	pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_PRIVATE);
+	pthread_condattr_setpshared(&attr, shared ? PTHREAD_PROCESS_SHARED :
+				PTHREAD_PROCESS_PRIVATE);
 	pthread_condattr_setclock(&attr, -clockfd);
-	ret = pthread_cond_init(&evt->active.cond, &attr);
+	ret = pthread_cond_init(evt->active.cond, &attr);
 	pthread_condattr_destroy(&attr);
 	if (ret) {
+		if (shm)
+			eshi_put_shm(shm, true, NULL);
 		close(fd);
 		return -ret;
 	}
 
+	if (shared)
+		eshi_publish_shm(shm, __EVENT_ACTIVE_MAGIC);
+
+	evt->active.shm = shm;
+	evt->active.creator = 1;
+	evt->active.fd = fd;
+
+	return fd;
+}
+
+int evl_create_event(struct evl_event *evt, int clockfd, int flags,
+		const char *fmt, ...)
+{
+	char *name;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = eshi_get_public_name(flags, &name, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = create_event(evt, clockfd, name);
+	free(name);
+	if (ret >= 0)
+		evt->magic = __EVENT_ACTIVE_MAGIC;
+
+	return ret;
+}
+
+struct event_vec_args {
+	int clockfd;
+	int flags;
+};
+
+static int create_event_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct event_vec_args *args = arg;
+
+	return evl_create_event(element, args->clockfd, args->flags,
+			name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_event_member(void *element)
+{
+	return evl_close_event(element);
+}
+
+/*
+ * Create @nr events at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_event_vec(struct evl_event *evts, int nr,
+		int clockfd, int flags,
+		const char *fmt, ...)
+{
+	struct event_vec_args args = {
+		.clockfd = clockfd,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(evts, sizeof(*evts), nr,
+			create_event_member, close_event_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+int evl_open_event(struct evl_event *evt, const char *fmt, ...)
+{
+	struct eshi_shm *shm;
+	va_list ap;
+	int ret, fd;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	fd = eventfd(0, EFD_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	va_start(ap, fmt);
+	ret = eshi_open_shm(EVL_MONITOR_DEV, __EVENT_ACTIVE_MAGIC,
+			sizeof(struct shared_event), &shm, fmt, ap);
+	va_end(ap);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	evt->active.cond = &container_of(shm, struct shared_event, shm)->cond;
+	evt->active.shm = shm;
+	evt->active.creator = 0;
 	evt->active.fd = fd;
 	evt->magic = __EVENT_ACTIVE_MAGIC;
 
 	return fd;
 }
 
+/*
+ * Created in place, restoring the static settings on error. The
+ * magic word is left to init_static_element().
+ */
+static int create_static_event(void *element)
+{
+	struct evl_event *evt = element;
+	typeof(evt->uninit) uninit = evt->uninit;
+	char *name;
+	int ret;
+
+	ret = eshi_get_static_name(uninit.flags, &name, uninit.name);
+	if (ret)
+		return ret;
+
+	ret = create_event(evt, uninit.clockfd, name);
+	free(name);
+	if (ret < 0) {
+		evt->uninit = uninit;
+		return ret;
+	}
+
+	return 0;
+}
+
+int init_static_event(void *element)
+{
+	return init_static_element(element, __EVENT_UNINIT_MAGIC,
+				__EVENT_ACTIVE_MAGIC, create_static_event);
+}
+
 static int check_sanity(struct evl_event *evt)
 {
-	int ret = 0, fd;
-
-	if (evt->magic == __EVENT_UNINIT_MAGIC) {
-		fd = evl_create_event(evt,
-				evt->uninit.clockfd,
-				evt->uninit.flags,
-				evt->uninit.name);
-		return fd < 0 ? fd : 0;
-	} else if (evt->magic != __EVENT_ACTIVE_MAGIC)
-		return -EINVAL;
+	if (evt->magic != __EVENT_ACTIVE_MAGIC)
+		return init_static_event(evt);
 
-	return ret;
+	return 0;
 }
 
 int evl_wait_event(struct evl_event *evt, struct evl_mutex *mutex)
@@ -73,8 +222,9 @@ int evl_wait_event(struct evl_event *evt, struct evl_mutex *mutex)
 	if (ret)
 		return ret;
 
-	return -pthread_cond_wait(&evt->active.cond,
-				&mutex->active.mutex);
+	return eshi_mutex_status(mutex->active.lock,
+			pthread_cond_wait(evt->active.cond,
+					mutex->active.lock));
 }
 
 int evl_timedwait_event(struct evl_event *evt,
@@ -90,8 +240,9 @@ int evl_timedwait_event(struct evl_event *evt,
 	if (ret)
 		return ret;
 
-	return -pthread_cond_timedwait(&evt->active.cond,
-				&mutex->active.mutex, timeout);
+	return eshi_mutex_status(mutex->active.lock,
+			pthread_cond_timedwait(evt->active.cond,
+					mutex->active.lock, timeout));
 }
 
 int evl_signal_event(struct evl_event *evt)
@@ -102,7 +253,7 @@ int evl_signal_event(struct evl_event *evt)
 	if (ret)
 		return ret;
 
-	return -pthread_cond_signal(&evt->active.cond);
+	return -pthread_cond_signal(evt->active.cond);
 }
 
 int evl_broadcast_event(struct evl_event *evt)
@@ -113,7 +264,14 @@ int evl_broadcast_event(struct evl_event *evt)
 	if (ret)
 		return ret;
 
-	return -pthread_cond_broadcast(&evt->active.cond);
+	return -pthread_cond_broadcast(evt->active.cond);
+}
+
+static void destroy_shared_event(struct eshi_shm *shm)
+{
+	struct shared_event *shared = container_of(shm, struct shared_event, shm);
+
+	pthread_cond_destroy(&shared->cond);
 }
 
 int evl_close_event(struct evl_event *evt)
@@ -127,5 +285,11 @@ int evl_close_event(struct evl_event *evt)
 	close(evt->active.fd);
 	evt->magic = __EVENT_DEAD_MAGIC;
 
-	return -pthread_cond_destroy(&evt->active.cond);
+	if (evt->active.shm) {
+		eshi_put_shm(evt->active.shm, evt->active.creator,
+			destroy_shared_event);
+		return 0;
+	}
+
+	return -pthread_cond_destroy(evt->active.cond);
 }
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <evl/atomic.h>
+#include "internal.h"
+
+/*
+ * A two-level table mapping file descriptors to pointers. Chunks
+ * are allocated on demand and never released, so that lookups
+ * only involve a couple of loads and no lock. Updates of a given
+ * entry must be serialized by the caller.
+ */
+void *eshi_fdtable_get(struct eshi_fdtable *table, int fd)
+{
+	void **chunk;
+
+	if (fd < 0 || fd >= ESHI_FDTABLE_MAX)
+		return NULL;
+
+	chunk = atomic_load(&table->chunks[fd >> ESHI_FDTABLE_SHIFT]);
+	if (chunk == NULL)
+		return NULL;
+
+	return atomic_load(&chunk[fd & (ESHI_FDTABLE_CHUNK - 1)]);
+}
+
+int eshi_fdtable_set(struct eshi_fdtable *table, int fd, void *ptr)
+{
+	void **chunk, ***slot;
+
+	if (fd < 0 || fd >= ESHI_FDTABLE_MAX)
+		return -EMFILE;
+
+	slot = &table->chunks[fd >> ESHI_FDTABLE_SHIFT];
+	chunk = atomic_load(slot);
+	if (chunk == NULL) {
+		if (ptr == NULL)
+			return 0;
+		chunk = calloc(ESHI_FDTABLE_CHUNK, sizeof(void *));
+		if (chunk == NULL)
+			return -ENOMEM;
+		if (!__sync_bool_compare_and_swap(slot, NULL, chunk)) {
+			free(chunk);
+			chunk = atomic_load(slot);
+		}
+	}
+
+	/* Publish the content of *ptr before the pointer itself. */
+	smp_mb();
+	atomic_store(&chunk[fd & (ESHI_FDTABLE_CHUNK - 1)], ptr);
+
+	return 0;
+}
+
+/* Only for a single-threaded caller, e.g. the child of fork(). */
+void eshi_fdtable_clear(struct eshi_fdtable *table)
+{
+	int n;
+
+	for (n = 0; n < ESHI_FDTABLE_MAX / ESHI_FDTABLE_CHUNK; n++) {
+		if (table->chunks[n])
+			memset(table->chunks[n], 0,
+				ESHI_FDTABLE_CHUNK * sizeof(void *));
+	}
+}
@@ -5,11 +5,17 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
 #include <evl/flags.h>
 #include <sys/eventfd.h>
 #include "internal.h"
@@ -17,34 +23,239 @@
 #define __FLAGS_ACTIVE_MAGIC	0xb42bb42b
 #define __FLAGS_DEAD_MAGIC	0
 
-int evl_create_flags(struct evl_flags *flg, int clockfd,
-		int initval, int flags,
-		const char *fmt, ...)
+/*
+ * The bits always live in the state word. Once the group is polled,
+ * the eventfd is kept readable while bits are pending: posters
+ * raising the value from zero signal it, waiters observing a zero
+ * value drain it, then check the value again in case a poster
+ * slipped in meanwhile. Readiness may be spurious for a short while,
+ * it cannot be missed.
+ */
+static void signal_flags(struct evl_flags *flg)
+{
+	uint64_t val = 1;
+	int ret;
+
+	ret = write(flg->active.fd, &val, sizeof(val));
+	(void)ret;
+}
+
+static void drain_flags(struct evl_flags *flg)
+{
+	uint64_t val;
+	int ret;
+
+	ret = read(flg->active.fd, &val, sizeof(val));
+	(void)ret;
+	smp_mb();
+	if (atomic_load(&flg->active.state->value))
+		signal_flags(flg);
+}
+
+/*
+ * Called when the group is added to a poll set. Public groups
+ * cannot be polled, since other processes would not signal our
+ * eventfd.
+ */
+static int arm_flags(void *element)
+{
+	struct evl_flags *flg = element;
+
+	if (flg->active.shm)
+		return -EOPNOTSUPP;
+
+	if (atomic_load(&flg->active.polled))
+		return flg->active.fd;
+
+	atomic_store(&flg->active.polled, 1);
+	smp_mb();
+	if (atomic_load(&flg->active.state->value))
+		signal_flags(flg);
+
+	return flg->active.fd;
+}
+
+/* State of a public flag group, shared between processes. */
+struct shared_flags {
+	struct eshi_shm shm;
+	struct evl_flags_state state;
+};
+
+static inline struct evl_flags_state *shared_flags_state(struct eshi_shm *shm)
+{
+	return &container_of(shm, struct shared_flags, shm)->state;
+}
+
+static int init_flags(struct evl_flags *flg, struct eshi_shm *shm,
+		clockid_t clock, bool creator)
+{
+	int fd, ret;
+
+	/*
+	 * The eventfd only tells pollers about pending bits, it is
+	 * otherwise the handle of the element.
+	 */
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0)
+		return -errno;
+
+	ret = eshi_register_pollable(fd, arm_flags, flg, false);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	if (shm)
+		flg->active.state = shared_flags_state(shm);
+	else
+		flg->active.state = &flg->active.local;
+
+	flg->active.shm = shm;
+	flg->active.creator = creator;
+	flg->active.clock = clock;
+	flg->active.fd = fd;
+	flg->active.polled = 0;
+
+	return fd;
+}
+
+static int create_flags(struct evl_flags *flg, int clockfd,
+			int initval, const char *name)
 {
-	int fd;
+	struct evl_flags_state *state = &flg->active.local;
+	struct eshi_shm *shm = NULL;
+	clockid_t clock;
+	int ret;
 
 	if (!eshi_is_initialized())
 		return -ENXIO;
 
 	switch (clockfd) {
 	case EVL_CLOCK_MONOTONIC:
-		flg->active.clock = CLOCK_MONOTONIC;
+		clock = CLOCK_MONOTONIC;
 		break;
 	case EVL_CLOCK_REALTIME:
-		flg->active.clock = CLOCK_REALTIME;
+		clock = CLOCK_REALTIME;
 		break;
 	default:
 		return -EINVAL;
 	}
 
-	fd = eventfd(initval, EFD_CLOEXEC | EFD_NONBLOCK);
-	if (fd < 0)
-		return -errno;
+	if (name) {
+		ret = eshi_new_shm(EVL_MONITOR_DEV, name,
+				sizeof(struct shared_flags), clock, &shm);
+		if (ret)
+			return ret;
+		state = shared_flags_state(shm);
+	}
 
-	flg->active.fd = fd;
-	flg->magic = __FLAGS_ACTIVE_MAGIC;
+	state->value = initval;
+	state->seq = 0;
+	state->waiters = 0;
 
-	return fd;
+	ret = init_flags(flg, shm, clock, true);
+	if (ret < 0) {
+		if (shm)
+			eshi_put_shm(shm, true, NULL);
+		return ret;
+	}
+
+	if (shm)
+		eshi_publish_shm(shm, __FLAGS_ACTIVE_MAGIC);
+
+	return ret;
+}
+
+int evl_create_flags(struct evl_flags *flg, int clockfd,
+		int initval, int flags,
+		const char *fmt, ...)
+{
+	char *name;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = eshi_get_public_name(flags, &name, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = create_flags(flg, clockfd, initval, name);
+	free(name);
+	if (ret >= 0)
+		flg->magic = __FLAGS_ACTIVE_MAGIC;
+
+	return ret;
+}
+
+struct flags_vec_args {
+	int clockfd;
+	int initval;
+	int flags;
+};
+
+static int create_flags_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct flags_vec_args *args = arg;
+
+	return evl_create_flags(element, args->clockfd, args->initval,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_flags_member(void *element)
+{
+	return evl_close_flags(element);
+}
+
+/*
+ * Create @nr flag groups at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_flags_vec(struct evl_flags *flgs, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...)
+{
+	struct flags_vec_args args = {
+		.clockfd = clockfd,
+		.initval = initval,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(flgs, sizeof(*flgs), nr,
+			create_flags_member, close_flags_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+int evl_open_flags(struct evl_flags *flg, const char *fmt, ...)
+{
+	struct eshi_shm *shm;
+	va_list ap;
+	int ret;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	va_start(ap, fmt);
+	ret = eshi_open_shm(EVL_MONITOR_DEV, __FLAGS_ACTIVE_MAGIC,
+			sizeof(struct shared_flags), &shm, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = init_flags(flg, shm, shm->clock, false);
+	if (ret < 0)
+		eshi_put_shm(shm, false, NULL);
+	else
+		flg->magic = __FLAGS_ACTIVE_MAGIC;
+
+	return ret;
 }
 
 int evl_close_flags(struct evl_flags *flg)
@@ -55,77 +266,126 @@ int evl_close_flags(struct evl_flags *flg)
 	if (flg->magic != __FLAGS_ACTIVE_MAGIC)
 		return -EINVAL;
 
+	eshi_unregister_pollable(flg->active.fd, flg);
 	close(flg->active.fd);
 	flg->magic = __FLAGS_DEAD_MAGIC;
 
+	if (flg->active.shm)
+		eshi_put_shm(flg->active.shm, flg->active.creator, NULL);
+
 	return 0;
 }
 
-static int check_sanity(struct evl_flags *flg)
+/*
+ * Created in place, restoring the static settings on error. The
+ * magic word is left to init_static_element().
+ */
+static int create_static_flags(void *element)
 {
-	int efd;
+	struct evl_flags *flg = element;
+	typeof(flg->uninit) uninit = flg->uninit;
+	char *name;
+	int ret;
 
-	if (flg->magic == __FLAGS_UNINIT_MAGIC) {
-		efd = evl_create_flags(flg,
-				flg->uninit.clockfd,
-				flg->uninit.initval,
-				flg->uninit.flags,
-				flg->uninit.name);
-		return efd < 0 ? efd : 0;
+	ret = eshi_get_static_name(uninit.flags, &name, uninit.name);
+	if (ret)
+		return ret;
+
+	ret = create_flags(flg, uninit.clockfd, uninit.initval, name);
+	free(name);
+	if (ret < 0) {
+		flg->uninit = uninit;
+		return ret;
 	}
 
-	return flg->magic != __FLAGS_ACTIVE_MAGIC ? -EINVAL : 0;
+	return 0;
 }
 
-static int timedwait_flags(struct evl_flags *flg,
-			const struct timespec *timeout,
-			int *r_bits)
+int init_static_flags(void *element)
 {
-	const struct timespec *tp = timeout;
-	struct timespec ts, now;
-	struct pollfd pollfd;
-	uint64_t val;
-	int ret;
+	return init_static_element(element, __FLAGS_UNINIT_MAGIC,
+				__FLAGS_ACTIVE_MAGIC, create_static_flags);
+}
+
+static int check_sanity(struct evl_flags *flg)
+{
+	if (flg->magic != __FLAGS_ACTIVE_MAGIC)
+		return init_static_flags(flg);
+
+	return 0;
+}
+
+static inline bool flags_match(int val, int mask, int mode)
+{
+	int match = val & mask;
+
+	return match && (mode == EVL_FLAGS_ANY || match == mask);
+}
 
-	if (!tp || (tp->tv_sec == 0 && tp->tv_nsec == 0))
-		goto poll;
+/* Consume the bits of @mask which are set if they match @mode. */
+static int take_flags(struct evl_flags *flg, int mask, int mode,
+		int *r_bits)
+{
+	int val, ret;
 
 	for (;;) {
-		if (tp) {
-			clock_gettime(flg->active.clock, &now);
-			ts = *timeout;
-			timespec_sub(&ts, &now);
-			if (ts.tv_sec < 0) {
-				ts.tv_sec = 0;
-				ts.tv_nsec = 0;
-			}
-			tp = &ts;
+		val = atomic_load(&flg->active.state->value);
+		if (!flags_match(val, mask, mode)) {
+			ret = -EAGAIN;
+			break;
 		}
-	poll:
-		pollfd.fd = flg->active.fd;
-		pollfd.events = POLLIN;
-		pollfd.revents = 0;
-		ret = ppoll(&pollfd, 1, tp, NULL);
-		if (ret < 0)
-			return -errno;
-
-		if (ret == 0)
+		if (__sync_bool_compare_and_swap(&flg->active.state->value,
+							val, val & ~mask)) {
+			*r_bits = val & mask;
+			val &= ~mask;
+			ret = 0;
 			break;
+		}
+	}
 
-		if (!(pollfd.revents & POLLIN))
-			return -EINVAL;
+	if (val == 0 && atomic_load(&flg->active.polled))
+		drain_flags(flg);
 
-		ret = read(flg->active.fd, &val, sizeof(val));
-		if (ret > 0) {
-			*r_bits = (unsigned int)(val & ~0);
+	return ret;
+}
+
+/*
+ * A flag group runs from userland only, waiters sleep on the
+ * sequence futex which posters bump when someone waits, until the
+ * bits they asked for are pending. Since every waiter may be
+ * interested in different bits, all of them are woken up. A zero
+ * timeout means non-blocking.
+ */
+static int timedwait_flags(struct evl_flags *flg,
+			int mask, int mode,
+			const struct timespec *timeout,
+			int *r_bits)
+{
+	int ret, seq;
+
+	if (!mask || (mode != EVL_FLAGS_ANY && mode != EVL_FLAGS_ALL))
+		return -EINVAL;
+
+	for (;;) {
+		if (!take_flags(flg, mask, mode, r_bits))
 			return 0;
-		}
 
-		if (errno != -EAGAIN)
-			return -errno;
+		if (timeout && timeout->tv_sec == 0 && timeout->tv_nsec == 0)
+			return -ETIMEDOUT;
+
+		seq = atomic_load(&flg->active.state->seq);
+		__sync_add_and_fetch(&flg->active.state->waiters, 1);
+		if (flags_match(atomic_load(&flg->active.state->value),
+					mask, mode))
+			ret = 0;
+		else
+			ret = eshi_futex_wait(&flg->active.state->seq, seq,
+					flg->active.clock, timeout,
+					flg->active.shm != NULL);
+		__sync_sub_and_fetch(&flg->active.state->waiters, 1);
+		if (ret && ret != -EAGAIN)
+			return ret;
 	}
-
-	return -ETIMEDOUT;
 }
 
 int evl_timedwait_flags(struct evl_flags *flg,
@@ -144,7 +404,7 @@ int evl_timedwait_flags(struct evl_flags *flg,
 	if (ret)
 		return ret;
 
-	return timedwait_flags(flg, timeout, r_bits);
+	return timedwait_flags(flg, -1, EVL_FLAGS_ANY, timeout, r_bits);
 }
 
 int evl_wait_flags(struct evl_flags *flg, int *r_bits)
@@ -155,7 +415,7 @@ int evl_wait_flags(struct evl_flags *flg, int *r_bits)
 	if (ret)
 		return ret;
 
-	return timedwait_flags(flg, NULL, r_bits);
+	return timedwait_flags(flg, -1, EVL_FLAGS_ANY, NULL, r_bits);
 }
 
 int evl_trywait_flags(struct evl_flags *flg, int *r_bits)
@@ -167,7 +427,7 @@ int evl_trywait_flags(struct evl_flags *flg, int *r_bits)
 	if (ret)
 		return ret;
 
-	ret = timedwait_flags(flg, &zerotime, r_bits);
+	ret = timedwait_flags(flg, -1, EVL_FLAGS_ANY, &zerotime, r_bits);
 	if (ret == -ETIMEDOUT)
 		return -EAGAIN;
 
@@ -176,16 +436,39 @@ int evl_trywait_flags(struct evl_flags *flg, int *r_bits)
 
 int evl_post_flags(struct evl_flags *flg, int bits)
 {
-	uint64_t val = (uint64_t)(unsigned int)bits;
-	int ret;
+	int ret, prev;
 
 	ret = check_sanity(flg);
 	if (ret)
 		return ret;
 
-	ret = write(flg->active.fd, &val, sizeof(val));
-	if (ret != sizeof(val))
-		return -errno;
+	prev = __sync_fetch_and_or(&flg->active.state->value, bits);
+	if (prev == 0 && atomic_load(&flg->active.polled))
+		signal_flags(flg);
+
+	if (atomic_load(&flg->active.state->waiters)) {
+		__sync_add_and_fetch(&flg->active.state->seq, 1);
+		eshi_futex_wake(&flg->active.state->seq, INT_MAX,
+				flg->active.shm != NULL);
+	}
 
 	return 0;
 }
+
+/* Non-blocking only, like with libevl. */
+int evl_trywait_flags_mask(struct evl_flags *flg,
+			int mask, int mode, int *r_bits)
+{
+	struct timespec zerotime = { .tv_sec = 0, .tv_nsec = 0};
+	int ret;
+
+	ret = check_sanity(flg);
+	if (ret)
+		return ret;
+
+	ret = timedwait_flags(flg, mask, mode, &zerotime, r_bits);
+	if (ret == -ETIMEDOUT)
+		return -EAGAIN;
+
+	return ret;
+}
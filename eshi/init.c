@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <evl/evl.h>
 #include "internal.h"
 
@@ -14,14 +15,23 @@ static pthread_once_t init_once = PTHREAD_ONCE_INIT;
 
 static int init_status = -ENXIO;
 
+int eshi_nr_cpus = 1;
+
 static void atfork_handler(void)
 {
 	init_once = PTHREAD_ONCE_INIT;
 	init_status = 0;
+	eshi_reset_threads();
 }
 
 static inline int do_init(void)
 {
+	long ret;
+
+	ret = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ret > 0)
+		eshi_nr_cpus = ret;
+
 	pthread_atfork(NULL, NULL, atfork_handler);
 
 	return eshi_init_threads();
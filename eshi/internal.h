@@ -8,9 +8,15 @@
 #define _EVL_ESHI_INTERNAL_H
 
 #include <stdbool.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <time.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 /* Enable dlopen() on libeshi.so. */
 #define EVL_TLS_MODEL	"global-dynamic"
@@ -49,10 +55,133 @@ void timespec_mono_to_real(struct timespec *r, const struct timespec *t)
 	timespec_add(r, &now);
 }
 
+/*
+ * Wait on a futex as long as it reads @val, until the absolute
+ * @timeout based on @clock, or indefinitely if NULL. @pshared tells
+ * whether the futex may live in memory shared between processes.
+ */
+static inline
+int eshi_futex_wait(int *addr, int val, clockid_t clock,
+		const struct timespec *timeout, bool pshared)
+{
+	int op = FUTEX_WAIT_BITSET, ret;
+
+	if (!pshared)
+		op |= FUTEX_PRIVATE_FLAG;
+
+	if (clock == CLOCK_REALTIME)
+		op |= FUTEX_CLOCK_REALTIME;
+
+	ret = syscall(SYS_futex, addr, op, val, timeout,
+		NULL, FUTEX_BITSET_MATCH_ANY);
+
+	return ret ? -errno : 0;
+}
+
+static inline
+void eshi_futex_wake(int *addr, int nr, bool pshared)
+{
+	syscall(SYS_futex, addr,
+		pshared ? FUTEX_WAKE : FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
+		nr, NULL, NULL, 0);
+}
+
+/*
+ * Robust mutexes report the death of their previous owner, which we
+ * silently recover from since the core would have released the lock
+ * on behalf of the exiting thread.
+ */
+static inline
+int eshi_mutex_status(pthread_mutex_t *lock, int ret)
+{
+	if (ret == EOWNERDEAD) {
+		pthread_mutex_consistent(lock);
+		ret = 0;
+	}
+
+	return -ret;
+}
+
+/*
+ * Public elements live in named shared memory objects, which start
+ * with this header. The magic word is published last by the creator,
+ * once the element is fully initialized.
+ */
+struct eshi_shm {
+	unsigned int magic;
+	int refs;
+	size_t size;
+	clockid_t clock;
+	char path[NAME_MAX + 1];
+};
+
+int eshi_get_public_name(int clone_flags, char **pname,
+			const char *fmt, va_list ap);
+
+int eshi_get_static_name(int clone_flags, char **pname,
+			const char *name);
+
+int eshi_new_shm(const char *type, const char *name,
+		size_t size, clockid_t clock,
+		struct eshi_shm **pshm);
+
+void eshi_publish_shm(struct eshi_shm *shm, unsigned int magic);
+
+int eshi_open_shm(const char *type, unsigned int magic,
+		size_t size, struct eshi_shm **pshm,
+		const char *fmt, va_list ap);
+
+void eshi_put_shm(struct eshi_shm *shm, bool creator,
+		void (*destroy)(struct eshi_shm *shm));
+
+#define ESHI_FDTABLE_SHIFT	10
+#define ESHI_FDTABLE_CHUNK	(1 << ESHI_FDTABLE_SHIFT)
+#define ESHI_FDTABLE_MAX	(1 << 20)
+
+struct eshi_fdtable {
+	void **chunks[ESHI_FDTABLE_MAX / ESHI_FDTABLE_CHUNK];
+};
+
+void *eshi_fdtable_get(struct eshi_fdtable *table, int fd);
+
+int eshi_fdtable_set(struct eshi_fdtable *table, int fd, void *ptr);
+
+void eshi_fdtable_clear(struct eshi_fdtable *table);
+
 pthread_t eshi_find_thread_by_fd(int fd);
 
+int eshi_register_pollable(int fd, int (*arm)(void *element),
+			void *element, bool rebind);
+
+void eshi_unregister_pollable(int fd, void *element);
+
 int eshi_init_threads(void);
 
+void eshi_reset_threads(void);
+
 bool eshi_is_initialized(void);
 
+extern int eshi_nr_cpus;
+
+int create_element_vec(void *elements, size_t size, int nr,
+		int (*create)(void *element, const char *name,
+			int index, void *arg),
+		int (*close)(void *element),
+		void *arg, const char *fmt, va_list ap);
+
+int init_static_element(void *element,
+			unsigned int uninit_magic,
+			unsigned int active_magic,
+			int (*init)(void *element));
+
+int init_static_mutex(void *element);
+
+int init_static_event(void *element);
+
+int init_static_sem(void *element);
+
+int init_static_flags(void *element);
+
+int init_static_rwlock(void *element);
+
 #endif /* _EVL_ESHI_INTERNAL_H */
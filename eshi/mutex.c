@@ -4,19 +4,75 @@
  * Copyright (C) 2019 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <stdlib.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
+#include <evl/compiler.h>
 #include <evl/mutex.h>
 #include <sys/eventfd.h>
+#include <asm/evl/processor.h>
 #include "internal.h"
 
 #define __MUTEX_ACTIVE_MAGIC	0xab12ab12
 #define __MUTEX_DEAD_MAGIC	0
 
+/* State of a public mutex, shared between processes. */
+struct shared_mutex {
+	struct eshi_shm shm;
+	pthread_mutex_t mutex;
+};
+
+/*
+ * glibc only spins on adaptive mutexes which do not enforce a
+ * priority protocol, so we spin on trylock by ourselves instead,
+ * keeping priority inheritance. Like with libevl, this is pointless
+ * on uniprocessor systems, and not available to priority-protected
+ * mutexes.
+ */
+static void set_spin(struct evl_mutex *mutex, unsigned int ceiling,
+		unsigned int spin_ns)
+{
+	if (ceiling || eshi_nr_cpus < 2)
+		spin_ns = 0;
+
+	mutex->active.spin_ns = spin_ns;
+}
+
+static int spin_lock(struct evl_mutex *mutex)
+{
+	struct timespec now, deadline, delay;
+	int ret, n = 0;
+
+	delay.tv_sec = mutex->active.spin_ns / 1000000000;
+	delay.tv_nsec = mutex->active.spin_ns % 1000000000;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	timespec_add(&deadline, &delay);
+
+	for (;;) {
+		ret = pthread_mutex_trylock(mutex->active.lock);
+		if (ret != EBUSY)
+			return eshi_mutex_status(mutex->active.lock, ret);
+		cpu_relax();
+		if ((++n & 15) == 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec > deadline.tv_sec ||
+				(now.tv_sec == deadline.tv_sec &&
+					now.tv_nsec >= deadline.tv_nsec))
+				break;
+		}
+	}
+
+	return -EBUSY;
+}
+
 static int create_mutex(struct evl_mutex *mutex, int clockfd,
-			unsigned int ceiling, int flags)
+			unsigned int ceiling, int flags,
+			const char *name)
 {
+	struct shared_mutex *shared = NULL;
 	int ret, fd, protocol, ptype;
+	struct eshi_shm *shm = NULL;
 	pthread_mutexattr_t attr;
 
 	if (!eshi_is_initialized())
@@ -42,6 +98,19 @@ static int create_mutex(struct evl_mutex *mutex, int clockfd,
 	if (fd < 0)
 		return -errno;
 
+	if (name) {
+		ret = eshi_new_shm(EVL_MONITOR_DEV, name, sizeof(*shared),
+				mutex->active.clock, &shm);
+		if (ret) {
+			close(fd);
+			return ret;
+		}
+		shared = container_of(shm, struct shared_mutex, shm);
+		mutex->active.lock = &shared->mutex;
+	} else {
+		mutex->active.lock = &mutex->active.local;
+	}
+
 	pthread_mutexattr_init(&attr);
 	pthread_mutexattr_settype(&attr, ptype);
 	protocol = PTHREAD_PRIO_INHERIT;
@@ -50,49 +119,192 @@ static int create_mutex(struct evl_mutex *mutex, int clockfd,
 		pthread_mutexattr_setprioceiling(&attr, ceiling);
 	}
 	ret = pthread_mutexattr_setprotocol(&attr, protocol);
-	if (ret) {
-		pthread_mutexattr_destroy(&attr);
-		close(fd);
-		return -ret;
+	if (ret)
+		goto fail;
+
+	/*
+	 * A public mutex may outlive its owner, have it robust so
+	 * that a process crashing with the lock held cannot hang the
+	 * others. glibc does not support this with priority ceiling.
+	 */
+	if (shared) {
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		if (!ceiling)
+			pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	} else {
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_PRIVATE);
 	}
 
-	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_PRIVATE);
-	ret = pthread_mutex_init(&mutex->active.mutex, &attr);
+	ret = pthread_mutex_init(mutex->active.lock, &attr);
+	if (ret)
+		goto fail;
+
 	pthread_mutexattr_destroy(&attr);
-	if (ret) {
-		close(fd);
-		return -ret;
-	}
 
+	if (shared)
+		eshi_publish_shm(shm, __MUTEX_ACTIVE_MAGIC);
+
+	mutex->active.shm = shm;
+	mutex->active.creator = 1;
 	mutex->active.fd = fd;
-	mutex->magic = __MUTEX_ACTIVE_MAGIC;
+	mutex->active.spin_ns = 0;
+	if (flags & EVL_MUTEX_ADAPTIVE)
+		set_spin(mutex, ceiling, EVL_MUTEX_SPIN_NS);
 
 	return 0;
+fail:
+	pthread_mutexattr_destroy(&attr);
+	if (shm)
+		eshi_put_shm(shm, true, NULL);
+	close(fd);
+
+	return -ret;
 }
 
 int evl_create_mutex(struct evl_mutex *mutex,
 		int clockfd, unsigned int ceiling,
 		int flags, const char *fmt, ...)
 {
-	return create_mutex(mutex, clockfd, ceiling, flags) ?:
-		mutex->active.fd;
+	char *name;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = eshi_get_public_name(flags, &name, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = create_mutex(mutex, clockfd, ceiling, flags, name);
+	free(name);
+	if (ret)
+		return ret;
+
+	mutex->magic = __MUTEX_ACTIVE_MAGIC;
+
+	return mutex->active.fd;
 }
 
-static int check_sanity(struct evl_mutex *mutex)
+struct mutex_vec_args {
+	int clockfd;
+	unsigned int ceiling;
+	int flags;
+};
+
+static int create_mutex_member(void *element, const char *name,
+			int index, void *arg)
 {
-	int ret = 0;
+	struct mutex_vec_args *args = arg;
 
-	if (mutex->magic == __MUTEX_UNINIT_MAGIC)
-		ret = create_mutex(mutex,
-				mutex->uninit.clockfd,
-				mutex->uninit.ceiling,
-				mutex->uninit.flags);
-	else if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
-		return -EINVAL;
+	return evl_create_mutex(element, args->clockfd, args->ceiling,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_mutex_member(void *element)
+{
+	return evl_close_mutex(element);
+}
+
+/*
+ * Create @nr mutexes at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_mutex_vec(struct evl_mutex *mutexes, int nr,
+		int clockfd, unsigned int ceiling, int flags,
+		const char *fmt, ...)
+{
+	struct mutex_vec_args args = {
+		.clockfd = clockfd,
+		.ceiling = ceiling,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(mutexes, sizeof(*mutexes), nr,
+			create_mutex_member, close_mutex_member,
+			&args, fmt, ap);
+	va_end(ap);
 
 	return ret;
 }
 
+int evl_open_mutex(struct evl_mutex *mutex, const char *fmt, ...)
+{
+	struct eshi_shm *shm;
+	va_list ap;
+	int ret, fd;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	fd = eventfd(1, EFD_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	va_start(ap, fmt);
+	ret = eshi_open_shm(EVL_MONITOR_DEV, __MUTEX_ACTIVE_MAGIC,
+			sizeof(struct shared_mutex), &shm, fmt, ap);
+	va_end(ap);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	mutex->active.lock = &container_of(shm, struct shared_mutex, shm)->mutex;
+	mutex->active.shm = shm;
+	mutex->active.creator = 0;
+	mutex->active.clock = shm->clock;
+	mutex->active.fd = fd;
+	mutex->magic = __MUTEX_ACTIVE_MAGIC;
+
+	return fd;
+}
+
+/*
+ * Created in place, restoring the static settings on error. The
+ * magic word is left to init_static_element().
+ */
+static int create_static_mutex(void *element)
+{
+	struct evl_mutex *mutex = element;
+	typeof(mutex->uninit) uninit = mutex->uninit;
+	char *name;
+	int ret;
+
+	ret = eshi_get_static_name(uninit.flags, &name, uninit.name);
+	if (ret)
+		return ret;
+
+	ret = create_mutex(mutex, uninit.clockfd,
+			uninit.ceiling, uninit.flags, name);
+	free(name);
+	if (ret) {
+		mutex->uninit = uninit;
+		return ret;
+	}
+
+	if (mutex->active.spin_ns && uninit.spin_ns)
+		set_spin(mutex, uninit.ceiling, uninit.spin_ns);
+
+	return 0;
+}
+
+int init_static_mutex(void *element)
+{
+	return init_static_element(element, __MUTEX_UNINIT_MAGIC,
+				__MUTEX_ACTIVE_MAGIC, create_static_mutex);
+}
+
+static int check_sanity(struct evl_mutex *mutex)
+{
+	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
+		return init_static_mutex(mutex);
+
+	return 0;
+}
+
 int evl_lock_mutex(struct evl_mutex *mutex)
 {
 	int ret;
@@ -101,7 +313,14 @@ int evl_lock_mutex(struct evl_mutex *mutex)
 	if (ret)
 		return ret;
 
-	return -pthread_mutex_lock(&mutex->active.mutex);
+	if (mutex->active.spin_ns) {
+		ret = spin_lock(mutex);
+		if (ret != -EBUSY)
+			return ret;
+	}
+
+	return eshi_mutex_status(mutex->active.lock,
+				pthread_mutex_lock(mutex->active.lock));
 }
 
 int evl_timedlock_mutex(struct evl_mutex *mutex,
@@ -118,12 +337,19 @@ int evl_timedlock_mutex(struct evl_mutex *mutex,
 	if (timeout->tv_sec < 0 || timeout->tv_nsec >= 1000000000L)
 		return -EINVAL;
 
+	if (mutex->active.spin_ns) {
+		ret = spin_lock(mutex);
+		if (ret != -EBUSY)
+			return ret;
+	}
+
 	if (mutex->active.clock == CLOCK_MONOTONIC) {
 		timespec_mono_to_real(&ts, timeout);
 		tp = &ts;
 	}
 
-	return -pthread_mutex_timedlock(&mutex->active.mutex, tp);
+	return eshi_mutex_status(mutex->active.lock,
+				pthread_mutex_timedlock(mutex->active.lock, tp));
 }
 
 int evl_trylock_mutex(struct evl_mutex *mutex)
@@ -134,7 +360,8 @@ int evl_trylock_mutex(struct evl_mutex *mutex)
 	if (ret)
 		return ret;
 
-	return -pthread_mutex_trylock(&mutex->active.mutex);
+	return eshi_mutex_status(mutex->active.lock,
+				pthread_mutex_trylock(mutex->active.lock));
 }
 
 int evl_unlock_mutex(struct evl_mutex *mutex)
@@ -142,7 +369,7 @@ int evl_unlock_mutex(struct evl_mutex *mutex)
 	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
 		return -EINVAL;
 
-	return -pthread_mutex_unlock(&mutex->active.mutex);
+	return -pthread_mutex_unlock(mutex->active.lock);
 }
 
 int evl_set_mutex_ceiling(struct evl_mutex *mutex,
@@ -163,7 +390,7 @@ int evl_set_mutex_ceiling(struct evl_mutex *mutex,
 	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
 		return -EINVAL;
 
-	return -pthread_mutex_setprioceiling(&mutex->active.mutex,
+	return -pthread_mutex_setprioceiling(mutex->active.lock,
 					ceiling, &old);
 }
 
@@ -177,13 +404,43 @@ int evl_get_mutex_ceiling(struct evl_mutex *mutex)
 	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
 		return -EINVAL;
 
-	ret = pthread_mutex_getprioceiling(&mutex->active.mutex, &ceiling);
+	ret = pthread_mutex_getprioceiling(mutex->active.lock, &ceiling);
 	if (ret)
 		return ret == EINVAL ? 0 : -ret;
 
 	return ceiling;
 }
 
+int evl_set_mutex_spin(struct evl_mutex *mutex,
+		unsigned int spin_ns)
+{
+	int ceiling;
+
+	if (mutex->magic == __MUTEX_UNINIT_MAGIC) {
+		if (spin_ns)
+			mutex->uninit.flags |= EVL_MUTEX_ADAPTIVE;
+		else
+			mutex->uninit.flags &= ~EVL_MUTEX_ADAPTIVE;
+		mutex->uninit.spin_ns = spin_ns;
+		return 0;
+	}
+
+	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	ceiling = evl_get_mutex_ceiling(mutex);
+	set_spin(mutex, ceiling > 0, spin_ns);
+
+	return 0;
+}
+
+static void destroy_shared_mutex(struct eshi_shm *shm)
+{
+	struct shared_mutex *shared = container_of(shm, struct shared_mutex, shm);
+
+	pthread_mutex_destroy(&shared->mutex);
+}
+
 int evl_close_mutex(struct evl_mutex *mutex)
 {
 	if (mutex->magic == __MUTEX_UNINIT_MAGIC)
@@ -195,5 +452,11 @@ int evl_close_mutex(struct evl_mutex *mutex)
 	close(mutex->active.fd);
 	mutex->magic = __MUTEX_DEAD_MAGIC;
 
-	return -pthread_mutex_destroy(&mutex->active.mutex);
+	if (mutex->active.shm) {
+		eshi_put_shm(mutex->active.shm, mutex->active.creator,
+			destroy_shared_mutex);
+		return 0;
+	}
+
+	return -pthread_mutex_destroy(mutex->active.lock);
 }
@@ -0,0 +1,626 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/thread.h>
+#include <evl/observable.h>
+#include "internal.h"
+
+/*
+ * Each observer receives notifications into a ring of its own. The
+ * producer side is serialized by the lock of the observable, the
+ * only consumer is the subscribed thread, so no lock is needed to
+ * read. The eventfd is written to only when the observer sleeps,
+ * unless it was added to a poll set, in which case it counts the
+ * pending notifications from then on.
+ */
+struct eshi_observer {
+	struct eshi_observable *obs;
+	struct eshi_observer *next;	/* In the observable's list */
+	struct eshi_observer *next_sub;	/* In the thread's subscriptions */
+	int efd;
+	int flags;
+	unsigned int size;
+	unsigned int head;
+	unsigned int tail;
+	int waiting;
+	int polled;
+	bool has_last;
+	struct evl_notice last;
+	struct evl_notification ring[];
+};
+
+/*
+ * The observable fd is one end of a socket pair, we keep the other
+ * end in order to detect when the application closes the former.
+ * The table entry and observers hold a reference on the observable,
+ * so do callers for the duration of a request.
+ */
+struct eshi_observable {
+	int fd;
+	int peerfd;
+	int flags;
+	int refs;
+	uint32_t serial;
+	pthread_mutex_t lock;
+	struct eshi_observer *observers;
+	struct eshi_observer *next_master;
+	struct eshi_observable *next_live;
+};
+
+static struct eshi_fdtable observables;
+
+static struct eshi_observable *live_observables;
+
+static pthread_mutex_t observable_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t subscription_key;
+
+static pthread_once_t subscription_once = PTHREAD_ONCE_INIT;
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+struct eshi_observer *subscriptions;
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+pid_t current_tid;
+
+static void put_observable(struct eshi_observable *obs)
+{
+	if (__sync_sub_and_fetch(&obs->refs, 1))
+		return;
+
+	close(obs->peerfd);
+	pthread_mutex_destroy(&obs->lock);
+	free(obs);
+}
+
+/*
+ * Our end of the socket pair hangs up once the application closed
+ * the observable, its fd may refer to another file from then on.
+ */
+static bool observable_closed(struct eshi_observable *obs)
+{
+	struct pollfd pollfd;
+
+	pollfd.fd = obs->peerfd;
+	pollfd.events = 0;
+	pollfd.revents = 0;
+
+	return poll(&pollfd, 1, 0) > 0 &&
+		(pollfd.revents & (POLLHUP|POLLERR));
+}
+
+/* Drop the table reference on a closed observable, observable_lock held. */
+static void release_observable(struct eshi_observable *obs)
+{
+	struct eshi_observable **pp;
+
+	for (pp = &live_observables; *pp; pp = &(*pp)->next_live) {
+		if (*pp == obs) {
+			*pp = obs->next_live;
+			break;
+		}
+	}
+
+	if (eshi_fdtable_get(&observables, obs->fd) == obs)
+		eshi_fdtable_set(&observables, obs->fd, NULL);
+
+	eshi_unregister_pollable(obs->fd, obs);
+	put_observable(obs);
+}
+
+/* Release the observables the application closed, observable_lock held. */
+static void reap_observables(void)
+{
+	struct eshi_observable *obs, *next;
+
+	for (obs = live_observables; obs; obs = next) {
+		next = obs->next_live;
+		if (observable_closed(obs))
+			release_observable(obs);
+	}
+}
+
+/*
+ * Look up the observable @ofd refers to, getting a reference on it.
+ * We find out about a closed observable here at the latest.
+ */
+static struct eshi_observable *get_observable(int ofd)
+{
+	struct eshi_observable *obs;
+
+	pthread_mutex_lock(&observable_lock);
+
+	obs = eshi_fdtable_get(&observables, ofd);
+	if (obs) {
+		if (observable_closed(obs)) {
+			release_observable(obs);
+			obs = NULL;
+		} else {
+			__sync_add_and_fetch(&obs->refs, 1);
+		}
+	}
+
+	pthread_mutex_unlock(&observable_lock);
+
+	return obs;
+}
+
+static struct eshi_observer *find_observer(struct eshi_observable *obs)
+{
+	struct eshi_observer *o;
+
+	for (o = subscriptions; o; o = o->next_sub)
+		if (o->obs == obs)
+			return o;
+
+	return NULL;
+}
+
+/*
+ * Called when the observable is added to a poll set: have the
+ * caller's observer count the pending notifications in its eventfd,
+ * which is what epoll should monitor. Non-subscribers can only wait
+ * for POLLOUT, which is always set.
+ */
+static int arm_observable(void *element)
+{
+	struct eshi_observable *obs = element;
+	struct eshi_observer *o;
+	uint64_t val;
+
+	o = find_observer(obs);
+	if (o == NULL)
+		return obs->fd;
+
+	pthread_mutex_lock(&obs->lock);
+
+	if (!o->polled) {
+		/* Drop stale wake-ups. */
+		while (read(o->efd, &val, sizeof(val)) > 0)
+			;
+		o->polled = 1;
+		val = o->tail - o->head;
+		if (val > 0 && write(o->efd, &val, sizeof(val)) != sizeof(val))
+			o->polled = 0;
+	}
+
+	pthread_mutex_unlock(&obs->lock);
+
+	return o->efd;
+}
+
+int evl_create_observable(int flags, const char *fmt, ...)
+{
+	struct eshi_observable *obs, *old;
+	int sv[2], type, ret;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	obs = calloc(1, sizeof(*obs));
+	if (obs == NULL)
+		return -ENOMEM;
+
+	type = SOCK_STREAM | SOCK_CLOEXEC;
+	if (flags & EVL_CLONE_NONBLOCK)
+		type |= SOCK_NONBLOCK;
+
+	if (socketpair(AF_UNIX, type, 0, sv)) {
+		ret = -errno;
+		goto fail_socket;
+	}
+
+	obs->fd = sv[0];
+	obs->peerfd = sv[1];
+	obs->flags = flags;
+	obs->refs = 1;
+	pthread_mutex_init(&obs->lock, NULL);
+
+	ret = eshi_register_pollable(obs->fd, arm_observable, obs, true);
+	if (ret)
+		goto fail_register;
+
+	/*
+	 * A former observable on the same fd was closed by the
+	 * application, release it along with any other closed one.
+	 */
+	pthread_mutex_lock(&observable_lock);
+	reap_observables();
+	old = eshi_fdtable_get(&observables, obs->fd);
+	if (old)
+		release_observable(old);
+	ret = eshi_fdtable_set(&observables, obs->fd, obs);
+	if (ret == 0) {
+		obs->next_live = live_observables;
+		live_observables = obs;
+	}
+	pthread_mutex_unlock(&observable_lock);
+	if (ret)
+		goto fail_table;
+
+	return obs->fd;
+
+fail_table:
+	eshi_unregister_pollable(obs->fd, obs);
+fail_register:
+	pthread_mutex_destroy(&obs->lock);
+	close(sv[0]);
+	close(sv[1]);
+fail_socket:
+	free(obs);
+
+	return ret;
+}
+
+static pid_t get_current_tid(void)
+{
+	if (current_tid == 0)
+		current_tid = syscall(SYS_gettid);
+
+	return current_tid;
+}
+
+static bool push_notification(struct eshi_observer *o,
+			const struct evl_notification *nf)
+{
+	unsigned int tail = o->tail;
+	uint64_t one = 1;
+	ssize_t ret __maybe_unused;
+
+	if ((o->flags & EVL_NOTIFY_ONCHANGE) && o->has_last &&
+		o->last.tag == nf->tag &&
+		o->last.event.lval == nf->event.lval)
+		return true;
+
+	if (tail - atomic_load(&o->head) >= o->size)
+		return false;
+
+	o->ring[tail % o->size] = *nf;
+	smp_mb();
+	atomic_store(&o->tail, tail + 1);
+	smp_mb();
+
+	o->has_last = true;
+	o->last.tag = nf->tag;
+	o->last.event = nf->event;
+
+	if (atomic_load(&o->polled) || atomic_load(&o->waiting))
+		ret = write(o->efd, &one, sizeof(one));
+
+	return true;
+}
+
+/* Round-robin between the observers with room for a notification. */
+static bool notify_master(struct eshi_observable *obs,
+			const struct evl_notification *nf)
+{
+	struct eshi_observer *start, *o, *next;
+
+	start = obs->next_master ?: obs->observers;
+	if (start == NULL)
+		return false;
+
+	o = start;
+	do {
+		next = o->next ?: obs->observers;
+		if (push_notification(o, nf)) {
+			obs->next_master = next;
+			return true;
+		}
+		o = next;
+	} while (o != start);
+
+	return false;
+}
+
+static bool notify_all(struct eshi_observable *obs,
+		const struct evl_notification *nf)
+{
+	struct eshi_observer *o;
+	bool delivered = false;
+
+	for (o = obs->observers; o; o = o->next)
+		delivered |= push_notification(o, nf);
+
+	return delivered;
+}
+
+/*
+ * Returns the number of notices at least one observer received,
+ * zero if all observers lacked room.
+ */
+int evl_update_observable(int ofd, const struct evl_notice *ntc, int nr)
+{
+	struct eshi_observable *obs;
+	struct evl_notification nf;
+	bool delivered;
+	int n, count = 0;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	for (n = 0; n < nr; n++)
+		if (ntc[n].tag < EVL_NOTICE_USER)
+			return -EINVAL;
+
+	obs = get_observable(ofd);
+	if (obs == NULL)
+		return -EBADF;
+
+	nf.issuer = get_current_tid();
+	clock_gettime(CLOCK_MONOTONIC, &nf.date);
+
+	pthread_mutex_lock(&obs->lock);
+
+	for (n = 0; n < nr; n++) {
+		nf.tag = ntc[n].tag;
+		nf.event = ntc[n].event;
+		nf.serial = obs->serial++;
+		if (obs->flags & EVL_CLONE_MASTER)
+			delivered = notify_master(obs, &nf);
+		else
+			delivered = notify_all(obs, &nf);
+		if (delivered)
+			count++;
+	}
+
+	pthread_mutex_unlock(&obs->lock);
+	put_observable(obs);
+
+	return count;
+}
+
+/*
+ * Once polled, a notification may be picked only after a unit was
+ * consumed from the eventfd, so that the count it has never exceeds
+ * the ring content.
+ */
+static int fetch_notifications(struct eshi_observer *o,
+			struct evl_notification *nf, int nr)
+{
+	unsigned int head = o->head, tail;
+	uint64_t val;
+	int n;
+
+	if (!atomic_load(&o->polled)) {
+		tail = atomic_load(&o->tail);
+		smp_mb();
+		for (n = 0; n < nr && head != tail; n++, head++)
+			nf[n] = o->ring[head % o->size];
+	} else {
+		for (n = 0; n < nr; n++, head++) {
+			if (read(o->efd, &val, sizeof(val)) != sizeof(val))
+				break;
+			smp_mb();
+			nf[n] = o->ring[head % o->size];
+		}
+	}
+
+	smp_mb();
+	atomic_store(&o->head, head);
+
+	return n;
+}
+
+static int wait_notifications(struct eshi_observer *o)
+{
+	struct eshi_observable *obs = o->obs;
+	struct pollfd pollfd[2];
+	uint64_t val;
+	int ret;
+
+	ret = fcntl(obs->fd, F_GETFL);
+	if (ret < 0)
+		return -errno;
+
+	if (ret & O_NONBLOCK)
+		return -EAGAIN;
+
+	atomic_store(&o->waiting, 1);
+	smp_mb();
+
+	if (atomic_load(&o->tail) != o->head) {
+		atomic_store(&o->waiting, 0);
+		return 0;
+	}
+
+	pollfd[0].fd = o->efd;
+	pollfd[0].events = POLLIN;
+	pollfd[0].revents = 0;
+	pollfd[1].fd = obs->peerfd;
+	pollfd[1].events = POLLIN;
+	pollfd[1].revents = 0;
+	ret = poll(pollfd, 2, -1);
+	atomic_store(&o->waiting, 0);
+	if (ret < 0)
+		return -errno;
+
+	if (pollfd[1].revents & (POLLHUP|POLLERR))
+		return -EBADF;
+
+	/* Consume the wake-up, unless the count is ours to keep. */
+	if (!atomic_load(&o->polled) && (pollfd[0].revents & POLLIN))
+		ret = read(o->efd, &val, sizeof(val));
+
+	return 0;
+}
+
+int evl_read_observable(int ofd, struct evl_notification *nf, int nr)
+{
+	struct eshi_observable *obs;
+	struct eshi_observer *o;
+	int ret;
+
+	if (nr <= 0)
+		return -EINVAL;
+
+	obs = get_observable(ofd);
+	if (obs == NULL)
+		return -EBADF;
+
+	/* Our subscription holds a reference on the observable. */
+	o = find_observer(obs);
+	put_observable(obs);
+	if (o == NULL)
+		return -ENXIO;
+
+	for (;;) {
+		ret = fetch_notifications(o, nf, nr);
+		if (ret > 0)
+			return ret;
+		ret = wait_notifications(o);
+		if (ret)
+			return ret;
+	}
+}
+
+static void drop_observer(struct eshi_observer *o)
+{
+	struct eshi_observable *obs = o->obs;
+	struct eshi_observer **pp;
+
+	pthread_mutex_lock(&obs->lock);
+
+	for (pp = &obs->observers; *pp; pp = &(*pp)->next) {
+		if (*pp == o) {
+			*pp = o->next;
+			break;
+		}
+	}
+
+	if (obs->next_master == o)
+		obs->next_master = o->next;
+
+	pthread_mutex_unlock(&obs->lock);
+
+	close(o->efd);
+	put_observable(obs);
+	free(o);
+}
+
+/* Drop the subscriptions left by an exiting thread. */
+static void drop_subscriptions(void *arg)
+{
+	struct eshi_observer *o = arg, *next;
+
+	while (o) {
+		next = o->next_sub;
+		drop_observer(o);
+		o = next;
+	}
+
+	subscriptions = NULL;
+}
+
+static void init_subscription_key(void)
+{
+	pthread_key_create(&subscription_key, drop_subscriptions);
+}
+
+int evl_subscribe(int ofd, unsigned int backlog_count, int flags)
+{
+	struct eshi_observable *obs;
+	struct eshi_observer *o, **pp;
+	int ret;
+
+	if (backlog_count == 0 || (flags & ~EVL_NOTIFY_MASK))
+		return -EINVAL;
+
+	obs = get_observable(ofd);
+	if (obs == NULL)
+		return -EPERM;
+
+	if (find_observer(obs)) {
+		ret = -EBUSY;
+		goto fail;
+	}
+
+	pthread_once(&subscription_once, init_subscription_key);
+
+	o = calloc(1, sizeof(*o) + backlog_count * sizeof(o->ring[0]));
+	if (o == NULL) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	o->efd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+	if (o->efd < 0) {
+		ret = -errno;
+		free(o);
+		goto fail;
+	}
+
+	/* The observer inherits our reference. */
+	o->obs = obs;
+	o->flags = flags;
+	o->size = backlog_count;
+
+	/* Keep the subscription order, master mode depends on it. */
+	pthread_mutex_lock(&obs->lock);
+	for (pp = &obs->observers; *pp; pp = &(*pp)->next)
+		;
+	*pp = o;
+	pthread_mutex_unlock(&obs->lock);
+
+	o->next_sub = subscriptions;
+	subscriptions = o;
+	pthread_setspecific(subscription_key, subscriptions);
+
+	return 0;
+fail:
+	put_observable(obs);
+
+	return ret;
+}
+
+int evl_unsubscribe(int ofd)
+{
+	struct eshi_observer *o, **pp;
+	struct eshi_observable *obs;
+
+	/*
+	 * A subscription to a closed observable can still be dropped,
+	 * it keeps the observable alive until then.
+	 */
+	obs = get_observable(ofd);
+
+	for (pp = &subscriptions; (o = *pp) != NULL; pp = &o->next_sub) {
+		if (obs ? o->obs == obs :
+			o->obs->fd == ofd && observable_closed(o->obs)) {
+			*pp = o->next_sub;
+			break;
+		}
+	}
+
+	if (o) {
+		pthread_setspecific(subscription_key, subscriptions);
+		drop_observer(o);
+	}
+
+	if (obs)
+		put_observable(obs);
+
+	/* The observable might have been closed meanwhile. */
+	if (fcntl(ofd, F_GETFD) < 0)
+		return -errno;
+
+	if (obs == NULL)
+		return o ? -EBADF : -EPERM;
+
+	return o ? 0 : -ENOENT;
+}
@@ -4,75 +4,404 @@
  * Copyright (C) 2019 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <stdbool.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/epoll.h>
+#include <evl/atomic.h>
 #include <evl/poll.h>
 #include "internal.h"
 
+/*
+ * Elements which run from userland until they are polled, indexed
+ * by file descriptor. Adding such element to a poll set arms it,
+ * i.e. has it keep its eventfd in sync from then on. The arm
+ * handler returns the file descriptor epoll should actually
+ * monitor on behalf of the caller, which may depend on the calling
+ * thread if @rebind is set.
+ */
+struct eshi_pollable {
+	int (*arm)(void *element);
+	void *element;
+	bool rebind;
+};
+
+static struct eshi_pollable *pollables;
+
+static int nr_pollables;
+
+static pthread_mutex_t pollable_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Registrations of a poll set, indexed by file descriptor. epoll
+ * only gives us the fd back, the pollval comes from here.
+ */
+struct eshi_pollreg {
+	bool active;
+	bool rebind;
+	int realfd;
+	unsigned int events;
+	union evl_value pollval;
+};
+
+struct eshi_pollset {
+	struct eshi_pollreg *regs;
+	int nr_regs;
+	int nr_rebinds;
+};
+
+/* Indexed by poll fd. */
+static struct eshi_pollset *pollsets;
+
+static int nr_pollsets;
+
+static pthread_rwlock_t pollset_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Number of registrations to rebind, all poll sets included. */
+static int nr_rebinds;
+
+/*
+ * Use a fast stack-based array for monitoring a small number of
+ * events, a per-thread buffer which only grows otherwise.
+ */
+#define FAST_EVENT_NR  8
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+struct epoll_event *poll_events;
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+int nr_poll_events;
+
+static pthread_key_t poll_events_key;
+
+static pthread_once_t poll_events_once = PTHREAD_ONCE_INIT;
+
+/* Make sure @index is valid in a table, zeroing new entries. */
+static int expand_table(void **ptable, int *pnr, size_t size, int index)
+{
+	void *table;
+	int nr;
+
+	if (index < *pnr)
+		return 0;
+
+	nr = *pnr ? *pnr : 64;
+	while (nr <= index)
+		nr *= 2;
+
+	table = realloc(*ptable, nr * size);
+	if (table == NULL)
+		return -ENOMEM;
+
+	memset((char *)table + *pnr * size, 0, (nr - *pnr) * size);
+	*ptable = table;
+	*pnr = nr;
+
+	return 0;
+}
+
+int eshi_register_pollable(int fd, int (*arm)(void *element),
+			void *element, bool rebind)
+{
+	int ret;
+
+	pthread_mutex_lock(&pollable_lock);
+
+	ret = expand_table((void **)&pollables, &nr_pollables,
+			sizeof(*pollables), fd);
+	if (!ret) {
+		pollables[fd].arm = arm;
+		pollables[fd].element = element;
+		pollables[fd].rebind = rebind;
+	}
+
+	pthread_mutex_unlock(&pollable_lock);
+
+	return ret;
+}
+
+/*
+ * @fd may have been recycled for another element by now, only drop
+ * the registration if it is still @element's.
+ */
+void eshi_unregister_pollable(int fd, void *element)
+{
+	pthread_mutex_lock(&pollable_lock);
+
+	if (fd < nr_pollables && pollables[fd].element == element)
+		pollables[fd].arm = NULL;
+
+	pthread_mutex_unlock(&pollable_lock);
+}
+
+static int arm_pollable(int fd, bool *rebind)
+{
+	int realfd = fd;
+
+	pthread_mutex_lock(&pollable_lock);
+
+	*rebind = false;
+	if (fd < nr_pollables && pollables[fd].arm) {
+		realfd = pollables[fd].arm(pollables[fd].element);
+		*rebind = pollables[fd].rebind;
+	}
+
+	pthread_mutex_unlock(&pollable_lock);
+
+	return realfd;
+}
+
 int evl_new_poll(void)
 {
-	return epoll_create1(EPOLL_CLOEXEC);
+	struct eshi_pollset *pset;
+	int efd, ret;
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0)
+		return -errno;
+
+	pthread_rwlock_wrlock(&pollset_lock);
+
+	ret = expand_table((void **)&pollsets, &nr_pollsets,
+			sizeof(*pollsets), efd);
+	if (!ret) {
+		/* Drop the leftovers from a former owner of this fd. */
+		pset = pollsets + efd;
+		free(pset->regs);
+		pset->regs = NULL;
+		pset->nr_regs = 0;
+		__sync_sub_and_fetch(&nr_rebinds, pset->nr_rebinds);
+		pset->nr_rebinds = 0;
+	}
+
+	pthread_rwlock_unlock(&pollset_lock);
+
+	if (ret) {
+		close(efd);
+		return ret;
+	}
+
+	return efd;
 }
 
-int evl_add_pollfd(int efd, int newfd, unsigned int events,
-	union evl_value pollval)
+/* Apply an update to a poll set, pollset_lock held. */
+static int __update_pollset(int efd, int op, int fd, int realfd,
+			bool rebind, unsigned int events,
+			union evl_value pollval)
 {
+	struct eshi_pollreg *reg;
+	struct eshi_pollset *pset;
 	struct epoll_event ev;
 	int ret;
 
-	if (efd == newfd)
-		return -ELOOP;
+	ret = expand_table((void **)&pollsets, &nr_pollsets,
+			sizeof(*pollsets), efd);
+	if (ret)
+		return ret;
+
+	pset = pollsets + efd;
+	ret = expand_table((void **)&pset->regs, &pset->nr_regs,
+			sizeof(*pset->regs), fd);
+	if (ret)
+		return ret;
+
+	reg = pset->regs + fd;
+	if (op != EPOLL_CTL_ADD && reg->active)
+		realfd = reg->realfd;
 
 	ev.events = events;
-	ev.data.fd = newfd;
+	ev.data.fd = fd;
 
-	ret = epoll_ctl(efd, EPOLL_CTL_ADD, newfd, &ev);
+	ret = epoll_ctl(efd, op, realfd, op == EPOLL_CTL_DEL ? NULL : &ev);
 	if (ret)
 		return -errno;
 
+	if (op == EPOLL_CTL_ADD && rebind) {
+		reg->rebind = true;
+		pset->nr_rebinds++;
+		__sync_add_and_fetch(&nr_rebinds, 1);
+	} else if (op == EPOLL_CTL_DEL && reg->rebind) {
+		reg->rebind = false;
+		pset->nr_rebinds--;
+		__sync_sub_and_fetch(&nr_rebinds, 1);
+	}
+
+	reg->active = op != EPOLL_CTL_DEL;
+	reg->realfd = realfd;
+	reg->events = events;
+	reg->pollval = pollval;
+
 	return 0;
 }
 
-int evl_del_pollfd(int efd, int delfd)
+static int update_pollset(int efd, int op, int fd, int realfd,
+			bool rebind, unsigned int events,
+			union evl_value pollval)
 {
 	int ret;
 
-	ret = epoll_ctl(efd, EPOLL_CTL_DEL, delfd, NULL);
-	if (ret)
-		return -errno;
+	pthread_rwlock_wrlock(&pollset_lock);
+	ret = __update_pollset(efd, op, fd, realfd, rebind, events, pollval);
+	pthread_rwlock_unlock(&pollset_lock);
 
-	return 0;
+	return ret;
+}
+
+int evl_add_pollfd(int efd, int newfd, unsigned int events,
+	union evl_value pollval)
+{
+	bool rebind;
+	int realfd;
+
+	if (efd == newfd)
+		return -ELOOP;
+
+	realfd = arm_pollable(newfd, &rebind);
+	if (realfd < 0)
+		return realfd;
+
+	return update_pollset(efd, EPOLL_CTL_ADD, newfd, realfd,
+			rebind, events, pollval);
+}
+
+int evl_del_pollfd(int efd, int delfd)
+{
+	return update_pollset(efd, EPOLL_CTL_DEL, delfd, delfd,
+			false, 0, evl_nil);
 }
 
 int evl_mod_pollfd(int efd, int modfd, unsigned int events,
 	union evl_value pollval)
 {
-	struct epoll_event ev;
-	int ret;
+	return update_pollset(efd, EPOLL_CTL_MOD, modfd, modfd,
+			false, events, pollval);
+}
 
-	ev.events = events;
-	ev.data.fd = modfd;
+static int apply_ctlreq(int efd, struct evl_poll_ctlreq *req)
+{
+	int fd = req->fd, realfd;
+	bool rebind;
 
-	ret = epoll_ctl(efd, EPOLL_CTL_MOD, modfd, &ev);
-	if (ret)
-		return -errno;
+	switch (req->action) {
+	case EVL_POLL_CTLADD:
+		if (efd == fd)
+			return -ELOOP;
+		realfd = arm_pollable(fd, &rebind);
+		if (realfd < 0)
+			return realfd;
+		return __update_pollset(efd, EPOLL_CTL_ADD, fd, realfd,
+					rebind, req->events, req->pollval);
+	case EVL_POLL_CTLDEL:
+		return __update_pollset(efd, EPOLL_CTL_DEL, fd, fd,
+					false, 0, evl_nil);
+	case EVL_POLL_CTLMOD:
+		return __update_pollset(efd, EPOLL_CTL_MOD, fd, fd,
+					false, req->events, req->pollval);
+	default:
+		return -EINVAL;
+	}
+}
 
-	return 0;
+/*
+ * epoll has no vectored control call, but we can at least apply
+ * the whole batch with a single locking round.
+ */
+int evl_ctl_pollfds(int efd, struct evl_poll_ctlreq *vec,
+		int nr, int *status)
+{
+	int n, nrfail = 0;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	pthread_rwlock_wrlock(&pollset_lock);
+
+	for (n = 0; n < nr; n++) {
+		status[n] = apply_ctlreq(efd, vec + n);
+		nrfail += status[n] != 0;
+	}
+
+	pthread_rwlock_unlock(&pollset_lock);
+
+	return nrfail;
 }
 
 /*
- * Use a fast stack-based array for monitoring a small number of
- * events.
+ * Observables are readable by their subscribers only, so the fd
+ * epoll should monitor for them depends on the polling thread.
+ * Rebind such registrations to the view of the caller.
  */
-#define FAST_EVENT_NR  8
+static void rebind_pollset(int efd)
+{
+	struct eshi_pollset *pset;
+	struct eshi_pollreg *reg;
+	struct epoll_event ev;
+	int fd, realfd;
+	bool rebind;
+
+	pthread_rwlock_wrlock(&pollset_lock);
+
+	if (efd >= nr_pollsets || pollsets[efd].nr_rebinds == 0)
+		goto out;
+
+	pset = pollsets + efd;
+	for (fd = 0; fd < pset->nr_regs; fd++) {
+		reg = pset->regs + fd;
+		if (!reg->active || !reg->rebind)
+			continue;
+		realfd = arm_pollable(fd, &rebind);
+		if (realfd < 0 || realfd == reg->realfd)
+			continue;
+		ev.events = reg->events;
+		ev.data.fd = fd;
+		epoll_ctl(efd, EPOLL_CTL_DEL, reg->realfd, NULL);
+		if (!epoll_ctl(efd, EPOLL_CTL_ADD, realfd, &ev))
+			reg->realfd = realfd;
+	}
+out:
+	pthread_rwlock_unlock(&pollset_lock);
+}
+
+static void free_poll_events(void *p)
+{
+	free(p);
+}
+
+static void init_poll_events_key(void)
+{
+	pthread_key_create(&poll_events_key, free_poll_events);
+}
+
+static struct epoll_event *get_poll_events(int nr)
+{
+	struct epoll_event *evs;
+
+	if (nr <= nr_poll_events)
+		return poll_events;
+
+	pthread_once(&poll_events_once, init_poll_events_key);
+
+	evs = realloc(poll_events, sizeof(*evs) * nr);
+	if (evs == NULL)
+		return NULL;
+
+	poll_events = evs;
+	nr_poll_events = nr;
+	pthread_setspecific(poll_events_key, evs);
+
+	return evs;
+}
 
 static int do_timedpoll(int efd, struct evl_poll_event *pollset,
 			int nrset, int msecs)
 {
 	struct epoll_event fast_evs[FAST_EVENT_NR], *evs = fast_evs;
-	int ret, n;
+	struct eshi_pollset *pset;
+	int ret, n, fd;
 
 	if (nrset == 0)
 		return 0;
@@ -81,29 +410,36 @@ static int do_timedpoll(int efd, struct evl_poll_event *pollset,
 		return -EINVAL;
 
 	if (nrset > FAST_EVENT_NR) {
-		evs = malloc(sizeof(*evs) * nrset);
+		evs = get_poll_events(nrset);
 		if (evs == NULL)
 			return -ENOMEM;
 	}
 
+	if (atomic_load(&nr_rebinds))
+		rebind_pollset(efd);
+
 	ret = epoll_wait(efd, evs, nrset, msecs);
-	if (ret < 0) {
-		ret = -errno;
-		goto out;
-	}
+	if (ret < 0)
+		return -errno;
 
-	if (ret == 0) {
-		ret = -ETIMEDOUT;
-		goto out;
-	}
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	pthread_rwlock_rdlock(&pollset_lock);
 
-	for (n = 0; n < nrset; n++) {
-		pollset[n].fd = evs[n].data.fd;
+	pset = efd < nr_pollsets ? pollsets + efd : NULL;
+
+	for (n = 0; n < ret; n++) {
+		fd = evs[n].data.fd;
+		pollset[n].fd = fd;
 		pollset[n].events = evs[n].events;
+		if (pset && fd < pset->nr_regs)
+			pollset[n].pollval = pset->regs[fd].pollval;
+		else
+			pollset[n].pollval = evl_nil;
 	}
-out:
-	if (evs != fast_evs)
-		free(evs);
+
+	pthread_rwlock_unlock(&pollset_lock);
 
 	return ret;
 }
@@ -111,12 +447,26 @@ out:
 int evl_timedpoll(int efd, struct evl_poll_event *pollset,
 		int nrset, struct timespec *timeout)
 {
-	int msecs;
+	struct timespec ts, now;
+	int msecs = 0;
 
 	if (timeout->tv_sec < 0 || timeout->tv_nsec >= 1000000000L)
 		return -EINVAL;
 
-	msecs = timeout->tv_sec * 1000 + timeout->tv_nsec / 1000000;
+	/*
+	 * Like libevl, the timeout is an absolute date, a zero date
+	 * means wait indefinitely, a past one means no wait.
+	 */
+	if (timeout->tv_sec == 0 && timeout->tv_nsec == 0)
+		return do_timedpoll(efd, pollset, nrset, -1);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ts = *timeout;
+	timespec_sub(&ts, &now);
+	if (ts.tv_sec >= INT_MAX / 1000)
+		msecs = INT_MAX;
+	else if (ts.tv_sec >= 0)
+		msecs = ts.tv_sec * 1000 + (ts.tv_nsec + 999999) / 1000000;
 
 	return do_timedpoll(efd, pollset, nrset, msecs);
 }
@@ -0,0 +1,252 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <evl/rwlock.h>
+#include <sys/eventfd.h>
+#include "internal.h"
+
+#define __RWLOCK_ACTIVE_MAGIC	0x7a1d7a1d
+#define __RWLOCK_DEAD_MAGIC	0
+
+/*
+ * glibc has no PI support for rwlocks, we can only get the writer
+ * preference right.
+ */
+static int create_rwlock(struct evl_rwlock *rwlock, int clockfd)
+{
+	pthread_rwlockattr_t attr;
+	int ret, fd;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	switch (clockfd) {
+	case EVL_CLOCK_MONOTONIC:
+		rwlock->active.clock = CLOCK_MONOTONIC;
+		break;
+	case EVL_CLOCK_REALTIME:
+		rwlock->active.clock = CLOCK_REALTIME;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	fd = eventfd(1, EFD_CLOEXEC); /* Set to always readable. */
+	if (fd < 0)
+		return -errno;
+
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_PRIVATE);
+	ret = pthread_rwlock_init(&rwlock->active.rwlock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	if (ret) {
+		close(fd);
+		return -ret;
+	}
+
+	rwlock->active.fd = fd;
+
+	return 0;
+}
+
+/*
+ * Like with libevl, the lock lives in the caller's memory which other
+ * processes could not share, so public mode is refused, including
+ * through a leading slash in the name.
+ */
+static int check_private(int flags, const char *name)
+{
+	if (flags & EVL_CLONE_PUBLIC)
+		return -EINVAL;
+
+	if (name && *name == '/')
+		return -EINVAL;
+
+	return 0;
+}
+
+int evl_create_rwlock(struct evl_rwlock *rwlock,
+		int clockfd, int flags,
+		const char *fmt, ...)
+{
+	char *name = NULL;
+	va_list ap;
+	int ret;
+
+	if (fmt) {
+		va_start(ap, fmt);
+		ret = vasprintf(&name, fmt, ap);
+		va_end(ap);
+		if (ret < 0)
+			return -ENOMEM;
+	}
+
+	ret = check_private(flags, name);
+	free(name);
+	if (ret)
+		return ret;
+
+	ret = create_rwlock(rwlock, clockfd);
+	if (ret)
+		return ret;
+
+	rwlock->magic = __RWLOCK_ACTIVE_MAGIC;
+
+	return rwlock->active.fd;
+}
+
+/*
+ * Created in place, restoring the static settings on error. The
+ * magic word is left to init_static_element().
+ */
+static int create_static_rwlock(void *element)
+{
+	struct evl_rwlock *rwlock = element;
+	typeof(rwlock->uninit) uninit = rwlock->uninit;
+	int ret;
+
+	ret = check_private(uninit.flags, uninit.name);
+	if (ret)
+		return ret;
+
+	ret = create_rwlock(rwlock, uninit.clockfd);
+	if (ret < 0) {
+		rwlock->uninit = uninit;
+		return ret;
+	}
+
+	return 0;
+}
+
+int init_static_rwlock(void *element)
+{
+	return init_static_element(element, __RWLOCK_UNINIT_MAGIC,
+				__RWLOCK_ACTIVE_MAGIC, create_static_rwlock);
+}
+
+static int check_sanity(struct evl_rwlock *rwlock)
+{
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return init_static_rwlock(rwlock);
+
+	return 0;
+}
+
+static int get_timeout(struct evl_rwlock *rwlock,
+		const struct timespec *timeout,
+		struct timespec *ts)
+{
+	if (timeout->tv_sec < 0 || timeout->tv_nsec >= 1000000000L)
+		return -EINVAL;
+
+	if (rwlock->active.clock == CLOCK_MONOTONIC)
+		timespec_mono_to_real(ts, timeout);
+	else
+		*ts = *timeout;
+
+	return 0;
+}
+
+int evl_rdlock_rwlock(struct evl_rwlock *rwlock)
+{
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	return -pthread_rwlock_rdlock(&rwlock->active.rwlock);
+}
+
+int evl_timedrdlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout)
+{
+	struct timespec ts;
+	int ret;
+
+	ret = check_sanity(rwlock) ?: get_timeout(rwlock, timeout, &ts);
+	if (ret)
+		return ret;
+
+	return -pthread_rwlock_timedrdlock(&rwlock->active.rwlock, &ts);
+}
+
+int evl_tryrdlock_rwlock(struct evl_rwlock *rwlock)
+{
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	ret = pthread_rwlock_tryrdlock(&rwlock->active.rwlock);
+
+	return ret == EBUSY ? -EAGAIN : -ret;
+}
+
+int evl_wrlock_rwlock(struct evl_rwlock *rwlock)
+{
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	return -pthread_rwlock_wrlock(&rwlock->active.rwlock);
+}
+
+int evl_timedwrlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout)
+{
+	struct timespec ts;
+	int ret;
+
+	ret = check_sanity(rwlock) ?: get_timeout(rwlock, timeout, &ts);
+	if (ret)
+		return ret;
+
+	return -pthread_rwlock_timedwrlock(&rwlock->active.rwlock, &ts);
+}
+
+int evl_trywrlock_rwlock(struct evl_rwlock *rwlock)
+{
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	ret = pthread_rwlock_trywrlock(&rwlock->active.rwlock);
+
+	return ret == EBUSY ? -EAGAIN : -ret;
+}
+
+int evl_unlock_rwlock(struct evl_rwlock *rwlock)
+{
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	return -pthread_rwlock_unlock(&rwlock->active.rwlock);
+}
+
+int evl_close_rwlock(struct evl_rwlock *rwlock)
+{
+	if (rwlock->magic == __RWLOCK_UNINIT_MAGIC)
+		return 0;
+
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	close(rwlock->active.fd);
+	rwlock->magic = __RWLOCK_DEAD_MAGIC;
+
+	return -pthread_rwlock_destroy(&rwlock->active.rwlock);
+}
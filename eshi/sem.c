@@ -4,10 +4,16 @@
  * Copyright (C) 2019 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <errno.h>
 #include <unistd.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
 #include <evl/sem.h>
 #include <sys/eventfd.h>
 #include "internal.h"
@@ -15,11 +21,109 @@
 #define __SEM_ACTIVE_MAGIC	0xcb13cb13
 #define __SEM_DEAD_MAGIC	0
 
-int evl_create_sem(struct evl_sem *sem, int clockfd,
-		int initval, int flags,
-		const char *fmt, ...)
+/*
+ * The count always lives in the state word. Once the semaphore is
+ * polled, the eventfd is kept readable while units are pending:
+ * posters raising the count from zero signal it, takers observing a
+ * zero count drain it, then check the count again in case a poster
+ * slipped in meanwhile. Readiness may be spurious for a short while,
+ * it cannot be missed.
+ */
+static void signal_sem(struct evl_sem *sem)
+{
+	uint64_t val = 1;
+	int ret;
+
+	ret = write(sem->active.fd, &val, sizeof(val));
+	(void)ret;
+}
+
+static void drain_sem(struct evl_sem *sem)
+{
+	uint64_t val;
+	int ret;
+
+	ret = read(sem->active.fd, &val, sizeof(val));
+	(void)ret;
+	smp_mb();
+	if (atomic_load(&sem->active.state->value) > 0)
+		signal_sem(sem);
+}
+
+/*
+ * Called when the semaphore is added to a poll set. Public
+ * semaphores cannot be polled, since other processes would not
+ * signal our eventfd.
+ */
+static int arm_sem(void *element)
+{
+	struct evl_sem *sem = element;
+
+	if (sem->active.shm)
+		return -EOPNOTSUPP;
+
+	if (atomic_load(&sem->active.polled))
+		return sem->active.fd;
+
+	atomic_store(&sem->active.polled, 1);
+	smp_mb();
+	if (atomic_load(&sem->active.state->value) > 0)
+		signal_sem(sem);
+
+	return sem->active.fd;
+}
+
+/* State of a public semaphore, shared between processes. */
+struct shared_sem {
+	struct eshi_shm shm;
+	struct evl_sem_state state;
+};
+
+static inline struct evl_sem_state *shared_sem_state(struct eshi_shm *shm)
 {
-	int fd;
+	return &container_of(shm, struct shared_sem, shm)->state;
+}
+
+static int init_sem(struct evl_sem *sem, struct eshi_shm *shm,
+		clockid_t clock, bool creator)
+{
+	int fd, ret;
+
+	/*
+	 * The eventfd only tells pollers about pending units, it is
+	 * otherwise the handle of the element.
+	 */
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	ret = eshi_register_pollable(fd, arm_sem, sem, false);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	if (shm)
+		sem->active.state = shared_sem_state(shm);
+	else
+		sem->active.state = &sem->active.local;
+
+	sem->active.shm = shm;
+	sem->active.creator = creator;
+	sem->active.clock = clock;
+	sem->active.fd = fd;
+	sem->active.polled = 0;
+
+	return fd;
+}
+
+static int create_sem(struct evl_sem *sem, int clockfd,
+		int initval, const char *name)
+{
+	struct evl_sem_state *state = &sem->active.local;
+	struct eshi_shm *shm = NULL;
+	clockid_t clock;
+	int ret;
 
 	/*
 	 *  evl_init() must have run: exclusively for proper emulation
@@ -30,23 +134,130 @@ int evl_create_sem(struct evl_sem *sem, int clockfd,
 
 	switch (clockfd) {
 	case EVL_CLOCK_MONOTONIC:
-		sem->active.clock = CLOCK_MONOTONIC;
+		clock = CLOCK_MONOTONIC;
 		break;
 	case EVL_CLOCK_REALTIME:
-		sem->active.clock = CLOCK_REALTIME;
+		clock = CLOCK_REALTIME;
 		break;
 	default:
 		return -EINVAL;
 	}
 
-	fd = eventfd(initval, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
-	if (fd < 0)
-		return -errno;
+	if (name) {
+		ret = eshi_new_shm(EVL_MONITOR_DEV, name,
+				sizeof(struct shared_sem), clock, &shm);
+		if (ret)
+			return ret;
+		state = shared_sem_state(shm);
+	}
 
-	sem->active.fd = fd;
-	sem->magic = __SEM_ACTIVE_MAGIC;
+	state->value = initval;
+	state->seq = 0;
+	state->waiters = 0;
 
-	return fd;
+	ret = init_sem(sem, shm, clock, true);
+	if (ret < 0) {
+		if (shm)
+			eshi_put_shm(shm, true, NULL);
+		return ret;
+	}
+
+	if (shm)
+		eshi_publish_shm(shm, __SEM_ACTIVE_MAGIC);
+
+	return ret;
+}
+
+int evl_create_sem(struct evl_sem *sem, int clockfd,
+		int initval, int flags,
+		const char *fmt, ...)
+{
+	char *name;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = eshi_get_public_name(flags, &name, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = create_sem(sem, clockfd, initval, name);
+	free(name);
+	if (ret >= 0)
+		sem->magic = __SEM_ACTIVE_MAGIC;
+
+	return ret;
+}
+
+struct sem_vec_args {
+	int clockfd;
+	int initval;
+	int flags;
+};
+
+static int create_sem_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct sem_vec_args *args = arg;
+
+	return evl_create_sem(element, args->clockfd, args->initval,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_sem_member(void *element)
+{
+	return evl_close_sem(element);
+}
+
+/*
+ * Create @nr semaphores at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_sem_vec(struct evl_sem *sems, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...)
+{
+	struct sem_vec_args args = {
+		.clockfd = clockfd,
+		.initval = initval,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(sems, sizeof(*sems), nr,
+			create_sem_member, close_sem_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+int evl_open_sem(struct evl_sem *sem, const char *fmt, ...)
+{
+	struct eshi_shm *shm;
+	va_list ap;
+	int ret;
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	va_start(ap, fmt);
+	ret = eshi_open_shm(EVL_MONITOR_DEV, __SEM_ACTIVE_MAGIC,
+			sizeof(struct shared_sem), &shm, fmt, ap);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	ret = init_sem(sem, shm, shm->clock, false);
+	if (ret < 0)
+		eshi_put_shm(shm, false, NULL);
+	else
+		sem->magic = __SEM_ACTIVE_MAGIC;
+
+	return ret;
 }
 
 int evl_close_sem(struct evl_sem *sem)
@@ -57,74 +268,110 @@ int evl_close_sem(struct evl_sem *sem)
 	if (sem->magic != __SEM_ACTIVE_MAGIC)
 		return -EINVAL;
 
+	eshi_unregister_pollable(sem->active.fd, sem);
 	close(sem->active.fd);
 	sem->magic = __SEM_DEAD_MAGIC;
 
+	if (sem->active.shm)
+		eshi_put_shm(sem->active.shm, sem->active.creator, NULL);
+
 	return 0;
 }
 
-static int check_sanity(struct evl_sem *sem)
+/*
+ * Created in place, restoring the static settings on error. The
+ * magic word is left to init_static_element().
+ */
+static int create_static_sem(void *element)
 {
-	int efd;
+	struct evl_sem *sem = element;
+	typeof(sem->uninit) uninit = sem->uninit;
+	char *name;
+	int ret;
+
+	ret = eshi_get_static_name(uninit.flags, &name, uninit.name);
+	if (ret)
+		return ret;
 
-	if (sem->magic == __SEM_UNINIT_MAGIC) {
-		efd = evl_create_sem(sem,
-				sem->uninit.clockfd,
-				sem->uninit.initval,
-				sem->uninit.flags,
-				sem->uninit.name);
-		return efd < 0 ? efd : 0;
+	ret = create_sem(sem, uninit.clockfd, uninit.initval, name);
+	free(name);
+	if (ret < 0) {
+		sem->uninit = uninit;
+		return ret;
 	}
 
-	return sem->magic != __SEM_ACTIVE_MAGIC ? -EINVAL : 0;
+	return 0;
 }
 
-static int timedget_sem(struct evl_sem *sem,
-			const struct timespec *timeout)
+int init_static_sem(void *element)
 {
-	const struct timespec *tp = timeout;
-	struct timespec ts, now;
-	struct pollfd pollfd;
-	uint64_t val;
-	int ret;
+	return init_static_element(element, __SEM_UNINIT_MAGIC,
+				__SEM_ACTIVE_MAGIC, create_static_sem);
+}
 
-	if (!tp || (tp->tv_sec == 0 && tp->tv_nsec == 0))
-		goto poll;
+static int check_sanity(struct evl_sem *sem)
+{
+	if (sem->magic != __SEM_ACTIVE_MAGIC)
+		return init_static_sem(sem);
+
+	return 0;
+}
+
+/* All units are taken at once, or none. */
+static int take_sem(struct evl_sem *sem, int count)
+{
+	int val, ret;
 
 	for (;;) {
-		if (tp) {
-			clock_gettime(sem->active.clock, &now);
-			ts = *timeout;
-			timespec_sub(&ts, &now);
-			if (ts.tv_sec < 0) {
-				ts.tv_sec = 0;
-				ts.tv_nsec = 0;
-			}
-			tp = &ts;
+		val = atomic_load(&sem->active.state->value);
+		if (val < count) {
+			ret = -EAGAIN;
+			break;
 		}
-	poll:
-		pollfd.fd = sem->active.fd;
-		pollfd.events = POLLIN;
-		pollfd.revents = 0;
-		ret = ppoll(&pollfd, 1, tp, NULL);
-		if (ret < 0)
-			return -errno;
-
-		if (ret == 0)
+		if (__sync_bool_compare_and_swap(&sem->active.state->value,
+							val, val - count)) {
+			val -= count;
+			ret = 0;
 			break;
+		}
+	}
+
+	if (val == 0 && atomic_load(&sem->active.polled))
+		drain_sem(sem);
+
+	return ret;
+}
 
-		if (!(pollfd.revents & POLLIN))
-			return -EINVAL;
+/*
+ * A semaphore runs from userland only, waiters sleep on the
+ * sequence futex which posters bump when someone waits, until the
+ * count is large enough for them. A zero timeout means
+ * non-blocking.
+ */
+static int timedget_sem(struct evl_sem *sem, int count,
+			const struct timespec *timeout)
+{
+	int ret, seq;
 
-		ret = read(sem->active.fd, &val, sizeof(val));
-		if (ret > 0)
+	for (;;) {
+		if (!take_sem(sem, count))
 			return 0;
 
-		if (errno != -EAGAIN)
-			return -errno;
+		if (timeout && timeout->tv_sec == 0 && timeout->tv_nsec == 0)
+			return -ETIMEDOUT;
+
+		seq = atomic_load(&sem->active.state->seq);
+		__sync_add_and_fetch(&sem->active.state->waiters, 1);
+		if (atomic_load(&sem->active.state->value) >= count)
+			ret = 0;
+		else
+			ret = eshi_futex_wait(&sem->active.state->seq, seq,
+					sem->active.clock, timeout,
+					sem->active.shm != NULL);
+		__sync_sub_and_fetch(&sem->active.state->waiters, 1);
+		if (ret && ret != -EAGAIN)
+			return ret;
 	}
-
-	return -ETIMEDOUT;
 }
 
 int evl_timedget_sem(struct evl_sem *sem,
@@ -139,7 +386,7 @@ int evl_timedget_sem(struct evl_sem *sem,
 	if (ret)
 		return ret;
 
-	return timedget_sem(sem, timeout);
+	return timedget_sem(sem, 1, timeout);
 }
 
 int evl_get_sem(struct evl_sem *sem)
@@ -150,7 +397,7 @@ int evl_get_sem(struct evl_sem *sem)
 	if (ret)
 		return ret;
 
-	return timedget_sem(sem, NULL);
+	return timedget_sem(sem, 1, NULL);
 }
 
 int evl_tryget_sem(struct evl_sem *sem)
@@ -162,25 +409,71 @@ int evl_tryget_sem(struct evl_sem *sem)
 	if (ret)
 		return ret;
 
-	ret = timedget_sem(sem, &zerotime);
+	ret = timedget_sem(sem, 1, &zerotime);
 	if (ret == -ETIMEDOUT)
 		return -EAGAIN;
 
 	return ret;
 }
 
+static int put_sem(struct evl_sem *sem, int count)
+{
+	int prev;
+
+	prev = __sync_fetch_and_add(&sem->active.state->value, count);
+	if (prev == 0 && atomic_load(&sem->active.polled))
+		signal_sem(sem);
+
+	if (atomic_load(&sem->active.state->waiters)) {
+		__sync_add_and_fetch(&sem->active.state->seq, 1);
+		eshi_futex_wake(&sem->active.state->seq, INT_MAX,
+				sem->active.shm != NULL);
+	}
+
+	return 0;
+}
+
 int evl_put_sem(struct evl_sem *sem)
 {
-	uint64_t val = (uint64_t)1U;
 	int ret;
 
 	ret = check_sanity(sem);
 	if (ret)
 		return ret;
 
-	ret = write(sem->active.fd, &val, sizeof(val));
-	if (ret != sizeof(val))
-		return -errno;
+	return put_sem(sem, 1);
+}
 
-	return 0;
+int evl_put_sem_n(struct evl_sem *sem, int count)
+{
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	return put_sem(sem, count);
+}
+
+/* Non-blocking only, like with libevl. */
+int evl_tryget_sem_n(struct evl_sem *sem, int count)
+{
+	struct timespec zerotime = { .tv_sec = 0, .tv_nsec = 0 };
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	ret = timedget_sem(sem, count, &zerotime);
+	if (ret == -ETIMEDOUT)
+		return -EAGAIN;
+
+	return ret;
 }
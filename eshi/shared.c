@@ -0,0 +1,255 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <evl/atomic.h>
+#include <evl/uapi.h>
+#include "internal.h"
+
+/*
+ * Public elements are registered as shared memory objects named
+ * after their class and name, e.g. /dev/shm/evl-eshi.monitor.foo for
+ * the monitor-based element known as /foo. The creator removes the
+ * name when it closes the element, the last process to let go of it
+ * destroys its state.
+ */
+#define ESHI_SHM_FMT	"/evl-eshi.%s.%s"
+
+/*
+ * Figure out whether an element to be created should be public,
+ * returning its name without the leading slash in this case, or
+ * NULL otherwise. Anonymous elements must be private by definition.
+ */
+int eshi_get_public_name(int clone_flags, char **pname,
+			const char *fmt, va_list ap)
+{
+	char *name;
+
+	*pname = NULL;
+
+	if (fmt == NULL)
+		return clone_flags & EVL_CLONE_PUBLIC ? -EINVAL : 0;
+
+	if (vasprintf(&name, fmt, ap) < 0)
+		return -ENOMEM;
+
+	if (*name == '/') {
+		clone_flags |= EVL_CLONE_PUBLIC;
+		memmove(name, name + 1, strlen(name));
+	}
+
+	if (!(clone_flags & EVL_CLONE_PUBLIC)) {
+		free(name);
+		return 0;
+	}
+
+	if (*name == '\0' || strchr(name, '/')) {
+		free(name);
+		return -EINVAL;
+	}
+
+	*pname = name;
+
+	return 0;
+}
+
+static int get_shm_path(char *path, const char *type, const char *name)
+{
+	int ret;
+
+	ret = snprintf(path, NAME_MAX + 1, ESHI_SHM_FMT, type, name);
+	if (ret > NAME_MAX)
+		return -ENAMETOOLONG;
+
+	return 0;
+}
+
+static int get_name(int clone_flags, char **pname,
+		const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = eshi_get_public_name(clone_flags, pname, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/*
+ * Same as eshi_get_public_name() for a static element, which has no
+ * arguments to its name format, like with libevl.
+ */
+int eshi_get_static_name(int clone_flags, char **pname, const char *name)
+{
+	return get_name(clone_flags, pname, name);
+}
+
+/*
+ * Create the shared memory object of a new public element, which
+ * fails with -EEXIST if the name is in use. The caller initializes
+ * the state following the header, then calls eshi_publish_shm().
+ */
+int eshi_new_shm(const char *type, const char *name,
+		size_t size, clockid_t clock,
+		struct eshi_shm **pshm)
+{
+	char path[NAME_MAX + 1];
+	struct eshi_shm *shm;
+	int fd, ret;
+
+	ret = get_shm_path(path, type, name);
+	if (ret)
+		return ret;
+
+	fd = shm_open(path, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	ret = ftruncate(fd, size);
+	if (ret) {
+		ret = -errno;
+		goto fail;
+	}
+
+	shm = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		ret = -errno;
+		goto fail;
+	}
+
+	close(fd);
+
+	shm->refs = 1;
+	shm->size = size;
+	shm->clock = clock;
+	strcpy(shm->path, path);
+	*pshm = shm;
+
+	return 0;
+fail:
+	close(fd);
+	shm_unlink(path);
+
+	return ret;
+}
+
+void eshi_publish_shm(struct eshi_shm *shm, unsigned int magic)
+{
+	smp_mb();
+	atomic_store(&shm->magic, magic);
+}
+
+static bool get_shm_ref(struct eshi_shm *shm)
+{
+	int refs;
+
+	do {
+		refs = atomic_load(&shm->refs);
+		if (refs <= 0)
+			return false;
+	} while (!__sync_bool_compare_and_swap(&shm->refs, refs, refs + 1));
+
+	return true;
+}
+
+/*
+ * Map the shared memory object of an existing public element. An
+ * element which is not fully created yet is reported as missing, a
+ * name referring to an element of another type is invalid.
+ */
+int eshi_open_shm(const char *type, unsigned int magic,
+		size_t size, struct eshi_shm **pshm,
+		const char *fmt, va_list ap)
+{
+	char path[NAME_MAX + 1], *name;
+	struct eshi_shm *shm;
+	struct stat st;
+	int fd, ret;
+
+	if (vasprintf(&name, fmt, ap) < 0)
+		return -ENOMEM;
+
+	ret = get_shm_path(path, type, *name == '/' ? name + 1 : name);
+	free(name);
+	if (ret)
+		return ret;
+
+	fd = shm_open(path, O_RDWR|O_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	ret = fstat(fd, &st);
+	if (ret) {
+		ret = -errno;
+		goto out;
+	}
+
+	if ((size_t)st.st_size < sizeof(*shm)) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	if ((size_t)st.st_size != size) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	shm = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (atomic_load(&shm->magic) != magic) {
+		ret = atomic_load(&shm->magic) ? -EINVAL : -ENOENT;
+		munmap(shm, size);
+		goto out;
+	}
+
+	smp_mb();
+
+	if (!get_shm_ref(shm)) {
+		ret = -ENOENT;
+		munmap(shm, size);
+		goto out;
+	}
+
+	*pshm = shm;
+out:
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * Drop a reference on a public element, removing its name if we
+ * created it, so that nobody can open it anymore. @destroy is called
+ * on the last reference.
+ */
+void eshi_put_shm(struct eshi_shm *shm, bool creator,
+		void (*destroy)(struct eshi_shm *shm))
+{
+	size_t size = shm->size;
+
+	if (creator)
+		shm_unlink(shm->path);
+
+	if (__sync_sub_and_fetch(&shm->refs, 1) == 0) {
+		atomic_store(&shm->magic, 0);
+		if (destroy)
+			destroy(shm);
+	}
+
+	munmap(shm, size);
+}
@@ -6,7 +6,6 @@
 
 #include <errno.h>
 #include <unistd.h>
-#include <search.h>
 #include <pthread.h>
 #include <evl/evl.h>
 #include <evl/thread.h>
@@ -16,28 +15,17 @@
 static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
 int evl_efd = -1;
 
-static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
-struct evl_tsd {
-	int fd;
-	pthread_t thread;
-} evl_tsd;
-
-static pthread_mutex_t evl_tsd_lock = PTHREAD_MUTEX_INITIALIZER;
-
 static pthread_key_t tsd_key;
 
-static void *fdtree_root;
-
-static int compare_nodes(const void *l, const void *r)
-{
-	const struct evl_tsd *lt = l, *rt = r;
-
-	return lt->fd - rt->fd;
-}
+/*
+ * Attached threads, indexed on their fd. Lookups are wait-free. A
+ * thread only updates the entry of its own fd, which it clears
+ * before closing the latter, so attach and detach need no lock.
+ */
+static struct eshi_fdtable threads;
 
 int evl_attach_self(const char *fmt, ...)
 {
-	struct evl_tsd **node;
 	int ret, fd;
 
 	if (evl_efd != -1)
@@ -51,19 +39,13 @@ int evl_attach_self(const char *fmt, ...)
 	if (fd < 0)
 		return -errno;
 
-	evl_tsd.fd = fd;
-	evl_tsd.thread = pthread_self();
-	pthread_mutex_lock(&evl_tsd_lock);
-	node = (struct evl_tsd **)tsearch(&evl_tsd, &fdtree_root, compare_nodes);
-	pthread_mutex_unlock(&evl_tsd_lock);
-	if (!node) {
+	ret = eshi_fdtable_set(&threads, fd, (void *)pthread_self());
+	if (ret) {
 		close(fd);
-		return -ENOMEM;
+		return ret;
 	}
-	if ((*node)->fd != fd)
-		return -EBUSY;	/* Weird. */
 
-	pthread_setspecific(tsd_key, &evl_tsd);
+	pthread_setspecific(tsd_key, &evl_efd);
 	evl_efd = fd;
 
 	return fd;
@@ -75,9 +57,7 @@ int evl_detach_self(void)
 		return -EPERM;
 
 	pthread_setspecific(tsd_key, NULL);
-	pthread_mutex_lock(&evl_tsd_lock);
-	tdelete(&evl_tsd, &fdtree_root, compare_nodes);
-	pthread_mutex_unlock(&evl_tsd_lock);
+	eshi_fdtable_set(&threads, evl_efd, NULL);
 	close(evl_efd);
 	evl_efd = -1;
 
@@ -91,17 +71,7 @@ int evl_get_self(void)
 
 pthread_t eshi_find_thread_by_fd(int fd)
 {
-	struct evl_tsd tsd = {
-		.fd = fd,
-	}, **node;
-
-	pthread_mutex_lock(&evl_tsd_lock);
-	node = tsearch(&tsd, &fdtree_root, compare_nodes);
-	pthread_mutex_unlock(&evl_tsd_lock);
-	if (!node)
-		return (pthread_t)NULL;
-
-	return (*node)->thread;
+	return (pthread_t)eshi_fdtable_get(&threads, fd);
 }
 
 static void unregister_thread(void *p)
@@ -109,6 +79,21 @@ static void unregister_thread(void *p)
 	evl_detach_self();
 }
 
+/*
+ * Like with the core, the child of fork() starts detached, the
+ * registry only refers to the parent's threads.
+ */
+void eshi_reset_threads(void)
+{
+	eshi_fdtable_clear(&threads);
+
+	if (evl_efd >= 0) {
+		pthread_setspecific(tsd_key, NULL);
+		close(evl_efd);
+		evl_efd = -1;
+	}
+}
+
 int eshi_init_threads(void)
 {
 	return -pthread_key_create(&tsd_key, unregister_thread);
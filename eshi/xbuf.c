@@ -0,0 +1,442 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <evl/atomic.h>
+#include <evl/xbuf.h>
+#include "internal.h"
+
+/*
+ * In-band threads read and write the xbuf descriptor directly, which
+ * is one end of a stream socket pair. We serve the out-of-band side
+ * from the other end: the inbound traffic (write -> oob_read) and
+ * the outbound traffic (oob_write -> read) flow in opposite
+ * directions through the pair, each with a send buffer sized after
+ * the corresponding ring. The peer end also tells us when the
+ * application closes the xbuf. The table entry holds a reference on
+ * the xbuf, so do out-of-band callers for the duration of a request.
+ *
+ * Out-of-band callers look up the table locklessly, so an xbuf may
+ * be referred to after its last reference is dropped: the memory is
+ * recycled for new xbufs instead of being freed, references are only
+ * taken on live ones.
+ */
+struct eshi_xbuf {
+	int fd;
+	int peerfd;
+	int refs;
+	size_t o_bufsz;
+	pthread_mutex_t wlock;	/* Serializes out-of-band writers. */
+	struct eshi_xbuf *next_live;
+	struct eshi_xbuf *next_free;
+};
+
+static struct eshi_fdtable xbufs;
+
+static struct eshi_xbuf *live_xbufs, *free_xbufs;
+
+static pthread_mutex_t xbuf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Nests inside xbuf_lock, references may be dropped under it. */
+static pthread_mutex_t free_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct eshi_xbuf *alloc_xbuf(void)
+{
+	struct eshi_xbuf *xbuf;
+
+	pthread_mutex_lock(&free_lock);
+	xbuf = free_xbufs;
+	if (xbuf)
+		free_xbufs = xbuf->next_free;
+	pthread_mutex_unlock(&free_lock);
+
+	if (xbuf == NULL) {
+		xbuf = calloc(1, sizeof(*xbuf));
+		if (xbuf)
+			pthread_mutex_init(&xbuf->wlock, NULL);
+	}
+
+	return xbuf;
+}
+
+static void free_xbuf(struct eshi_xbuf *xbuf)
+{
+	pthread_mutex_lock(&free_lock);
+	xbuf->next_free = free_xbufs;
+	free_xbufs = xbuf;
+	pthread_mutex_unlock(&free_lock);
+}
+
+static void put_xbuf(struct eshi_xbuf *xbuf)
+{
+	if (__sync_sub_and_fetch(&xbuf->refs, 1))
+		return;
+
+	close(xbuf->peerfd);
+	free_xbuf(xbuf);
+}
+
+/*
+ * Our end of the socket pair hangs up once the application closed
+ * the xbuf, its fd may refer to another file from then on, and the
+ * data still queued is stale.
+ */
+static bool xbuf_closed(struct eshi_xbuf *xbuf)
+{
+	struct pollfd pollfd;
+
+	pollfd.fd = xbuf->peerfd;
+	pollfd.events = 0;
+	pollfd.revents = 0;
+
+	return poll(&pollfd, 1, 0) > 0 &&
+		(pollfd.revents & (POLLHUP|POLLERR));
+}
+
+/* Drop the table reference on a closed xbuf, xbuf_lock held. */
+static void release_xbuf(struct eshi_xbuf *xbuf)
+{
+	struct eshi_xbuf **pp;
+
+	for (pp = &live_xbufs; *pp; pp = &(*pp)->next_live) {
+		if (*pp == xbuf) {
+			*pp = xbuf->next_live;
+			break;
+		}
+	}
+
+	if (eshi_fdtable_get(&xbufs, xbuf->fd) == xbuf)
+		eshi_fdtable_set(&xbufs, xbuf->fd, NULL);
+
+	eshi_unregister_pollable(xbuf->fd, xbuf);
+	put_xbuf(xbuf);
+}
+
+/*
+ * Release the xbufs the application closed, xbuf_lock held. This is
+ * only done on creation, out-of-band callers find out from the
+ * socket pair instead.
+ */
+static void reap_xbufs(void)
+{
+	struct eshi_xbuf *xbuf, *next;
+
+	for (xbuf = live_xbufs; xbuf; xbuf = next) {
+		next = xbuf->next_live;
+		if (xbuf_closed(xbuf))
+			release_xbuf(xbuf);
+	}
+}
+
+static int arm_xbuf(void *element)
+{
+	struct eshi_xbuf *xbuf = element;
+
+	return xbuf->peerfd;
+}
+
+static int set_ring_size(int fd, size_t bufsz)
+{
+	int val;
+
+	if (bufsz == 0)
+		return 0;
+
+	if (bufsz > INT_MAX)
+		return -EINVAL;
+
+	val = (int)bufsz;
+	if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val)))
+		return -errno;
+
+	return 0;
+}
+
+/* There is no device for public xbufs, names are ignored. */
+int evl_create_xbuf(size_t i_bufsz, size_t o_bufsz,
+		int flags, const char *fmt, ...)
+{
+	struct eshi_xbuf *xbuf, *old;
+	int ret, sv[2];
+
+	if (!eshi_is_initialized())
+		return -ENXIO;
+
+	if (i_bufsz == 0 && o_bufsz == 0)
+		return -EINVAL;
+
+	if (o_bufsz > INT_MAX / 2)
+		return -EINVAL;
+
+	xbuf = alloc_xbuf();
+	if (xbuf == NULL)
+		return -ENOMEM;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv)) {
+		ret = -errno;
+		goto fail_socket;
+	}
+
+	xbuf->fd = sv[0];
+	xbuf->peerfd = sv[1];
+	xbuf->o_bufsz = o_bufsz;
+
+	/*
+	 * The outbound ring is accounted for by write_xbuf(), leave
+	 * room for the per-message overhead in the send buffer.
+	 */
+	ret = set_ring_size(xbuf->fd, i_bufsz) ?:
+		set_ring_size(xbuf->peerfd, o_bufsz * 2);
+	if (ret)
+		goto fail_setup;
+
+	if ((flags & EVL_CLONE_NONBLOCK) &&
+		fcntl(xbuf->fd, F_SETFL, O_NONBLOCK)) {
+		ret = -errno;
+		goto fail_setup;
+	}
+
+	ret = eshi_register_pollable(xbuf->fd, arm_xbuf, xbuf, false);
+	if (ret)
+		goto fail_setup;
+
+	/*
+	 * A former xbuf on the same fd was closed by the application,
+	 * release it along with any other closed one.
+	 */
+	pthread_mutex_lock(&xbuf_lock);
+	reap_xbufs();
+	old = eshi_fdtable_get(&xbufs, xbuf->fd);
+	if (old)
+		release_xbuf(old);
+	atomic_store(&xbuf->refs, 1);
+	ret = eshi_fdtable_set(&xbufs, xbuf->fd, xbuf);
+	if (ret == 0) {
+		xbuf->next_live = live_xbufs;
+		live_xbufs = xbuf;
+	}
+	pthread_mutex_unlock(&xbuf_lock);
+	if (ret)
+		goto fail_table;
+
+	return xbuf->fd;
+
+fail_table:
+	eshi_unregister_pollable(xbuf->fd, xbuf);
+	close(xbuf->fd);
+	put_xbuf(xbuf);
+
+	return ret;
+fail_setup:
+	close(sv[0]);
+	close(sv[1]);
+fail_socket:
+	free_xbuf(xbuf);
+
+	return ret;
+}
+
+/*
+ * Look up the xbuf @efd refers to, getting a reference on it unless
+ * it is being released. Since the memory may have been recycled
+ * meanwhile, check that the table still maps @efd to it once
+ * referenced.
+ */
+static struct eshi_xbuf *get_xbuf(int efd)
+{
+	struct eshi_xbuf *xbuf;
+	int refs, prev;
+
+	for (;;) {
+		xbuf = eshi_fdtable_get(&xbufs, efd);
+		if (xbuf == NULL)
+			return NULL;
+
+		refs = atomic_load(&xbuf->refs);
+		while (refs > 0) {
+			prev = __sync_val_compare_and_swap(&xbuf->refs,
+							refs, refs + 1);
+			if (prev == refs)
+				break;
+			refs = prev;
+		}
+
+		if (refs == 0)
+			continue;
+
+		if (eshi_fdtable_get(&xbufs, efd) == xbuf)
+			return xbuf;
+
+		put_xbuf(xbuf);
+	}
+}
+
+/* The application closed the xbuf while we were using it. */
+static void drop_xbuf(struct eshi_xbuf *xbuf)
+{
+	pthread_mutex_lock(&xbuf_lock);
+
+	if (eshi_fdtable_get(&xbufs, xbuf->fd) == xbuf)
+		release_xbuf(xbuf);
+
+	pthread_mutex_unlock(&xbuf_lock);
+}
+
+static inline bool is_nonblock(int efd)
+{
+	int flags = fcntl(efd, F_GETFL);
+
+	return flags >= 0 && (flags & O_NONBLOCK);
+}
+
+/*
+ * Like with the core, a blocking read waits for @count bytes, a
+ * non-blocking one returns what is available. We first grab what we
+ * can without blocking, so that the common case only costs a single
+ * system call.
+ */
+static ssize_t read_xbuf(struct eshi_xbuf *xbuf, int efd,
+			void *buf, size_t count)
+{
+	ssize_t ret, n;
+
+	if (count == 0)
+		return 0;
+
+	ret = recv(xbuf->peerfd, buf, count, MSG_DONTWAIT);
+	if (ret == (ssize_t)count)
+		return ret;
+
+	if (ret == 0) {
+		drop_xbuf(xbuf);
+		return read(efd, buf, count);
+	}
+
+	if (ret < 0 && errno != EAGAIN)
+		return ret;
+
+	if (is_nonblock(efd)) {
+		if (ret < 0)
+			errno = EAGAIN;
+		return ret;
+	}
+
+	if (ret < 0)
+		ret = 0;
+
+	n = recv(xbuf->peerfd, (char *)buf + ret, count - ret, MSG_WAITALL);
+	if (n < 0)
+		return ret > 0 ? ret : n;
+
+	return ret + n;
+}
+
+ssize_t eshi_oob_read(int efd, void *buf, size_t count)
+{
+	struct eshi_xbuf *xbuf = get_xbuf(efd);
+	ssize_t ret;
+
+	if (xbuf == NULL)
+		return read(efd, buf, count);
+
+	ret = read_xbuf(xbuf, efd, buf, count);
+	put_xbuf(xbuf);
+
+	return ret;
+}
+
+/*
+ * Out-of-band writers are serialized, so that their messages are
+ * not interleaved. Like with the core, a message is queued as a
+ * whole or not at all: a message larger than the outbound ring is
+ * rejected, a non-blocking write fails unless the ring has room
+ * for all of it, which we tell from the amount of data the in-band
+ * side did not read yet. A blocking write returns once the whole
+ * message was queued.
+ */
+static ssize_t write_xbuf(struct eshi_xbuf *xbuf, int efd,
+			const void *buf, size_t count)
+{
+	ssize_t ret, n;
+	int queued;
+
+	if (count == 0)
+		return 0;
+
+	if (count > xbuf->o_bufsz) {
+		errno = EFBIG;
+		return -1;
+	}
+
+	pthread_mutex_lock(&xbuf->wlock);
+
+	if (!ioctl(xbuf->fd, FIONREAD, &queued) &&
+		(size_t)queued + count > xbuf->o_bufsz &&
+		is_nonblock(efd)) {
+		errno = EAGAIN;
+		ret = -1;
+		goto out;
+	}
+
+	ret = send(xbuf->peerfd, buf, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (ret == (ssize_t)count)
+		goto out;
+
+	if (ret < 0 && errno == EPIPE) {
+		pthread_mutex_unlock(&xbuf->wlock);
+		drop_xbuf(xbuf);
+		return write(efd, buf, count);
+	}
+
+	if (ret < 0) {
+		if (errno != EAGAIN || is_nonblock(efd))
+			goto out;
+		ret = 0;
+	}
+
+	/*
+	 * Never leave a message partially queued. A non-blocking
+	 * writer only gets there if the per-message overhead of the
+	 * socket exceeded the room we left for it, in which case we
+	 * wait for the reader to drain the excess.
+	 */
+	while (ret < (ssize_t)count) {
+		n = send(xbuf->peerfd, (const char *)buf + ret,
+			count - ret, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (ret == 0)
+				ret = n;
+			break;
+		}
+		ret += n;
+	}
+out:
+	pthread_mutex_unlock(&xbuf->wlock);
+
+	return ret;
+}
+
+ssize_t eshi_oob_write(int efd, const void *buf, size_t count)
+{
+	struct eshi_xbuf *xbuf = get_xbuf(efd);
+	ssize_t ret;
+
+	if (xbuf == NULL)
+		return write(efd, buf, count);
+
+	ret = write_xbuf(xbuf, efd, buf, count);
+	put_xbuf(xbuf);
+
+	return ret;
+}
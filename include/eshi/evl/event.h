@@ -17,7 +17,10 @@ struct evl_event {
 	union {
 		struct {
 			int fd;
-			pthread_cond_t cond;
+			pthread_cond_t *cond; /* &local, unless public */
+			pthread_cond_t local;
+			struct eshi_shm *shm;
+			int creator;
 		} active;
 		struct {
 			const char *name;
@@ -50,6 +53,10 @@ int evl_create_event(struct evl_event *evt,
 		int clockfd, int flags,
 		const char *fmt, ...);
 
+int evl_create_event_vec(struct evl_event *evts, int nr,
+		int clockfd, int flags,
+		const char *fmt, ...);
+
 int evl_open_event(struct evl_event *evt,
 		const char *fmt, ...);
 
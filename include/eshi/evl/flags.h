@@ -10,12 +10,23 @@
 #include <time.h>
 #include <evl/clock.h>
 
+struct evl_flags_state {
+	int value;	/* Pending bits */
+	int seq;	/* Futex sleepers wait on */
+	int waiters;
+};
+
 struct evl_flags {
 	unsigned int magic;
 	union {
 		struct {
+			struct evl_flags_state *state; /* &local, unless public */
+			struct evl_flags_state local;
+			struct eshi_shm *shm;
 			clockid_t clock;
 			int fd;
+			int polled;
+			int creator;
 		} active;
 		struct {
 			const char *name;
@@ -41,6 +52,10 @@ struct evl_flags {
 #define evl_new_flags(__flg, __fmt, __args...)	\
 	evl_create_flags(__flg, EVL_CLOCK_MONOTONIC, 0, 0, __fmt, ##__args)
 
+/* Wait modes of evl_trywait_flags_mask(). */
+#define EVL_FLAGS_ANY	(1 << 0)
+#define EVL_FLAGS_ALL	(1 << 1)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -49,6 +64,10 @@ int evl_create_flags(struct evl_flags *flg,
 		int clockfd, int initval, int flags,
 		const char *fmt, ...);
 
+int evl_create_flags_vec(struct evl_flags *flgs, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...);
+
 int evl_open_flags(struct evl_flags *flg,
 		const char *fmt, ...);
 
@@ -67,6 +86,10 @@ int evl_post_flags(struct evl_flags *flg,
 int evl_trywait_flags(struct evl_flags *flg,
 		int *r_bits);
 
+int evl_trywait_flags_mask(struct evl_flags *flg,
+			int mask, int mode,
+			int *r_bits);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,10 @@
 
 #define EVL_MUTEX_NORMAL     (0 << 0)
 #define EVL_MUTEX_RECURSIVE  (1 << 0)
+#define EVL_MUTEX_ADAPTIVE   (1 << 1)	/* Spins on trylock. */
+#define EVL_MUTEX_LOCKSTAT   (1 << 2)	/* Ignored. */
+
+#define EVL_MUTEX_SPIN_NS    5000
 
 #define __MUTEX_ACTIVE_MAGIC	0xab12ab12
 #define __MUTEX_UNINIT_MAGIC	0xfe11fe11
@@ -21,15 +25,20 @@ struct evl_mutex {
 	unsigned int magic;
 	union {
 		struct {
-			pthread_mutex_t mutex;
+			pthread_mutex_t *lock; /* &local, unless public */
+			pthread_mutex_t local;
+			struct eshi_shm *shm;
 			clockid_t clock;
 			int fd;
+			int creator;
+			unsigned int spin_ns;
 		} active;
 		struct {
 			const char *name;
 			int clockfd;
 			unsigned int ceiling;
 			unsigned int flags;
+			unsigned int spin_ns; /* 0 = default */
 		} uninit;
 	};
 };
@@ -56,6 +65,13 @@ int evl_create_mutex(struct evl_mutex *mutex, int clockfd,
 		unsigned int ceiling, int flags,
 		const char *fmt, ...);
 
+int evl_create_mutex_vec(struct evl_mutex *mutexes, int nr,
+		int clockfd, unsigned int ceiling, int flags,
+		const char *fmt, ...);
+
+int evl_open_mutex(struct evl_mutex *mutex,
+		const char *fmt, ...);
+
 int evl_lock_mutex(struct evl_mutex *mutex);
 
 int evl_timedlock_mutex(struct evl_mutex *mutex,
@@ -70,6 +86,9 @@ int evl_set_mutex_ceiling(struct evl_mutex *mutex,
 
 int evl_get_mutex_ceiling(struct evl_mutex *mutex);
 
+int evl_set_mutex_spin(struct evl_mutex *mutex,
+		unsigned int spin_ns);
+
 int evl_close_mutex(struct evl_mutex *mutex);
 
 #ifdef __cplusplus
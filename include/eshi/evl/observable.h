@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _EVL_ESHI_OBSERVABLE_H
+#define _EVL_ESHI_OBSERVABLE_H
+
+#include <time.h>
+#include <stdint.h>
+#include <evl/uapi.h>
+
+#define EVL_NOTIFY_ALWAYS	(0 << 0)
+#define EVL_NOTIFY_ONCHANGE	(1 << 0)
+#define EVL_NOTIFY_MASK		EVL_NOTIFY_ONCHANGE
+
+/* Tags below this value are reserved to the core. */
+#define EVL_NOTICE_USER  64
+
+struct evl_notice {
+	uint32_t tag;
+	union evl_value event;
+};
+
+struct evl_notification {
+	uint32_t tag;
+	uint32_t serial;
+	int32_t issuer;
+	union evl_value event;
+	struct timespec date;
+};
+
+#define evl_new_observable(__fmt, __args...)	\
+	evl_create_observable(EVL_CLONE_PRIVATE, __fmt, ##__args)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_create_observable(int flags, const char *fmt, ...);
+
+int evl_update_observable(int ofd, const struct evl_notice *ntc,
+			int nr);
+
+int evl_read_observable(int ofd, struct evl_notification *nf,
+			int nr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_ESHI_OBSERVABLE_H */
@@ -11,6 +11,17 @@
 #include <sys/poll.h>
 #include <evl/uapi.h>
 
+#define EVL_POLL_CTLADD  0
+#define EVL_POLL_CTLDEL  1
+#define EVL_POLL_CTLMOD  2
+
+struct evl_poll_ctlreq {
+	__u32 action;
+	__u32 fd;
+	__u32 events;
+	union evl_value pollval;
+};
+
 struct evl_poll_event {
 	__u32 fd;
 	__u32 events;
@@ -33,6 +44,9 @@ int evl_mod_pollfd(int efd, int modfd,
 		unsigned int events,
 		union evl_value pollval);
 
+int evl_ctl_pollfds(int efd, struct evl_poll_ctlreq *vec,
+		int nr, int *status);
+
 int evl_timedpoll(int efd, struct evl_poll_event *pollset,
 		int nrset, struct timespec *timeout);
 
@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _EVL_ESHI_RWLOCK_H
+#define _EVL_ESHI_RWLOCK_H
+
+#include <time.h>
+#include <pthread.h>
+#include <evl/clock.h>
+
+#define __RWLOCK_UNINIT_MAGIC	0x2e172e17
+
+struct evl_rwlock {
+	unsigned int magic;
+	union {
+		struct {
+			pthread_rwlock_t rwlock;
+			clockid_t clock;
+			int fd;
+		} active;
+		struct {
+			const char *name;
+			int clockfd;
+			int flags;
+		} uninit;
+	};
+};
+
+#define EVL_RWLOCK_INITIALIZER(__name, __clockfd, __flags)  {	\
+		.magic = __RWLOCK_UNINIT_MAGIC,			\
+		.uninit = {					\
+			.name = (__name),			\
+			.clockfd = (__clockfd),			\
+			.flags = (__flags),			\
+		}						\
+	}
+
+#define evl_new_rwlock(__rwlock, __fmt, __args...)		\
+	evl_create_rwlock(__rwlock, EVL_CLOCK_MONOTONIC,	\
+			0, __fmt, ##__args)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_create_rwlock(struct evl_rwlock *rwlock,
+		int clockfd, int flags,
+		const char *fmt, ...);
+
+int evl_rdlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_timedrdlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout);
+
+int evl_tryrdlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_wrlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_timedwrlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout);
+
+int evl_trywrlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_unlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_close_rwlock(struct evl_rwlock *rwlock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_ESHI_RWLOCK_H */
@@ -10,12 +10,23 @@
 #include <time.h>
 #include <evl/clock.h>
 
+struct evl_sem_state {
+	int value;	/* Pending units */
+	int seq;	/* Futex sleepers wait on */
+	int waiters;
+};
+
 struct evl_sem {
 	unsigned int magic;
 	union {
 		struct {
+			struct evl_sem_state *state; /* &local, unless public */
+			struct evl_sem_state local;
+			struct eshi_shm *shm;
 			clockid_t clock;
 			int fd;
+			int polled;
+			int creator;
 		} active;
 		struct {
 			const char *name;
@@ -50,6 +61,13 @@ int evl_create_sem(struct evl_sem *sem,
 		int clockfd, int initval, int flags,
 		const char *fmt, ...);
 
+int evl_create_sem_vec(struct evl_sem *sems, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...);
+
+int evl_open_sem(struct evl_sem *sem,
+		const char *fmt, ...);
+
 int evl_close_sem(struct evl_sem *sem);
 
 int evl_get_sem(struct evl_sem *sem);
@@ -61,6 +79,12 @@ int evl_put_sem(struct evl_sem *sem);
 
 int evl_tryget_sem(struct evl_sem *sem);
 
+int evl_put_sem_n(struct evl_sem *sem,
+		int count);
+
+int evl_tryget_sem_n(struct evl_sem *sem,
+		int count);
+
 #ifdef __cplusplus
 }
 #endif
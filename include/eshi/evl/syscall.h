@@ -15,14 +15,22 @@
 extern "C" {
 #endif
 
+/*
+ * The out-of-band side of an xbuf is served by libeshi, any other
+ * file is read or written directly.
+ */
+ssize_t eshi_oob_read(int efd, void *buf, size_t count);
+
+ssize_t eshi_oob_write(int efd, const void *buf, size_t count);
+
 static inline ssize_t oob_read(int efd, void *buf, size_t count)
 {
-	return read(efd, buf, count);
+	return eshi_oob_read(efd, buf, count);
 }
 
 static inline ssize_t oob_write(int efd, const void *buf, size_t count)
 {
-	return write(efd, buf, count);
+	return eshi_oob_write(efd, buf, count);
 }
 
 #define oob_ioctl(__efd, __request, __args...)	\
@@ -45,6 +45,12 @@ int evl_detach_self(void);
 
 int evl_get_self(void);
 
+int evl_subscribe(int ofd,
+		unsigned int backlog_count,
+		int flags);
+
+int evl_unsubscribe(int ofd);
+
 #ifdef __cplusplus
 }
 #endif
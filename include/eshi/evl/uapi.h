@@ -8,6 +8,7 @@
 #define _EVL_ESHI_UAPI_H
 
 #include <stdint.h>
+#include <linux/types.h>
 
 #define EVL_CLOCK_MONOTONIC_DEV	"monotonic"
 #define EVL_CLOCK_REALTIME_DEV	"realtime"
@@ -19,12 +20,20 @@
 #define EVL_XBUF_DEV		"xbuf"
 #define EVL_OBSERVABLE_DEV	"observable"
 
+#define EVL_CLONE_PRIVATE	(0 << 16)
+#define EVL_CLONE_PUBLIC	(1 << 16)
+#define EVL_CLONE_OBSERVABLE	(1 << 17)
+#define EVL_CLONE_NONBLOCK	(1 << 18)
+#define EVL_CLONE_MASTER	(1 << 19)
+
 union evl_value {
-	int32_t val;
-	int64_t lval;
+	__s32 val;
+	__s64 lval;
 	void *ptr;
 };
 
 #define evl_nil  ((union evl_value){ .lval = 0 })
+#define evl_intval(__val) ((union evl_value){ .lval = (__val) })
+#define evl_ptrval(__ptr) ((union evl_value){ .ptr = (__ptr) })
 
 #endif /* _EVL_ESHI_UAPI_H */
@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The barrier: arriving at the barrier only decrements a counter,
+ * early arrivals sleep on a semaphore, the last one wakes them all
+ * up by posting as many units at once. The semaphore in use
+ * alternates with each cycle (sense reversal), so that threads
+ * rushing to the next cycle cannot consume the units of a sleeper
+ * still leaving the previous one.
+ */
+
+#ifndef _EVL_BARRIER_H
+#define _EVL_BARRIER_H
+
+#include <evl/sem.h>
+
+/* Returned to the last thread arriving at the barrier. */
+#define EVL_BARRIER_SERIAL	1
+
+struct evl_barrier {
+	unsigned int magic;
+	int count;
+	int remaining;
+	unsigned int gen;
+	struct evl_sem sems[2];
+};
+
+#define evl_new_barrier(__bar, __count, __fmt, __args...)	\
+	evl_create_barrier(__bar, EVL_CLOCK_MONOTONIC,		\
+			__count, __fmt, ##__args)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_create_barrier(struct evl_barrier *bar,
+		int clockfd, int count,
+		const char *fmt, ...);
+
+int evl_wait_barrier(struct evl_barrier *bar);
+
+int evl_close_barrier(struct evl_barrier *bar);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_BARRIER_H */
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The broadcast ring: a single-producer, multi-consumer circular
+ * buffer delivering every item to every registered reader, without
+ * involving the kernel on the data path. Each reader owns a cursor,
+ * the producer is back-pressured by the slowest one. The ring can
+ * live in a memory segment shared between processes.
+ */
+
+#ifndef _EVL_BCAST_H
+#define _EVL_BCAST_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/types.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+
+#define EVL_BCAST_MAX_READERS	64
+
+struct evl_bcast_cursor {
+	__u32 seq;		/* Next sequence to read. */
+	__u32 active;
+} __aligned(64);
+
+struct evl_bcast_state {
+	__u32 magic;
+	__u32 item_size;
+	__u32 count;		/* Power of two. */
+	__u32 max_readers;
+	__u32 head __aligned(64); /* Next sequence to write. */
+	__u32 gate;		/* Producer cache of the slowest cursor. */
+	__u32 waiters __aligned(64); /* Count of sleeping readers. */
+	struct evl_bcast_cursor cursors[0];
+};
+
+struct evl_bcast {
+	struct evl_bcast_state *state;
+	void *slots;
+	struct evl_mutex *lock;
+	struct evl_event *event;
+};
+
+#define __EVL_BCAST_HDR_SIZE(__max_readers)				\
+	__align_to(sizeof(struct evl_bcast_state) +			\
+		sizeof(struct evl_bcast_cursor) * (__max_readers), 64)
+
+/*
+ * Size of the memory needed for holding @__count items of
+ * @__item_size bytes each, shared by up to @__max_readers readers.
+ * @__count must be a power of two.
+ */
+#define evl_get_bcast_size(__item_size, __count, __max_readers)	\
+	(__EVL_BCAST_HDR_SIZE(__max_readers) +				\
+		__align_to((size_t)(__item_size), sizeof(long)) * (__count))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_bcast(struct evl_bcast *bc,
+		void *mem, size_t size,
+		size_t item_size, int count,
+		int max_readers,
+		struct evl_mutex *lock,
+		struct evl_event *event);
+
+int evl_bind_bcast(struct evl_bcast *bc,
+		void *mem,
+		struct evl_mutex *lock,
+		struct evl_event *event);
+
+int evl_add_bcast_reader(struct evl_bcast *bc);
+
+int evl_del_bcast_reader(struct evl_bcast *bc,
+			int reader);
+
+int evl_send_bcast(struct evl_bcast *bc,
+		const void *item);
+
+int evl_read_bcast(struct evl_bcast *bc,
+		int reader, void *item);
+
+int evl_timedwait_bcast(struct evl_bcast *bc,
+			int reader, void *item,
+			const struct timespec *timeout);
+
+int evl_wait_bcast(struct evl_bcast *bc,
+		int reader, void *item);
+
+int evl_get_bcast_backlog(struct evl_bcast *bc,
+			int reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_BCAST_H */
@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The channel: a named, fixed-size message queue between processes,
+ * built on a shared memory segment holding a pair of _rel tubes and
+ * the message buffers, plus a public flag group for waking up the
+ * receiving side. Buffers can be filled and consumed in place.
+ */
+
+#ifndef _EVL_CHANNEL_H
+#define _EVL_CHANNEL_H
+
+#include <sys/types.h>
+#include <time.h>
+#include <evl/flags.h>
+
+struct evl_channel_state;
+
+struct evl_channel {
+	struct evl_channel_state *state;
+	void *pending;
+	void *free;
+	void *data;
+	size_t size;
+	char *name;	/* Creator only. */
+	struct evl_flags flags;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_create_channel(struct evl_channel *ch,
+		size_t item_size, int count,
+		const char *fmt, ...);
+
+int evl_open_channel(struct evl_channel *ch,
+		const char *fmt, ...);
+
+int evl_close_channel(struct evl_channel *ch);
+
+void *evl_get_channel_buffer(struct evl_channel *ch);
+
+int evl_send_channel_buffer(struct evl_channel *ch,
+			void *buf);
+
+int evl_timedreceive_channel_buffer(struct evl_channel *ch,
+				void **bufp,
+				const struct timespec *timeout);
+
+int evl_receive_channel_buffer(struct evl_channel *ch,
+			void **bufp);
+
+int evl_tryreceive_channel_buffer(struct evl_channel *ch,
+				void **bufp);
+
+int evl_release_channel_buffer(struct evl_channel *ch,
+			void *buf);
+
+int evl_send_channel(struct evl_channel *ch,
+		const void *item);
+
+int evl_receive_channel(struct evl_channel *ch,
+			void *item);
+
+int evl_timedreceive_channel(struct evl_channel *ch,
+			void *item,
+			const struct timespec *timeout);
+
+size_t evl_get_channel_item_size(struct evl_channel *ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_CHANNEL_H */
@@ -0,0 +1,81 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Coroutines: stackful tasks scheduled cooperatively by a single
+ * thread, which switches between them without involving the
+ * kernel. A coroutine about to block on a file or a semaphore parks
+ * instead, until the poll set of its scheduler reports the
+ * corresponding descriptor as ready.
+ */
+
+#ifndef _EVL_CORO_H
+#define _EVL_CORO_H
+
+#include <sys/types.h>
+#include <evl/list.h>
+#include <evl/sem.h>
+#include <evl/poll.h>
+
+#define EVL_CORO_STACK_SIZE	(64 * 1024)
+
+struct evl_coro_sched;
+
+typedef void (*evl_coro_fn_t)(void *arg);
+
+struct evl_coro {
+	/* Private. */
+	void *sp;
+	void *stack;
+	size_t stack_size;	/* Including the guard page */
+	evl_coro_fn_t fn;
+	void *arg;
+	struct evl_coro_sched *sched;
+	struct list_head next;
+	int state;
+	int wait_fd;
+	unsigned int revents;
+};
+
+struct evl_coro_sched {
+	/* Private. */
+	void *sp;
+	int pollfd;
+	int batch;
+	int nr_coros;
+	struct evl_coro *current;
+	struct evl_poll_event *events;
+	struct list_head runq;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_coro_sched(struct evl_coro_sched *sched, int batch);
+
+int evl_spawn_coro(struct evl_coro_sched *sched,
+		struct evl_coro *coro,
+		evl_coro_fn_t fn, void *arg,
+		size_t stacksz);
+
+int evl_run_coro_sched(struct evl_coro_sched *sched);
+
+int evl_close_coro_sched(struct evl_coro_sched *sched);
+
+struct evl_coro *evl_current_coro(void);
+
+void evl_yield_coro(void);
+
+int evl_coro_poll(int fd, unsigned int events);
+
+ssize_t evl_coro_read(int fd, void *buf, size_t count);
+
+ssize_t evl_coro_write(int fd, const void *buf, size_t count);
+
+int evl_coro_get_sem(struct evl_sem *sem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_CORO_H */
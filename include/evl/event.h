@@ -56,6 +56,10 @@ int evl_create_event(struct evl_event *evt,
 		int clockfd, int flags,
 		const char *fmt, ...);
 
+int evl_create_event_vec(struct evl_event *evts, int nr,
+		int clockfd, int flags,
+		const char *fmt, ...);
+
 int evl_open_event(struct evl_event *evt,
 		const char *fmt, ...);
 
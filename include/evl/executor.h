@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The pool executor: a set of worker threads pinned to the
+ * out-of-band capable CPUs, attached to the core once for all, which
+ * run tasks submitted by any thread. Each worker owns a work-stealing
+ * deque, idle workers steal from the others, then park on a flag
+ * group. Submitting and stealing tasks does not involve the kernel,
+ * only waking up a parked worker does.
+ */
+
+#ifndef _EVL_EXECUTOR_H
+#define _EVL_EXECUTOR_H
+
+#include <evl/flags.h>
+#include <evl/sem.h>
+
+#define EVL_EXECUTOR_DEQUE_SIZE	1024	/* Power of 2 */
+
+struct evl_task;
+struct evl_executor_worker;
+
+typedef void (*evl_task_fn_t)(struct evl_task *task);
+
+struct evl_task_group {
+	int pending;
+	int busy;		/* Busy periods not waited for yet */
+	struct evl_sem done;	/* Posted at the end of a busy period */
+};
+
+struct evl_task {
+	evl_task_fn_t fn;
+	void *arg;
+	/* Private. */
+	struct evl_task_group *group;
+	struct evl_task *next;
+};
+
+struct evl_pool_executor {
+	int nr_workers;
+	int nr_parked;
+	int stop;
+	struct evl_task *injected;	/* Lock-free LIFO */
+	struct evl_executor_worker *workers;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_pool_executor(struct evl_pool_executor *exec,
+			int nr_workers, int prio,
+			const char *name);
+
+int evl_submit_task(struct evl_pool_executor *exec,
+		struct evl_task *task,
+		evl_task_fn_t fn, void *arg,
+		struct evl_task_group *group);
+
+int evl_submit_tasks(struct evl_pool_executor *exec,
+		struct evl_task *tasks, int nr,
+		struct evl_task_group *group);
+
+int evl_close_pool_executor(struct evl_pool_executor *exec);
+
+int evl_init_task_group(struct evl_task_group *group);
+
+int evl_wait_task_group(struct evl_task_group *group);
+
+int evl_close_task_group(struct evl_task_group *group);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_EXECUTOR_H */
@@ -50,6 +50,10 @@ struct evl_flags {
 	evl_create_flags(__flg, EVL_CLOCK_MONOTONIC, 0,	    \
 			EVL_CLONE_PRIVATE, __fmt, ##__args)
 
+/* Wait modes of evl_trywait_flags_mask(). */
+#define EVL_FLAGS_ANY	(1 << 0)
+#define EVL_FLAGS_ALL	(1 << 1)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -58,6 +62,10 @@ int evl_create_flags(struct evl_flags *flg,
 		int clockfd, int initval, int flags,
 		const char *fmt, ...);
 
+int evl_create_flags_vec(struct evl_flags *flgs, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...);
+
 int evl_open_flags(struct evl_flags *flg,
 		const char *fmt, ...);
 
@@ -76,6 +84,10 @@ int evl_post_flags(struct evl_flags *flg,
 int evl_trywait_flags(struct evl_flags *flg,
 		int *r_bits);
 
+int evl_trywait_flags_mask(struct evl_flags *flg,
+			int mask, int mode,
+			int *r_bits);
+
 int evl_peek_flags(struct evl_flags *flg,
 		int *r_bits);
 
@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Lock statistics, collected for mutexes created with
+ * EVL_MUTEX_LOCKSTAT. Every thread accounts for the lock events it
+ * causes into a row of its own, in a per-process shared memory file
+ * named after EVL_LOCKSTAT_SHM_FMT, which readers aggregate. The
+ * counts of exited threads are folded into row #0.
+ *
+ * A mutex slot is given a new generation number each time it is
+ * released, counts are only valid for the current generation of
+ * their slot. Every thread resets its own stale counts lazily, so
+ * that no row is ever written to by more than one thread.
+ */
+
+#ifndef _EVL_LOCKSTAT_H
+#define _EVL_LOCKSTAT_H
+
+#include <string.h>
+#include <linux/types.h>
+
+#define EVL_LOCKSTAT_SHM_FMT		"/evl-lockstat.%d"
+#define EVL_LOCKSTAT_MAGIC		0x10c57a75
+#define EVL_LOCKSTAT_MAX_MUTEXES	64
+#define EVL_LOCKSTAT_MAX_ROWS		64
+#define EVL_LOCKSTAT_NAMELEN		32
+/* Bucket #n > 0 counts [2^(n+8), 2^(n+9)) ns, #0 below 512 ns. */
+#define EVL_LOCKSTAT_HIST_SIZE		16
+#define EVL_LOCKSTAT_HIST_SHIFT		8
+
+struct evl_lockstat {
+	__u64 fast;		/* Acquired from the fast path */
+	__u64 slow;		/* Acquired via EVL_MONIOC_ENTER */
+	__u64 trylock_failed;
+	__u64 recursive;	/* Nested acquisitions */
+	__u64 pp_slow;		/* Slow acquisitions of PP mutexes */
+	__u64 since;		/* Owner only: last outermost acquisition */
+	__u64 wait_hist[EVL_LOCKSTAT_HIST_SIZE];
+	__u64 hold_hist[EVL_LOCKSTAT_HIST_SIZE];
+};
+
+struct evl_lockstat_file {
+	__u32 magic;
+	__u32 busy[EVL_LOCKSTAT_MAX_ROWS];
+	__u32 dropped_rows;	/* Threads which could not get a row */
+	__u32 dropped_mutexes;	/* Mutexes which could not get a slot */
+	__u32 gen[EVL_LOCKSTAT_MAX_MUTEXES];	/* Never zero */
+	__u32 row_gen[EVL_LOCKSTAT_MAX_ROWS][EVL_LOCKSTAT_MAX_MUTEXES];
+	char names[EVL_LOCKSTAT_MAX_MUTEXES][EVL_LOCKSTAT_NAMELEN];
+	struct evl_lockstat rows[EVL_LOCKSTAT_MAX_ROWS][EVL_LOCKSTAT_MAX_MUTEXES];
+};
+
+static inline int evl_lockstat_bucket(__u64 ns)
+{
+	int n;
+
+	if (ns < (2ULL << EVL_LOCKSTAT_HIST_SHIFT))
+		return 0;
+
+	n = 63 - __builtin_clzll(ns) - EVL_LOCKSTAT_HIST_SHIFT;
+
+	return n < EVL_LOCKSTAT_HIST_SIZE ? n : EVL_LOCKSTAT_HIST_SIZE - 1;
+}
+
+/* Sum up the rows of all threads for a given mutex slot. */
+static inline void evl_sum_lockstat(const struct evl_lockstat_file *file,
+				int slot, struct evl_lockstat *sum)
+{
+	const struct evl_lockstat *st;
+	int row, n;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for (row = 0; row < EVL_LOCKSTAT_MAX_ROWS; row++) {
+		if (file->row_gen[row][slot] != file->gen[slot])
+			continue;
+		st = &file->rows[row][slot];
+		sum->fast += st->fast;
+		sum->slow += st->slow;
+		sum->trylock_failed += st->trylock_failed;
+		sum->recursive += st->recursive;
+		sum->pp_slow += st->pp_slow;
+		for (n = 0; n < EVL_LOCKSTAT_HIST_SIZE; n++) {
+			sum->wait_hist[n] += st->wait_hist[n];
+			sum->hold_hist[n] += st->hold_hist[n];
+		}
+	}
+}
+
+struct evl_mutex;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_get_mutex_lockstat(struct evl_mutex *mutex,
+			struct evl_lockstat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_LOCKSTAT_H */
@@ -16,6 +16,11 @@
 
 #define EVL_MUTEX_NORMAL     (0 << 0)
 #define EVL_MUTEX_RECURSIVE  (1 << 0)
+#define EVL_MUTEX_ADAPTIVE   (1 << 1)
+#define EVL_MUTEX_LOCKSTAT   (1 << 2)
+
+/* Default spinning time of adaptive mutexes (ns). */
+#define EVL_MUTEX_SPIN_NS    5000
 
 #define __MUTEX_UNINIT_MAGIC	0xfe11fe11
 #define __MUTEX_ACTIVE_MAGIC	0xab12ab12
@@ -29,6 +34,8 @@ struct evl_mutex {
 			int efd;
 			int monitor : 2,
 			    protocol : 4;
+			unsigned int spin_ns;
+			int stat_id;
 		} active;
 		struct {
 			const char *name;
@@ -36,6 +43,7 @@ struct evl_mutex {
 			unsigned int ceiling;
 			int flags;
 			int monitor : 2;
+			unsigned int spin_ns; /* 0 = default */
 		} uninit;
 	} u;
 };
@@ -66,6 +74,10 @@ int evl_create_mutex(struct evl_mutex *mutex,
 		int clockfd, unsigned int ceiling, int flags,
 		const char *fmt, ...);
 
+int evl_create_mutex_vec(struct evl_mutex *mutexes, int nr,
+		int clockfd, unsigned int ceiling, int flags,
+		const char *fmt, ...);
+
 int evl_open_mutex(struct evl_mutex *mutex,
 		const char *fmt, ...);
 
@@ -83,6 +95,9 @@ int evl_set_mutex_ceiling(struct evl_mutex *mutex,
 
 int evl_get_mutex_ceiling(struct evl_mutex *mutex);
 
+int evl_set_mutex_spin(struct evl_mutex *mutex,
+		unsigned int spin_ns);
+
 int evl_close_mutex(struct evl_mutex *mutex);
 
 #ifdef __cplusplus
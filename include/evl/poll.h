@@ -28,6 +28,9 @@ int evl_mod_pollfd(int efd, int modfd,
 		unsigned int events,
 		union evl_value pollval);
 
+int evl_ctl_pollfds(int efd, struct evl_poll_ctlreq *vec,
+		int nr, int *status);
+
 int evl_timedpoll(int efd, struct evl_poll_event *pollset,
 		int nrset, const struct timespec *timeout);
 
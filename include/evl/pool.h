@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The element pool: a set of mutexes, semaphores or flag groups
+ * created in-band ahead of time, which out-of-band threads may check
+ * out and back in without issuing any system call. An in-band
+ * refiller thread creates more elements when the pool runs low.
+ */
+
+#ifndef _EVL_POOL_H
+#define _EVL_POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <linux/types.h>
+#include <evl/mutex.h>
+#include <evl/sem.h>
+#include <evl/flags.h>
+
+#define EVL_POOL_MUTEX	0
+#define EVL_POOL_SEM	1
+#define EVL_POOL_FLAGS	2
+
+union evl_pool_element {
+	struct evl_mutex mutex;
+	struct evl_sem sem;
+	struct evl_flags flags;
+};
+
+struct evl_element_pool {
+	__u64 head;		/* Tag:32 | index + 1:32 */
+	int nr_free;
+	int refill_pending;
+	int nr_created;
+	int stop;
+	int type;
+	int capacity;
+	int low_mark;
+	int clockfd;
+	int flags;
+	int *next;
+	union evl_pool_element *elements;
+	struct evl_sem refill;
+	pthread_t refiller;
+	bool has_refiller;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_element_pool(struct evl_element_pool *pool,
+			int type, int capacity,
+			int prefill, int low_mark,
+			int clockfd, int flags);
+
+void *evl_get_pool_element(struct evl_element_pool *pool);
+
+int evl_put_pool_element(struct evl_element_pool *pool,
+			void *element);
+
+int evl_get_pool_free(struct evl_element_pool *pool);
+
+int evl_destroy_element_pool(struct evl_element_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_POOL_H */
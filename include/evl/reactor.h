@@ -0,0 +1,101 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The reactor: an event loop run by a single thread, which
+ * dispatches the readiness of the elements and files it monitors to
+ * per-source handlers, fires one-shot and periodic timers, and runs
+ * calls deferred by any thread. All events collected by a wake-up
+ * are dispatched in a batch, by decreasing priority, then in
+ * registration order within a priority level.
+ */
+
+#ifndef _EVL_REACTOR_H
+#define _EVL_REACTOR_H
+
+#include <time.h>
+#include <linux/types.h>
+#include <evl/list.h>
+#include <evl/flags.h>
+#include <evl/poll.h>
+
+struct evl_reactor;
+struct evl_reactor_source;
+struct evl_reactor_call;
+
+typedef void (*evl_reactor_handler_t)(struct evl_reactor_source *src,
+				unsigned int revents);
+
+typedef void (*evl_reactor_fn_t)(struct evl_reactor_call *call);
+
+struct evl_reactor_source {
+	int fd;
+	unsigned int events;
+	int prio;
+	evl_reactor_handler_t handler;
+	void *arg;
+	__u64 ticks;		/* Timer expiries since last dispatch */
+	/* Private. */
+	struct evl_reactor *reactor;
+	struct list_head next;
+	unsigned int serial;
+	unsigned int revents;
+	int is_timer;
+};
+
+struct evl_reactor_call {
+	evl_reactor_fn_t fn;
+	void *arg;
+	struct evl_reactor_call *next;
+};
+
+struct evl_reactor {
+	int pollfd;
+	int batch;
+	int stop;
+	unsigned int serial;
+	struct evl_poll_event *events;
+	struct evl_reactor_source **ready;
+	int nr_ready;			/* Batch being dispatched */
+	struct evl_reactor_call *calls;	/* Lock-free LIFO */
+	struct list_head sources;
+	struct evl_flags wakeup;
+	struct evl_reactor_source wakeup_src;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_reactor(struct evl_reactor *reactor, int batch);
+
+int evl_add_reactor_fd(struct evl_reactor *reactor,
+		struct evl_reactor_source *src,
+		int fd, unsigned int events, int prio,
+		evl_reactor_handler_t handler, void *arg);
+
+int evl_add_reactor_timer(struct evl_reactor *reactor,
+			struct evl_reactor_source *src,
+			int clockfd, const struct timespec *date,
+			const struct timespec *period, int prio,
+			evl_reactor_handler_t handler, void *arg);
+
+int evl_del_reactor_source(struct evl_reactor_source *src);
+
+int evl_defer_reactor_call(struct evl_reactor *reactor,
+			struct evl_reactor_call *call,
+			evl_reactor_fn_t fn, void *arg);
+
+int evl_run_reactor(struct evl_reactor *reactor,
+		const struct timespec *timeout);
+
+int evl_loop_reactor(struct evl_reactor *reactor);
+
+void evl_stop_reactor(struct evl_reactor *reactor);
+
+int evl_close_reactor(struct evl_reactor *reactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_REACTOR_H */
@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The reader-writer lock: a reader count and a writer bit are kept
+ * in a lock word, so that uncontended read locking only involves a
+ * compare-and-swap on this word. Writers own a PI mutex for the
+ * duration of the write section, which readers and writers sleep on
+ * when contended, boosting the writer. Once a writer has claimed the
+ * lock, new readers are held off until it is done (writer
+ * preference).
+ */
+
+#ifndef _EVL_RWLOCK_H
+#define _EVL_RWLOCK_H
+
+#include <time.h>
+#include <linux/types.h>
+#include <evl/atomic.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <uapi/evl/factory.h>
+
+#define __RWLOCK_UNINIT_MAGIC	0x2e172e17
+
+struct evl_rwlock {
+	unsigned int magic;
+	union {
+		struct {
+			__u32 word;
+			int rd_waiters;
+			int wr_waiters;
+			struct evl_mutex lock;
+			struct evl_event rdq;
+			struct evl_event wrq;
+		} active;
+		struct {
+			const char *name;
+			int clockfd;
+			int flags;
+		} uninit;
+	} u;
+};
+
+#define EVL_RWLOCK_INITIALIZER(__name, __clockfd, __flags)  {	\
+		.magic = __RWLOCK_UNINIT_MAGIC,			\
+		.u = {						\
+			.uninit = {				\
+				.name = (__name),		\
+				.clockfd = (__clockfd),		\
+				.flags = (__flags),		\
+			}					\
+		}						\
+	}
+
+#define evl_new_rwlock(__rwlock, __fmt, __args...)		\
+	evl_create_rwlock(__rwlock, EVL_CLOCK_MONOTONIC,	\
+			EVL_CLONE_PRIVATE, __fmt, ##__args)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_create_rwlock(struct evl_rwlock *rwlock,
+		int clockfd, int flags,
+		const char *fmt, ...);
+
+int evl_rdlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_timedrdlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout);
+
+int evl_tryrdlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_wrlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_timedwrlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout);
+
+int evl_trywrlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_unlock_rwlock(struct evl_rwlock *rwlock);
+
+int evl_close_rwlock(struct evl_rwlock *rwlock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_RWLOCK_H */
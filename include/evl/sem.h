@@ -58,6 +58,10 @@ int evl_create_sem(struct evl_sem *sem,
 		int clockfd, int initval, int flags,
 		const char *fmt, ...);
 
+int evl_create_sem_vec(struct evl_sem *sems, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...);
+
 int evl_open_sem(struct evl_sem *sem,
 		 const char *fmt, ...);
 
@@ -72,6 +76,12 @@ int evl_put_sem(struct evl_sem *sem);
 
 int evl_tryget_sem(struct evl_sem *sem);
 
+int evl_put_sem_n(struct evl_sem *sem,
+		int count);
+
+int evl_tryget_sem_n(struct evl_sem *sem,
+		int count);
+
 int evl_peek_sem(struct evl_sem *sem,
 		int *r_val);
 
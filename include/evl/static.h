@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Statically initialized elements (EVL_*_INITIALIZER) are created
+ * on first use. Registering them with EVL_STATIC_ELEMENT() allows
+ * evl_init_static_elements() to create them all upfront, in-band,
+ * so that the first call to a blocking service costs the same as
+ * any other:
+ *
+ * static struct evl_mutex lock =
+ *	EVL_MUTEX_INITIALIZER("lock", EVL_CLOCK_MONOTONIC, 0,
+ *			EVL_MUTEX_NORMAL);
+ * EVL_STATIC_ELEMENT(lock);
+ *
+ * Registrations are collected by the linker into a section of the
+ * executable or shared library they appear in. Each of them must
+ * call evl_init_static_elements() after evl_init() to create its own
+ * set.
+ */
+
+#ifndef _EVL_STATIC_H
+#define _EVL_STATIC_H
+
+/* Held by the magic word of an element while it is being created. */
+#define __EVL_STATIC_BUSY_MAGIC	0x5a175a17
+
+#define EVL_STATIC_ELEMENT(__obj)					\
+	static void *__evl_static_ ## __obj				\
+	__attribute__((section("evl_static_elements"), used)) = &(__obj)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void *__start_evl_static_elements[]
+	__attribute__((weak, visibility("hidden")));
+extern void *__stop_evl_static_elements[]
+	__attribute__((weak, visibility("hidden")));
+
+int evl_init_static_element(void *element);
+
+static inline int evl_init_static_elements(void)
+{
+	void **p;
+	int ret;
+
+	for (p = __start_evl_static_elements;
+	     p < __stop_evl_static_elements; p++) {
+		ret = evl_init_static_element(*p);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_STATIC_H */
@@ -15,8 +15,172 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <evl/compiler.h>
 #include <evl/atomic.h>
+#include <evl/heap.h>
+
+/*
+ * Optional instrumentation, enabled by defining EVL_TUBE_STATS
+ * before including this header. Counters are spread over a few
+ * cacheline-aligned slots, each thread updating the slot it hashes
+ * to, so that instrumenting does not add much contention. The
+ * occupancy is derived from the send and receive counts, the
+ * high-water mark is sampled every EVL_TUBE_STAT_SAMPLING sends, or
+ * raised to the tube capacity when a send fails for lack of free
+ * canister.
+ *
+ * The counters are always part of the tube layout whether
+ * EVL_TUBE_STATS is defined or not, so that code built either way
+ * can share the same tube, e.g. a _rel tube mapped by several
+ * processes. Only instrumented code updates them though, which makes
+ * the figures partial if uninstrumented code uses the tube too.
+ */
+
+struct evl_tube_stats {
+	unsigned long sent;
+	unsigned long received;
+	unsigned long send_failed;
+	unsigned long cas_retries;
+	long occupancy;
+	long hwm;
+};
+
+#define EVL_TUBE_STAT_SLOTS	8	/* Part of the ABI. */
+
+struct evl_tube_stat_slot {
+	unsigned long sent;
+	unsigned long received;
+	unsigned long send_failed;
+	unsigned long cas_retries;
+} __aligned(64);
+
+#define __EVL_TUBE_STATS_DECL					\
+	struct evl_tube_stat_slot stats[EVL_TUBE_STAT_SLOTS];	\
+	long hwm;
+
+#define tube_stats_init(__tube)						\
+	do {								\
+		memset((__tube)->stats, 0, sizeof((__tube)->stats));	\
+		(__tube)->hwm = 0;					\
+	} while (0)
+
+#ifdef EVL_TUBE_STATS
+
+#define EVL_TUBE_STAT_SAMPLING	64	/* Must be a power of two. */
+
+static inline unsigned long *tube_stat_retries(void)
+{
+	static __thread unsigned long retries;
+
+	return &retries;
+}
+
+static inline struct evl_tube_stat_slot *
+tube_stat_get_slot(struct evl_tube_stat_slot *slots)
+{
+	static __thread int slot = -1;
+	static int next_slot;
+
+	if (slot < 0)
+		slot = __sync_fetch_and_add(&next_slot, 1) % EVL_TUBE_STAT_SLOTS;
+
+	return slots + slot;
+}
+
+/* Always true, so that it can be chained to a failed CAS test. */
+#define tube_note_retry()	({ (*tube_stat_retries())++; true; })
+
+#define tube_stat_occupancy(__tube)					\
+	({								\
+		long __occ = 0;						\
+		int __ns;						\
+		for (__ns = 0; __ns < EVL_TUBE_STAT_SLOTS; __ns++)	\
+			__occ += (long)(atomic_load(&(__tube)->stats[__ns].sent) - \
+				atomic_load(&(__tube)->stats[__ns].received)); \
+		__occ < 0 ? 0 : __occ;					\
+	})
+
+#define tube_stat_raise_hwm(__tube, __val)				\
+	do {								\
+		long __hwm, __v = (__val);				\
+		do {							\
+			__hwm = atomic_load(&(__tube)->hwm);		\
+			if (__v <= __hwm)				\
+				break;					\
+		} while (!__sync_bool_compare_and_swap(&(__tube)->hwm,	\
+							__hwm, __v));	\
+	} while (0)
+
+#define tube_stat_fold_retries(__slot)					\
+	do {								\
+		unsigned long *__r = tube_stat_retries();		\
+		if (*__r) {						\
+			__sync_fetch_and_add(&(__slot)->cas_retries, *__r); \
+			*__r = 0;					\
+		}							\
+	} while (0)
+
+#define tube_stat_send(__tube, __ok)					\
+	do {								\
+		struct evl_tube_stat_slot *__sl;			\
+		__sl = tube_stat_get_slot((__tube)->stats);		\
+		tube_stat_fold_retries(__sl);				\
+		if (!(__ok)) {						\
+			__sync_fetch_and_add(&__sl->send_failed, 1);	\
+			tube_stat_raise_hwm(__tube, (__tube)->max_items); \
+		} else if ((__sync_add_and_fetch(&__sl->sent, 1) &	\
+				(EVL_TUBE_STAT_SAMPLING - 1)) == 0)	\
+			tube_stat_raise_hwm(__tube,			\
+					tube_stat_occupancy(__tube));	\
+	} while (0)
+
+#define tube_stat_receive(__tube, __ok)					\
+	do {								\
+		struct evl_tube_stat_slot *__sl;			\
+		__sl = tube_stat_get_slot((__tube)->stats);		\
+		tube_stat_fold_retries(__sl);				\
+		if (__ok)						\
+			__sync_fetch_and_add(&__sl->received, 1);	\
+	} while (0)
+
+#define evl_get_tube_stats(__tube, __statp)				\
+	({								\
+		struct evl_tube_stats *__st = (__statp);		\
+		struct evl_tube_stat_slot *__sl;			\
+		int __ns;						\
+		memset(__st, 0, sizeof(*__st));				\
+		for (__ns = 0; __ns < EVL_TUBE_STAT_SLOTS; __ns++) {	\
+			__sl = &(__tube)->stats[__ns];			\
+			__st->sent += atomic_load(&__sl->sent);		\
+			__st->received += atomic_load(&__sl->received);	\
+			__st->send_failed += atomic_load(&__sl->send_failed); \
+			__st->cas_retries += atomic_load(&__sl->cas_retries); \
+		}							\
+		__st->occupancy = (long)(__st->sent - __st->received);	\
+		if (__st->occupancy < 0)				\
+			__st->occupancy = 0;				\
+		__st->hwm = atomic_load(&(__tube)->hwm);		\
+		if (__st->hwm < __st->occupancy)			\
+			__st->hwm = __st->occupancy;			\
+		true;							\
+	})
+
+#else  /* !EVL_TUBE_STATS */
+
+#define tube_note_retry()		true
+#define tube_stat_send(__tube, __ok)	do { } while (0)
+#define tube_stat_receive(__tube, __ok)	do { } while (0)
+
+#define evl_get_tube_stats(__tube, __statp)				\
+	({								\
+		struct evl_tube_stats *__st = (__statp);		\
+		*__st = (struct evl_tube_stats){ 0 };			\
+		false;							\
+	})
+
+#endif /* !EVL_TUBE_STATS */
 
 /*
  * The tricky one: pulling a canister from the tube. The noticeable
@@ -66,7 +230,8 @@
 				break;					\
 			__next_dq = atomic_load(&(__head_dq)->next);	\
 		} while (!__sync_bool_compare_and_swap(			\
-				&(__desc)->head, __head_dq, __next_dq)); \
+				&(__desc)->head, __head_dq, __next_dq) && \
+			tube_note_retry());				\
 		if (__head_dq && __next_dq == NULL) {			\
 			atomic_store(&(__desc)->head, __head_dq);	\
 			__head_dq = NULL;				\
@@ -91,7 +256,8 @@
 		do {							\
 			__old_qp = atomic_load(&(__desc)->tail);	\
 		} while (!__sync_bool_compare_and_swap(			\
-				&(__desc)->tail, __old_qp, __free));	\
+				&(__desc)->tail, __old_qp, __free) &&	\
+			tube_note_retry());				\
 		__old_qp;						\
   })
 
@@ -152,6 +318,7 @@
 		DECLARE_CANISTER_QUEUE(__can_struct) pending;	\
 		DECLARE_CANISTER_QUEUE(__can_struct) free;	\
 		long max_items;					\
+		__EVL_TUBE_STATS_DECL				\
 	}
 
 #define TUBE_INITIALIZER(__name)					\
@@ -190,6 +357,7 @@
 				__item, __new);			\
 			__ret = true;				\
 		}						\
+		tube_stat_send(__tube, __ret);			\
 		__ret;						\
 	})
 
@@ -203,9 +371,173 @@
 			tube_push(&(__tube)->free, __next);	\
 			__ret = true;				\
 		}						\
+		tube_stat_receive(__tube, __ret);		\
 		__ret;						\
 	})
 
+/*
+ * Heap-backed tubes. Canisters are allocated one by one from an
+ * evl_heap, so that the capacity of the tube can change while it is
+ * in use. Shrinking only releases canisters found in the free queue,
+ * i.e. it cannot take back canisters conveying pending messages, nor
+ * the one which happens to be the final element of the pending
+ * queue.
+ *
+ * The head canister of each queue is embedded into the tube
+ * descriptor, these ones move between queues like the others but
+ * must never be released to the heap, nor be counted as capacity.
+ */
+
+#define tube_canister_embedded(__tube, __can)				\
+	((void *)(__can) >= (void *)(__tube) &&				\
+		(void *)(__can) < (void *)((__tube) + 1))
+
+/*
+ * Allocate @__nr canisters, linking them through their ->next
+ * field. Nothing is left allocated on failure.
+ */
+#define tube_alloc_canisters(__tube, __heap, __nr)			\
+	({								\
+		typeof((__tube)->free.tail) __achain = NULL, __ca;	\
+		long __na;						\
+		for (__na = 0; __na < (__nr); __na++) {			\
+			__ca = (typeof(__ca))				\
+				evl_alloc_block(__heap, sizeof(*__ca));	\
+			if (__ca == NULL) {				\
+				while ((__ca = __achain) != NULL) {	\
+					__achain = __ca->next;		\
+					evl_free_block(__heap, __ca);	\
+				}					\
+				break;					\
+			}						\
+			__ca->next = __achain;				\
+			__achain = __ca;					\
+		}							\
+		__achain;						\
+	})
+
+/*
+ * Pull @__nr heap canisters from the free queue, linking them
+ * through their ->next field. Embedded canisters we come across are
+ * pushed back at the end of the free queue, which makes the former
+ * final element pullable in turn. We give up when only embedded
+ * canisters are left to pull, returning all heap canisters we got
+ * to the free queue.
+ */
+#define tube_pull_canisters(__tube, __nr)				\
+	({								\
+		typeof((__tube)->free.tail) __pchain = NULL, __cp;	\
+		long __np = 0;						\
+		int __nrembedded = 0;					\
+		while (__np < (__nr)) {					\
+			__cp = tube_pull(&(__tube)->free);		\
+			if (__cp == NULL)				\
+				break;					\
+			if (tube_canister_embedded(__tube, __cp)) {	\
+				tube_push(&(__tube)->free, __cp);	\
+				if (++__nrembedded > 2)			\
+					break;				\
+				continue;				\
+			}						\
+			__cp->next = __pchain;				\
+			__pchain = __cp;					\
+			__nrembedded = 0;				\
+			__np++;						\
+		}							\
+		if (__np < (__nr)) {					\
+			while ((__cp = __pchain) != NULL) {		\
+				__pchain = __cp->next;			\
+				tube_push(&(__tube)->free, __cp);	\
+			}						\
+		}							\
+		__pchain;						\
+	})
+
+/*
+ * Set the capacity of a heap-backed tube to @__count messages,
+ * returning the resulting capacity, or a negative error code:
+ * -ENOMEM if growing failed, -EAGAIN if too many canisters are
+ * conveying messages for shrinking down to @__count. The capacity is
+ * left unchanged on error.
+ *
+ * Resizing must be serialized by the caller, sending and receiving
+ * may go on concurrently.
+ */
+#define evl_resize_tube(__tube, __heap, __count)			\
+	({								\
+		typeof((__tube)->free.tail) __chain = NULL, __c;	\
+		long __cur = atomic_load(&(__tube)->max_items);		\
+		long __delta = (long)(__count) - __cur;			\
+		int __ret = 0;						\
+		if ((long)(__count) < 0)				\
+			__ret = -EINVAL;				\
+		else if (__delta > 0) {					\
+			__chain = tube_alloc_canisters(__tube, __heap,	\
+						__delta);		\
+			if (__chain == NULL)				\
+				__ret = -ENOMEM;			\
+			while ((__c = __chain) != NULL) {		\
+				__chain = __c->next;			\
+				tube_push(&(__tube)->free, __c);	\
+			}						\
+		} else if (__delta < 0) {				\
+			__chain = tube_pull_canisters(__tube, -__delta); \
+			if (__chain == NULL)				\
+				__ret = -EAGAIN;			\
+			while ((__c = __chain) != NULL) {		\
+				__chain = __c->next;			\
+				evl_free_block(__heap, __c);		\
+			}						\
+		}							\
+		if (!__ret && __delta)					\
+			__cur = __sync_add_and_fetch(&(__tube)->max_items, \
+						__delta);		\
+		__ret ?: (int)__cur;					\
+	})
+
+/*
+ * Release a heap-backed tube, discarding pending messages. The
+ * caller must make sure nobody else is using the tube anymore.
+ */
+#define evl_destroy_tube(__tube, __heap)				\
+	do {								\
+		typeof((__tube)->free.tail) __c;			\
+		while ((__c = tube_pull(&(__tube)->pending)) != NULL)	\
+			if (!tube_canister_embedded(__tube, __c))	\
+				evl_free_block(__heap, __c);		\
+		while ((__c = tube_pull(&(__tube)->free)) != NULL)	\
+			if (!tube_canister_embedded(__tube, __c))	\
+				evl_free_block(__heap, __c);		\
+		/* Each queue still holds its final canister. */	\
+		__c = (__tube)->pending.head;				\
+		if (!tube_canister_embedded(__tube, __c))		\
+			evl_free_block(__heap, __c);			\
+		__c = (__tube)->free.head;				\
+		if (!tube_canister_embedded(__tube, __c))		\
+			evl_free_block(__heap, __c);			\
+		evl_free_block(__heap, __tube);				\
+	} while (0)
+
+/*
+ * Allocate a tube of type @__name from @__heap, with room for
+ * @__count messages. Returns NULL if out of memory.
+ */
+#define evl_create_tube(__name, __heap, __count)			\
+	({								\
+		struct __name *__tube;					\
+		__tube = (typeof(__tube))				\
+			evl_alloc_block(__heap, sizeof(*__tube));	\
+		if (__tube) {						\
+			*__tube = (typeof(*__tube))			\
+				TUBE_INITIALIZER(*__tube);		\
+			if (evl_resize_tube(__tube, __heap, __count) < 0) { \
+				evl_destroy_tube(__tube, __heap);	\
+				__tube = NULL;				\
+			}						\
+		}							\
+		__tube;							\
+	})
+
 /*
  * Position-independent variant.
  */
@@ -220,7 +552,8 @@
 			__old_qp = atomic_load(&(__desc)->tail);	\
 		} while (__sync_val_compare_and_swap(			\
 				&(__desc)->tail,			\
-				__old_qp, __off_qp) != __old_qp);	\
+				__old_qp, __off_qp) != __old_qp &&	\
+			tube_note_retry());				\
 		__memptr(__base, __old_qp);				\
 	})
 
@@ -239,7 +572,8 @@
 				__memptr(__base, __head_dq);		\
 			__next_dq = atomic_load(&(__head_dqptr)->next);	\
 		} while (!__sync_bool_compare_and_swap(			\
-				&(__desc)->head, __head_dq, __next_dq)); \
+				&(__desc)->head, __head_dq, __next_dq) && \
+			tube_note_retry());				\
 		if (__head_dq && __next_dq == 0) {			\
 			atomic_store(&(__desc)->head, __head_dq);	\
 			__head_dqptr = NULL;				\
@@ -290,6 +624,7 @@
 		DECLARE_CANISTER_QUEUE_REL(__can_struct) pending;	\
 		DECLARE_CANISTER_QUEUE_REL(__can_struct) free;		\
 		long max_items;						\
+		__EVL_TUBE_STATS_DECL					\
 	}
 
 #define canq_offsetof(__baseoff, __can_struct, __member)		\
@@ -348,6 +683,7 @@
 					__item, __new);		\
 			__ret = true;				\
 		}						\
+		tube_stat_send(__tube, __ret);			\
 		__ret;						\
 	})
 
@@ -361,6 +697,224 @@
 			tube_push_rel(__tube, &(__tube)->free, __next); \
 			__ret = true;					\
 		}							\
+		tube_stat_receive(__tube, __ret);			\
+		__ret;							\
+	})
+
+/*
+ * Priority tube: one pending queue per priority level, sharing a
+ * single free queue. A bitmap tells which levels may have messages
+ * queued, so that receiving picks the highest priority level with a
+ * single bit scan. Level numbers increase with priority, up to
+ * EVL_TUBE_MAX_PRIO levels may be declared.
+ *
+ * A sender raises the bit of the target level after the message is
+ * visible in the queue. A receiver observing an empty level clears
+ * its bit, then checks the queue again for a message which might
+ * have been pushed in the meantime, raising the bit back if
+ * so. Therefore a set bit may denote an empty level temporarily, but
+ * a non-empty level always has its bit set eventually.
+ */
+
+#define EVL_TUBE_MAX_PRIO	32
+
+#ifdef __cplusplus
+#define tube_prio_check_levels(__nrprio)			\
+	static_assert((__nrprio) <= EVL_TUBE_MAX_PRIO,		\
+		"too many priority levels");
+#else
+#define tube_prio_check_levels(__nrprio)			\
+	_Static_assert((__nrprio) <= EVL_TUBE_MAX_PRIO,		\
+		"too many priority levels");
+#endif
+
+#define tube_prio_levels(__tube)				\
+	((int)(sizeof((__tube)->pending) / sizeof((__tube)->pending[0])))
+
+#define tube_prio_top(__bits)					\
+	((int)(sizeof(__bits) * __CHAR_BIT__) - 1 - __lzcount(__bits))
+
+#define tube_prio_mark(__tube, __prio)				\
+	__sync_fetch_and_or(&(__tube)->nonempty, 1U << (__prio))
+
+#define tube_prio_unmark(__tube, __prio)				\
+	__sync_fetch_and_and(&(__tube)->nonempty, ~(1U << (__prio)))
+
+#define DECLARE_EVL_TUBE_PRIO(__name, __can_struct, __nrprio)		\
+	struct __name {							\
+		tube_prio_check_levels(__nrprio)			\
+		DECLARE_CANISTER_QUEUE(__can_struct) pending[__nrprio];	\
+		DECLARE_CANISTER_QUEUE(__can_struct) free;		\
+		unsigned int nonempty;					\
+		long max_items;						\
+		__EVL_TUBE_STATS_DECL					\
+	}
+
+#define evl_get_tube_prio_size(__name, __count)	\
+	evl_get_tube_size(__name, __count)
+
+#define tube_init_canq(__q)						\
+	do {								\
+		(__q)->head = (__q)->tail = &(__q)->first;		\
+		(__q)->first.next = NULL;				\
+	} while (0)
+
+#define evl_init_tube_prio(__tube, __freevec, __count)		\
+	do {							\
+		typeof((__tube)->free.tail) __i;		\
+		int __n;					\
+		for (__n = 0; __n < tube_prio_levels(__tube); __n++) \
+			tube_init_canq(&(__tube)->pending[__n]); \
+		tube_init_canq(&(__tube)->free);		\
+		(__tube)->nonempty = 0;				\
+		tube_stats_init(__tube);			\
+		for (__n = 0, __i = (typeof(__i))(__freevec);	\
+		     __n < (__count); __n++, __i++)		\
+			tube_push(&(__tube)->free, __i);	\
+		(__tube)->max_items = (__count);		\
+	} while (0)
+
+#define evl_send_tube_prio(__tube, __item, __prio)		\
+	({							\
+		bool __ret = false;				\
+		typeof((__tube)->free.tail) __new;		\
+		__new = tube_pull(&(__tube)->free);		\
+		if (__new) {					\
+			tube_push_item(&(__tube)->pending[__prio], \
+				__item, __new);			\
+			tube_prio_mark(__tube, __prio);		\
+			__ret = true;				\
+		}						\
+		tube_stat_send(__tube, __ret);			\
+		__ret;						\
+	})
+
+/*
+ * A level is non-empty if its head canister has a successor. A NULL
+ * head means that a concurrent receiver is busy pulling the final
+ * canister, which will recheck the level by itself.
+ */
+#define tube_prio_pending(__tube, __prio)				\
+	({								\
+		typeof((__tube)->free.tail) __head_p;			\
+		__head_p = atomic_load(&(__tube)->pending[__prio].head); \
+		__head_p && atomic_load(&__head_p->next) != NULL;	\
+	})
+
+#define evl_receive_tube_prio(__tube, __item)				\
+	({								\
+		bool __ret = false;					\
+		typeof((__tube)->free.tail) __next;			\
+		unsigned int __bits;					\
+		int __prio;						\
+		while ((__bits = atomic_load(&(__tube)->nonempty)) != 0) { \
+			__prio = tube_prio_top(__bits);			\
+			__next = tube_pull(&(__tube)->pending[__prio]);	\
+			if (__next) {					\
+				__item = __next->payload;		\
+				tube_push(&(__tube)->free, __next);	\
+				__ret = true;				\
+				break;					\
+			}						\
+			tube_prio_unmark(__tube, __prio);		\
+			if (tube_prio_pending(__tube, __prio))		\
+				tube_prio_mark(__tube, __prio);		\
+		}							\
+		tube_stat_receive(__tube, __ret);			\
+		__ret;							\
+	})
+
+/*
+ * Position-independent variant of the priority tube.
+ */
+
+#define DECLARE_EVL_TUBE_PRIO_REL(__name, __can_struct, __payload, __nrprio) \
+	struct __name {							\
+		tube_prio_check_levels(__nrprio)			\
+		DECLARE_CANISTER_QUEUE_REL(__can_struct) pending[__nrprio]; \
+		DECLARE_CANISTER_QUEUE_REL(__can_struct) free;		\
+		unsigned int nonempty;					\
+		long max_items;						\
+		__EVL_TUBE_STATS_DECL					\
+	}
+
+#define evl_get_tube_prio_size_rel(__name, __count)	\
+	evl_get_tube_size(__name, __count)
+
+#define tube_init_canq_rel(__base, __q)					\
+	do {								\
+		(__q)->head = (__q)->tail =				\
+			__memoff(__base, &(__q)->first[0]);		\
+		(__q)->first[0].next = 0;				\
+	} while (0)
+
+#define evl_init_tube_prio_rel(__name, __can_struct, __mem, __size)	\
+	({								\
+		struct __name *__tube = (typeof(__tube))(__mem);	\
+		typeof(__tube->free.first[0]) *__i, *__iend;		\
+		long __nr = 0;						\
+		int __n;						\
+		for (__n = 0; __n < tube_prio_levels(__tube); __n++)	\
+			tube_init_canq_rel(__tube, &__tube->pending[__n]); \
+		tube_init_canq_rel(__tube, &__tube->free);		\
+		__tube->nonempty = 0;					\
+		tube_stats_init(__tube);				\
+		__iend = (typeof(__iend))((char *)__mem + __size);	\
+		for (__i = (typeof(__i))(__tube + 1); __i + 1 <= __iend; \
+		     __i++, __nr++)					\
+			tube_push_rel(__tube, &(__tube)->free, __i);	\
+		__tube->max_items = __nr;				\
+		__tube;							\
+	})
+
+#define evl_send_tube_prio_rel(__tube, __item, __prio)		\
+	({							\
+		bool __ret = false;				\
+		typeof((__tube)->free.first[0]) *__new;		\
+		__new = (typeof(__new))				\
+			tube_pull_rel(__tube, &(__tube)->free); \
+		if (__new) {					\
+			tube_push_item_rel(__tube,		\
+					&(__tube)->pending[__prio], \
+					__item, __new);		\
+			tube_prio_mark(__tube, __prio);		\
+			__ret = true;				\
+		}						\
+		tube_stat_send(__tube, __ret);			\
+		__ret;						\
+	})
+
+#define tube_prio_pending_rel(__tube, __prio)				\
+	({								\
+		typeof((__tube)->free.first[0]) *__head_p;		\
+		uintptr_t __head_off;					\
+		__head_off = atomic_load(&(__tube)->pending[__prio].head); \
+		__head_p = (typeof(__head_p))__memptr(__tube, __head_off); \
+		__head_off && atomic_load(&__head_p->next) != 0;	\
+	})
+
+#define evl_receive_tube_prio_rel(__tube, __item)			\
+	({								\
+		bool __ret = false;					\
+		typeof((__tube)->free.first[0]) *__next;		\
+		unsigned int __bits;					\
+		int __prio;						\
+		while ((__bits = atomic_load(&(__tube)->nonempty)) != 0) { \
+			__prio = tube_prio_top(__bits);			\
+			__next = (typeof(__next))			\
+				tube_pull_rel(__tube,			\
+					&(__tube)->pending[__prio]);	\
+			if (__next) {					\
+				__item = __next->payload;		\
+				tube_push_rel(__tube, &(__tube)->free, __next); \
+				__ret = true;				\
+				break;					\
+			}						\
+			tube_prio_unmark(__tube, __prio);		\
+			if (tube_prio_pending_rel(__tube, __prio))	\
+				tube_prio_mark(__tube, __prio);		\
+		}							\
+		tube_stat_receive(__tube, __ret);			\
 		__ret;							\
 	})
 
@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The timer wheel: a hierarchical timing wheel which multiplexes any
+ * number of software timers over a single EVL timer, armed for the
+ * earliest expiry. Starting, stopping and restarting a timer are
+ * constant-time operations which do not issue any system call,
+ * unless the new expiry precedes the date the EVL timer is set for.
+ * The wheel file descriptor may be monitored by evl_poll(), expired
+ * timers are handled in a batch by evl_run_timer_wheel().
+ */
+
+#ifndef _EVL_WHEEL_H
+#define _EVL_WHEEL_H
+
+#include <time.h>
+#include <stdbool.h>
+#include <linux/types.h>
+#include <evl/list.h>
+
+#define EVL_WHEEL_LEVELS	4
+#define EVL_WHEEL_SLOT_BITS	6
+#define EVL_WHEEL_SLOTS		(1 << EVL_WHEEL_SLOT_BITS)
+
+struct evl_wheel_timer;
+
+typedef void (*evl_wheel_handler_t)(struct evl_wheel_timer *timer);
+
+struct evl_wheel_timer {
+	evl_wheel_handler_t handler;
+	void *arg;
+	/* Private. */
+	struct evl_timer_wheel *wheel;
+	struct list_head next;
+	__u64 expiry;		/* In ticks */
+	__u64 interval;		/* In ticks, zero if one-shot */
+	unsigned int level;
+	unsigned int slot;
+};
+
+struct evl_timer_wheel {
+	int fd;
+	int clockfd;
+	int running;
+	__u64 resolution;	/* Nanoseconds per tick */
+	__u64 origin;		/* Date of tick #0 in nanoseconds */
+	__u64 now;		/* All timers up to this tick have fired */
+	__u64 armed;		/* Tick the EVL timer is set for */
+	__u64 occupied[EVL_WHEEL_LEVELS];
+	struct list_head slots[EVL_WHEEL_LEVELS][EVL_WHEEL_SLOTS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int evl_init_timer_wheel(struct evl_timer_wheel *wheel,
+			int clockfd, long resolution_ns);
+
+void evl_init_wheel_timer(struct evl_wheel_timer *timer,
+			evl_wheel_handler_t handler, void *arg);
+
+int evl_start_wheel_timer(struct evl_timer_wheel *wheel,
+			struct evl_wheel_timer *timer,
+			const struct timespec *date,
+			const struct timespec *interval);
+
+void evl_stop_wheel_timer(struct evl_wheel_timer *timer);
+
+static inline bool evl_wheel_timer_pending(struct evl_wheel_timer *timer)
+{
+	return timer->wheel != NULL;
+}
+
+int evl_run_timer_wheel(struct evl_timer_wheel *wheel);
+
+int evl_close_timer_wheel(struct evl_timer_wheel *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EVL_WHEEL_H */
@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_ARM_CORO_H
+#define _LIB_EVL_ARM_CORO_H
+
+#if defined(__ARM_PCS_VFP) || (defined(__VFP_FP__) && !defined(__SOFTFP__))
+#define __CORO_VFP_PUSH		"vpush {d8-d15}\n"
+#define __CORO_VFP_POP		"vpop {d8-d15}\n"
+#define __CORO_VFP_WORDS	16
+#else
+#define __CORO_VFP_PUSH		""
+#define __CORO_VFP_POP		""
+#define __CORO_VFP_WORDS	0
+#endif
+
+#ifdef __thumb__
+#define __CORO_CODE_MODE	".thumb\n"
+#else
+#define __CORO_CODE_MODE	".arm\n"
+#endif
+
+/*
+ * Coroutine context switch, to be included by a single translation
+ * unit. r4-r12, lr and d8-d15 if present are saved to the outgoing
+ * stack, the resulting stack pointer is stored at *@from_sp, then
+ * the same state is restored from @to_sp. r12 is only there to keep
+ * the stack 8-byte aligned. This code runs in ARM state, we switch
+ * back to the mode the compiler uses for the rest of the file.
+ *
+ * void __evl_coro_switch(void **from_sp, void *to_sp);
+ */
+__asm__(
+	".pushsection .text\n"
+	".syntax unified\n"
+	".arm\n"
+	".p2align 2\n"
+	".globl __evl_coro_switch\n"
+	".hidden __evl_coro_switch\n"
+	".type __evl_coro_switch, %function\n"
+"__evl_coro_switch:\n"
+	"push {r4-r12, lr}\n"
+	__CORO_VFP_PUSH
+	"str sp, [r0]\n"
+	"mov sp, r1\n"
+	__CORO_VFP_POP
+	"pop {r4-r12, pc}\n"
+	".size __evl_coro_switch, .-__evl_coro_switch\n"
+	".p2align 2\n"
+	".globl __evl_coro_trampoline\n"
+	".hidden __evl_coro_trampoline\n"
+	".type __evl_coro_trampoline, %function\n"
+"__evl_coro_trampoline:\n"
+	"mov r0, r5\n"
+	"blx r4\n"
+	"bkpt #0\n"
+	".size __evl_coro_trampoline, .-__evl_coro_trampoline\n"
+	__CORO_CODE_MODE
+	".popsection\n"
+);
+
+void __evl_coro_switch(void **from_sp, void *to_sp)
+	__attribute__((visibility("hidden")));
+
+void __evl_coro_trampoline(void)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Build the initial frame of a coroutine, so that switching to it
+ * returns to the trampoline, which calls @entry(@arg).
+ */
+static inline void *evl_coro_init_stack(void *top,
+					void (*entry)(void *), void *arg)
+{
+	unsigned long *sp = (unsigned long *)((unsigned long)top & ~7UL);
+	int n;
+
+	sp -= __CORO_VFP_WORDS + 10;
+	for (n = 0; n < __CORO_VFP_WORDS + 10; n++)
+		sp[n] = 0;
+
+	sp[__CORO_VFP_WORDS] = (unsigned long)entry;	/* r4 */
+	sp[__CORO_VFP_WORDS + 1] = (unsigned long)arg;	/* r5 */
+	sp[__CORO_VFP_WORDS + 9] = (unsigned long)__evl_coro_trampoline; /* pc */
+
+	return sp;
+}
+
+#endif /* !_LIB_EVL_ARM_CORO_H */
@@ -0,0 +1,14 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_ARM_PROCESSOR_H
+#define _LIB_EVL_ARM_PROCESSOR_H
+
+#if __ARM_ARCH >= 7
+#define cpu_relax()	__asm__ __volatile__("yield" : : : "memory")
+#else
+#define cpu_relax()	__asm__ __volatile__("" : : : "memory")
+#endif
+
+#endif /* !_LIB_EVL_ARM_PROCESSOR_H */
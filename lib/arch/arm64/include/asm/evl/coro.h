@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_ARM64_CORO_H
+#define _LIB_EVL_ARM64_CORO_H
+
+/*
+ * Coroutine context switch, to be included by a single translation
+ * unit. x19-x30 and d8-d15 are saved to the outgoing stack, the
+ * resulting stack pointer is stored at *@from_sp, then the same
+ * state is restored from @to_sp.
+ *
+ * void __evl_coro_switch(void **from_sp, void *to_sp);
+ */
+__asm__(
+	".pushsection .text\n"
+	".p2align 4\n"
+	".globl __evl_coro_switch\n"
+	".hidden __evl_coro_switch\n"
+	".type __evl_coro_switch, %function\n"
+"__evl_coro_switch:\n"
+	"sub sp, sp, #160\n"
+	"stp x19, x20, [sp, #0]\n"
+	"stp x21, x22, [sp, #16]\n"
+	"stp x23, x24, [sp, #32]\n"
+	"stp x25, x26, [sp, #48]\n"
+	"stp x27, x28, [sp, #64]\n"
+	"stp x29, x30, [sp, #80]\n"
+	"stp d8, d9, [sp, #96]\n"
+	"stp d10, d11, [sp, #112]\n"
+	"stp d12, d13, [sp, #128]\n"
+	"stp d14, d15, [sp, #144]\n"
+	"mov x9, sp\n"
+	"str x9, [x0]\n"
+	"mov sp, x1\n"
+	"ldp x19, x20, [sp, #0]\n"
+	"ldp x21, x22, [sp, #16]\n"
+	"ldp x23, x24, [sp, #32]\n"
+	"ldp x25, x26, [sp, #48]\n"
+	"ldp x27, x28, [sp, #64]\n"
+	"ldp x29, x30, [sp, #80]\n"
+	"ldp d8, d9, [sp, #96]\n"
+	"ldp d10, d11, [sp, #112]\n"
+	"ldp d12, d13, [sp, #128]\n"
+	"ldp d14, d15, [sp, #144]\n"
+	"add sp, sp, #160\n"
+	"ret\n"
+	".size __evl_coro_switch, .-__evl_coro_switch\n"
+	".p2align 4\n"
+	".globl __evl_coro_trampoline\n"
+	".hidden __evl_coro_trampoline\n"
+	".type __evl_coro_trampoline, %function\n"
+"__evl_coro_trampoline:\n"
+	"mov x0, x20\n"
+	"blr x19\n"
+	"brk #0\n"
+	".size __evl_coro_trampoline, .-__evl_coro_trampoline\n"
+	".popsection\n"
+);
+
+void __evl_coro_switch(void **from_sp, void *to_sp)
+	__attribute__((visibility("hidden")));
+
+void __evl_coro_trampoline(void)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Build the initial frame of a coroutine, so that switching to it
+ * returns to the trampoline, which calls @entry(@arg).
+ */
+static inline void *evl_coro_init_stack(void *top,
+					void (*entry)(void *), void *arg)
+{
+	unsigned long *sp = (unsigned long *)((unsigned long)top & ~15UL);
+	int n;
+
+	sp -= 20;
+	for (n = 0; n < 20; n++)
+		sp[n] = 0;
+
+	sp[0] = (unsigned long)entry;	/* x19 */
+	sp[1] = (unsigned long)arg;	/* x20 */
+	sp[11] = (unsigned long)__evl_coro_trampoline; /* x30 */
+
+	return sp;
+}
+
+#endif /* !_LIB_EVL_ARM64_CORO_H */
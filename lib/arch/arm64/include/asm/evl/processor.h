@@ -0,0 +1,10 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_ARM64_PROCESSOR_H
+#define _LIB_EVL_ARM64_PROCESSOR_H
+
+#define cpu_relax()	__asm__ __volatile__("yield" : : : "memory")
+
+#endif /* !_LIB_EVL_ARM64_PROCESSOR_H */
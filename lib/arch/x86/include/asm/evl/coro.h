@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_X86_CORO_H
+#define _LIB_EVL_X86_CORO_H
+
+/*
+ * Coroutine context switch, to be included by a single translation
+ * unit. The callee-saved registers, MXCSR and the x87 control word
+ * are pushed to the outgoing stack, the resulting stack pointer is
+ * stored at *@from_sp, then the same state is popped from @to_sp.
+ *
+ * void __evl_coro_switch(void **from_sp, void *to_sp);
+ */
+__asm__(
+	".pushsection .text\n"
+	".p2align 4\n"
+	".globl __evl_coro_switch\n"
+	".hidden __evl_coro_switch\n"
+	".type __evl_coro_switch, @function\n"
+"__evl_coro_switch:\n"
+	"pushq %rbp\n"
+	"pushq %rbx\n"
+	"pushq %r12\n"
+	"pushq %r13\n"
+	"pushq %r14\n"
+	"pushq %r15\n"
+	"subq $8, %rsp\n"
+	"stmxcsr (%rsp)\n"
+	"fnstcw 4(%rsp)\n"
+	"movq %rsp, (%rdi)\n"
+	"movq %rsi, %rsp\n"
+	"ldmxcsr (%rsp)\n"
+	"fldcw 4(%rsp)\n"
+	"addq $8, %rsp\n"
+	"popq %r15\n"
+	"popq %r14\n"
+	"popq %r13\n"
+	"popq %r12\n"
+	"popq %rbx\n"
+	"popq %rbp\n"
+	"ret\n"
+	".size __evl_coro_switch, .-__evl_coro_switch\n"
+	".p2align 4\n"
+	".globl __evl_coro_trampoline\n"
+	".hidden __evl_coro_trampoline\n"
+	".type __evl_coro_trampoline, @function\n"
+"__evl_coro_trampoline:\n"
+	"movq %r12, %rdi\n"
+	"callq *%r13\n"
+	"ud2\n"
+	".size __evl_coro_trampoline, .-__evl_coro_trampoline\n"
+	".popsection\n"
+);
+
+void __evl_coro_switch(void **from_sp, void *to_sp)
+	__attribute__((visibility("hidden")));
+
+void __evl_coro_trampoline(void)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Build the initial frame of a coroutine, so that switching to it
+ * returns to the trampoline, which calls @entry(@arg) with a 16-byte
+ * aligned stack as the ABI requires.
+ */
+static inline void *evl_coro_init_stack(void *top,
+					void (*entry)(void *), void *arg)
+{
+	unsigned long *sp = (unsigned long *)((unsigned long)top & ~15UL);
+
+	*--sp = (unsigned long)__evl_coro_trampoline;
+	*--sp = 0;			/* rbp */
+	*--sp = 0;			/* rbx */
+	*--sp = (unsigned long)arg;	/* r12 */
+	*--sp = (unsigned long)entry;	/* r13 */
+	*--sp = 0;			/* r14 */
+	*--sp = 0;			/* r15 */
+	*--sp = 0x1f80UL | (0x037fUL << 32); /* Default MXCSR, x87 CW */
+
+	return sp;
+}
+
+#endif /* !_LIB_EVL_X86_CORO_H */
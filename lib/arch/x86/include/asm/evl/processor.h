@@ -0,0 +1,10 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _LIB_EVL_X86_PROCESSOR_H
+#define _LIB_EVL_X86_PROCESSOR_H
+
+#define cpu_relax()	__asm__ __volatile__("pause" : : : "memory")
+
+#endif /* !_LIB_EVL_X86_PROCESSOR_H */
@@ -0,0 +1,114 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/sem.h>
+#include <evl/barrier.h>
+
+#define __BARRIER_ACTIVE_MAGIC	0xba77ba77
+#define __BARRIER_DEAD_MAGIC	0
+
+int evl_create_barrier(struct evl_barrier *bar,
+		int clockfd, int count,
+		const char *fmt, ...)
+{
+	char *name = NULL;
+	int ret, n;
+	va_list ap;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	if (fmt) {
+		va_start(ap, fmt);
+		ret = vasprintf(&name, fmt, ap);
+		va_end(ap);
+		if (ret < 0)
+			return -ENOMEM;
+		/*
+		 * The arrival count lives in the caller's memory,
+		 * other processes could not share it.
+		 */
+		if (*name == '/') {
+			free(name);
+			return -EINVAL;
+		}
+	}
+
+	for (n = 0; n < 2; n++) {
+		ret = evl_create_sem(bar->sems + n, clockfd, 0, 0,
+				name ? "%s.%d" : NULL, name, n);
+		if (ret < 0)
+			goto fail;
+	}
+
+	bar->count = count;
+	bar->remaining = count;
+	bar->gen = 0;
+	bar->magic = __BARRIER_ACTIVE_MAGIC;
+	free(name);
+
+	return 0;
+fail:
+	while (--n >= 0)
+		evl_close_sem(bar->sems + n);
+
+	free(name);
+
+	return ret;
+}
+
+int evl_close_barrier(struct evl_barrier *bar)
+{
+	if (bar->magic != __BARRIER_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	bar->magic = __BARRIER_DEAD_MAGIC;
+	evl_close_sem(bar->sems + 1);
+
+	return evl_close_sem(bar->sems);
+}
+
+/*
+ * Returns EVL_BARRIER_SERIAL to the last arrival, zero to others.
+ * The generation number can only move on once we have arrived, so
+ * sampling it beforehand tells us which cycle we belong to.
+ */
+int evl_wait_barrier(struct evl_barrier *bar)
+{
+	struct evl_sem *sem;
+	unsigned int gen;
+	int ret;
+
+	if (bar->magic != __BARRIER_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	gen = atomic_load(&bar->gen);
+	sem = bar->sems + (gen & 1);
+
+	if (__sync_sub_and_fetch(&bar->remaining, 1) > 0) {
+		/* Leaving early would leave a stray unit behind. */
+		do
+			ret = evl_get_sem(sem);
+		while (ret == -EINTR);
+		return ret;
+	}
+
+	atomic_store(&bar->remaining, bar->count);
+	smp_mb();
+	atomic_store(&bar->gen, gen + 1);
+
+	if (bar->count > 1) {
+		ret = evl_put_sem_n(sem, bar->count - 1);
+		if (ret)
+			return ret;
+	}
+
+	return EVL_BARRIER_SERIAL;
+}
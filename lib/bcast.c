@@ -0,0 +1,298 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <evl/bcast.h>
+
+#define __BCAST_MAGIC	0xbca5bca5
+
+/*
+ * Sequence numbers are free-running 32bit counters, distances are
+ * always computed by unsigned subtraction so that wrapping is
+ * harmless. The producer is the only writer of the head index, each
+ * reader is the only writer of its own cursor.
+ */
+
+static inline size_t get_stride(struct evl_bcast_state *st)
+{
+	return __align_to((size_t)st->item_size, sizeof(long));
+}
+
+static inline void *get_slot(struct evl_bcast *bc, __u32 seq)
+{
+	struct evl_bcast_state *st = bc->state;
+
+	return (char *)bc->slots + (seq & (st->count - 1)) * get_stride(st);
+}
+
+static struct evl_bcast_cursor *
+get_cursor(struct evl_bcast *bc, int reader)
+{
+	struct evl_bcast_state *st = bc->state;
+
+	if (reader < 0 || reader >= (int)st->max_readers)
+		return NULL;
+
+	return st->cursors + reader;
+}
+
+int evl_init_bcast(struct evl_bcast *bc,
+		void *mem, size_t size,
+		size_t item_size, int count,
+		int max_readers,
+		struct evl_mutex *lock,
+		struct evl_event *event)
+{
+	struct evl_bcast_state *st = mem;
+
+	if (item_size == 0 || item_size > UINT_MAX)
+		return -EINVAL;
+
+	if (count < 2 || (count & (count - 1)))
+		return -EINVAL;
+
+	if (max_readers <= 0 || max_readers > EVL_BCAST_MAX_READERS)
+		return -EINVAL;
+
+	if (size < evl_get_bcast_size(item_size, count, max_readers))
+		return -ENOSPC;
+
+	memset(st, 0, __EVL_BCAST_HDR_SIZE(max_readers));
+	st->item_size = item_size;
+	st->count = count;
+	st->max_readers = max_readers;
+	smp_mb();
+	atomic_store(&st->magic, __BCAST_MAGIC);
+
+	return evl_bind_bcast(bc, mem, lock, event);
+}
+
+int evl_bind_bcast(struct evl_bcast *bc, void *mem,
+		struct evl_mutex *lock,
+		struct evl_event *event)
+{
+	struct evl_bcast_state *st = mem;
+
+	if (atomic_load(&st->magic) != __BCAST_MAGIC)
+		return -EINVAL;
+
+	bc->state = st;
+	bc->slots = (char *)mem + __EVL_BCAST_HDR_SIZE(st->max_readers);
+	bc->lock = lock;
+	bc->event = event;
+
+	return 0;
+}
+
+int evl_add_bcast_reader(struct evl_bcast *bc)
+{
+	struct evl_bcast_state *st = bc->state;
+	struct evl_bcast_cursor *c;
+	int n;
+
+	for (n = 0; n < (int)st->max_readers; n++) {
+		c = st->cursors + n;
+		if (atomic_load(&c->active))
+			continue;
+		if (!__sync_bool_compare_and_swap(&c->active, 0, 1))
+			continue;
+		/*
+		 * The producer may observe a stale cursor until we
+		 * store the current head, which can only cause
+		 * spurious back-pressure. Conversely, the gate it may
+		 * have cached earlier cannot be ahead of the head
+		 * index we read here, so our start slot is safe.
+		 */
+		atomic_store(&c->seq, atomic_load(&st->head));
+		smp_mb();
+		return n;
+	}
+
+	return -EAGAIN;
+}
+
+int evl_del_bcast_reader(struct evl_bcast *bc, int reader)
+{
+	struct evl_bcast_cursor *c;
+
+	c = get_cursor(bc, reader);
+	if (c == NULL || !atomic_load(&c->active))
+		return -EINVAL;
+
+	smp_mb();
+	atomic_store(&c->active, 0);
+
+	return 0;
+}
+
+/*
+ * Find the slowest active reader. We track the largest lag behind
+ * the head rather than the smallest sequence, so that wrapping
+ * counters compare correctly.
+ */
+static __u32 scan_gate(struct evl_bcast_state *st, __u32 head)
+{
+	struct evl_bcast_cursor *c;
+	__u32 lag, maxlag = 0;
+	int n;
+
+	for (n = 0; n < (int)st->max_readers; n++) {
+		c = st->cursors + n;
+		if (!atomic_load(&c->active))
+			continue;
+		lag = head - atomic_load(&c->seq);
+		if (lag > maxlag)
+			maxlag = lag;
+	}
+
+	return head - maxlag;
+}
+
+static int wake_readers(struct evl_bcast *bc)
+{
+	int ret;
+
+	ret = evl_lock_mutex(bc->lock);
+	if (ret)
+		return ret;
+
+	ret = evl_broadcast_event(bc->event);
+	evl_unlock_mutex(bc->lock);
+
+	return ret;
+}
+
+int evl_send_bcast(struct evl_bcast *bc, const void *item)
+{
+	struct evl_bcast_state *st = bc->state;
+	__u32 head, gate;
+
+	head = st->head;
+
+	/*
+	 * Rescan the cursors only when the cached gate says the ring
+	 * is full, the producer runs without touching the reader
+	 * cachelines otherwise.
+	 */
+	if (head - st->gate >= st->count) {
+		gate = scan_gate(st, head);
+		st->gate = gate;
+		if (head - gate >= st->count)
+			return -EAGAIN;
+	}
+
+	memcpy(get_slot(bc, head), item, st->item_size);
+	smp_mb();
+	atomic_store(&st->head, head + 1);
+	smp_mb();
+
+	/* Involve the kernel only if some reader is about to sleep. */
+	if (bc->event && atomic_load(&st->waiters))
+		return wake_readers(bc);
+
+	return 0;
+}
+
+int evl_read_bcast(struct evl_bcast *bc, int reader, void *item)
+{
+	struct evl_bcast_state *st = bc->state;
+	struct evl_bcast_cursor *c;
+	__u32 seq;
+
+	c = get_cursor(bc, reader);
+	if (c == NULL || !atomic_load(&c->active))
+		return -EINVAL;
+
+	seq = c->seq;
+	if (atomic_load(&st->head) == seq)
+		return -EAGAIN;
+
+	smp_mb();
+	memcpy(item, get_slot(bc, seq), st->item_size);
+	smp_mb();
+	atomic_store(&c->seq, seq + 1);
+
+	return 0;
+}
+
+/*
+ * Readers count themselves as waiters and recheck the head under
+ * the lock before sleeping on the event. Since the producer
+ * publishes the head before looking at the waiter count, and grabs
+ * the lock before broadcasting the event, no wake up can be missed.
+ * A flag group would not do here: the first waiter receiving the
+ * bits consumes them, we need every sleeping reader to wake up.
+ */
+static int wait_bcast(struct evl_bcast *bc, int reader, void *item,
+		const struct timespec *timeout)
+{
+	struct evl_bcast_state *st = bc->state;
+	int ret;
+
+	if (bc->event == NULL)
+		return -EINVAL;
+
+	ret = evl_read_bcast(bc, reader, item);
+	if (ret != -EAGAIN)
+		return ret;
+
+	ret = evl_lock_mutex(bc->lock);
+	if (ret)
+		return ret;
+
+	for (;;) {
+		__sync_fetch_and_add(&st->waiters, 1);
+		ret = evl_read_bcast(bc, reader, item);
+		if (ret != -EAGAIN)
+			break;
+
+		if (timeout)
+			ret = evl_timedwait_event(bc->event, bc->lock, timeout);
+		else
+			ret = evl_wait_event(bc->event, bc->lock);
+
+		__sync_fetch_and_sub(&st->waiters, 1);
+		if (ret)
+			goto out;
+	}
+
+	__sync_fetch_and_sub(&st->waiters, 1);
+out:
+	evl_unlock_mutex(bc->lock);
+
+	return ret;
+}
+
+int evl_timedwait_bcast(struct evl_bcast *bc, int reader, void *item,
+			const struct timespec *timeout)
+{
+	if (timeout == NULL)
+		return -EINVAL;
+
+	return wait_bcast(bc, reader, item, timeout);
+}
+
+int evl_wait_bcast(struct evl_bcast *bc, int reader, void *item)
+{
+	return wait_bcast(bc, reader, item, NULL);
+}
+
+int evl_get_bcast_backlog(struct evl_bcast *bc, int reader)
+{
+	struct evl_bcast_cursor *c;
+
+	c = get_cursor(bc, reader);
+	if (c == NULL || !atomic_load(&c->active))
+		return -EINVAL;
+
+	return atomic_load(&bc->state->head) - atomic_load(&c->seq);
+}
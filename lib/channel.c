@@ -0,0 +1,449 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/flags.h>
+#include <evl/tube.h>
+#include <evl/channel.h>
+
+#define __CHANNEL_MAGIC		0xc4a1c4a1
+
+/*
+ * The tubes convey buffer indices: the pending tube carries the
+ * messages, the free tube the buffers available to senders.
+ */
+DECLARE_EVL_CANISTER_REL(channel_canister, __u32);
+DECLARE_EVL_TUBE_REL(channel_tube, channel_canister, __u32);
+
+struct evl_channel_state {
+	__u32 magic;
+	__u32 item_size;
+	__u32 stride;
+	__u32 count;
+	__u32 waiters;
+	__u64 pending_offset;
+	__u64 free_offset;
+	__u64 data_offset;
+	__u64 size;
+};
+
+/*
+ * Both sides of a channel refer to it by name. The shared memory
+ * segment is named after it, so is the flag group, minus the leading
+ * slash.
+ */
+static int get_channel_name(const char *fmt, va_list ap, char **r_name)
+{
+	char *name, *base;
+	int ret;
+
+	ret = vasprintf(&name, fmt, ap);
+	if (ret < 0)
+		return -ENOMEM;
+
+	base = name;
+	if (*base == '/')
+		base++;
+
+	if (*base == '\0' || strchr(base, '/')) {
+		free(name);
+		return -EINVAL;
+	}
+
+	ret = asprintf(r_name, "/%s", base);
+	free(name);
+	if (ret < 0)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void bind_channel(struct evl_channel *ch,
+			struct evl_channel_state *state)
+{
+	ch->state = state;
+	ch->pending = (char *)state + state->pending_offset;
+	ch->free = (char *)state + state->free_offset;
+	ch->data = (char *)state + state->data_offset;
+	ch->size = state->size;
+}
+
+int evl_create_channel(struct evl_channel *ch,
+		size_t item_size, int count,
+		const char *fmt, ...)
+{
+	size_t tube_size, size, stride, pending_off, free_off, data_off;
+	struct evl_channel_state *state;
+	struct channel_tube *tube;
+	int ret, efd, fd, n;
+	char *name;
+	void *mem;
+	va_list ap;
+
+	if (item_size == 0 || item_size > UINT32_MAX || count <= 0)
+		return -EINVAL;
+
+	va_start(ap, fmt);
+	ret = get_channel_name(fmt, ap, &name);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	stride = __align_to(item_size, 64);
+	tube_size = evl_get_tube_size_rel(channel_tube, count);
+	pending_off = __align_to(sizeof(*state), 64);
+	free_off = pending_off + __align_to(tube_size, 64);
+	data_off = free_off + __align_to(tube_size, 64);
+	size = data_off + stride * count;
+
+	efd = evl_create_flags(&ch->flags, EVL_CLOCK_MONOTONIC, 0,
+			EVL_CLONE_PUBLIC, "%s", name + 1);
+	if (efd < 0) {
+		ret = efd;
+		goto fail_flags;
+	}
+
+	fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		ret = -errno;
+		goto fail_shm;
+	}
+
+	ret = ftruncate(fd, size);
+	if (ret) {
+		ret = -errno;
+		goto fail_map;
+	}
+
+	mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		ret = -errno;
+		goto fail_map;
+	}
+
+	close(fd);
+
+	state = mem;
+	state->item_size = item_size;
+	state->stride = stride;
+	state->count = count;
+	state->waiters = 0;
+	state->pending_offset = pending_off;
+	state->free_offset = free_off;
+	state->data_offset = data_off;
+	state->size = size;
+
+	evl_init_tube_rel(channel_tube, channel_canister,
+			(char *)mem + pending_off, tube_size);
+	tube = evl_init_tube_rel(channel_tube, channel_canister,
+				(char *)mem + free_off, tube_size);
+	for (n = 0; n < count; n++)
+		evl_send_tube_rel(tube, (__u32)n);
+
+	smp_mb();
+	atomic_store(&state->magic, __CHANNEL_MAGIC);
+	bind_channel(ch, state);
+	ch->name = name;
+
+	return efd;
+
+fail_map:
+	close(fd);
+	shm_unlink(name);
+fail_shm:
+	evl_close_flags(&ch->flags);
+fail_flags:
+	free(name);
+
+	return ret;
+}
+
+int evl_open_channel(struct evl_channel *ch, const char *fmt, ...)
+{
+	struct evl_channel_state *state;
+	int ret, efd, fd;
+	struct stat st;
+	char *name;
+	void *mem;
+	va_list ap;
+
+	va_start(ap, fmt);
+	ret = get_channel_name(fmt, ap, &name);
+	va_end(ap);
+	if (ret)
+		return ret;
+
+	efd = evl_open_flags(&ch->flags, "%s", name + 1);
+	if (efd < 0) {
+		ret = efd;
+		goto fail_flags;
+	}
+
+	fd = shm_open(name, O_RDWR|O_CLOEXEC, 0);
+	if (fd < 0) {
+		ret = -errno;
+		goto fail_shm;
+	}
+
+	ret = fstat(fd, &st);
+	if (ret) {
+		ret = -errno;
+		goto fail_map;
+	}
+
+	if ((size_t)st.st_size < sizeof(*state)) {
+		ret = -EINVAL;
+		goto fail_map;
+	}
+
+	mem = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		ret = -errno;
+		goto fail_map;
+	}
+
+	close(fd);
+
+	state = mem;
+	if (atomic_load(&state->magic) != __CHANNEL_MAGIC ||
+		state->size != (__u64)st.st_size) {
+		munmap(mem, st.st_size);
+		ret = -EINVAL;
+		goto fail_shm;
+	}
+
+	bind_channel(ch, state);
+	ch->name = NULL;
+	free(name);
+
+	return efd;
+
+fail_map:
+	close(fd);
+fail_shm:
+	evl_close_flags(&ch->flags);
+fail_flags:
+	free(name);
+
+	return ret;
+}
+
+int evl_close_channel(struct evl_channel *ch)
+{
+	if (ch->state == NULL)
+		return -EINVAL;
+
+	munmap(ch->state, ch->size);
+	ch->state = NULL;
+
+	/*
+	 * The creator drops the name, peers which have the channel
+	 * open may keep on using it.
+	 */
+	if (ch->name) {
+		shm_unlink(ch->name);
+		free(ch->name);
+		ch->name = NULL;
+	}
+
+	return evl_close_flags(&ch->flags);
+}
+
+static inline void *get_buffer(struct evl_channel *ch, __u32 idx)
+{
+	return (char *)ch->data + (size_t)idx * ch->state->stride;
+}
+
+static int get_index(struct evl_channel *ch, void *buf)
+{
+	struct evl_channel_state *state = ch->state;
+	size_t off;
+
+	if ((char *)buf < (char *)ch->data)
+		return -EINVAL;
+
+	off = (char *)buf - (char *)ch->data;
+	if (off % state->stride || off / state->stride >= state->count)
+		return -EINVAL;
+
+	return off / state->stride;
+}
+
+void *evl_get_channel_buffer(struct evl_channel *ch)
+{
+	struct channel_tube *tube = ch->free;
+	__u32 idx;
+
+	if (!evl_receive_tube_rel(tube, idx))
+		return NULL;
+
+	return get_buffer(ch, idx);
+}
+
+int evl_release_channel_buffer(struct evl_channel *ch, void *buf)
+{
+	struct channel_tube *tube = ch->free;
+	int idx;
+
+	idx = get_index(ch, buf);
+	if (idx < 0)
+		return idx;
+
+	/* There are as many canisters as buffers, cannot fail. */
+	evl_send_tube_rel(tube, (__u32)idx);
+
+	return 0;
+}
+
+int evl_send_channel_buffer(struct evl_channel *ch, void *buf)
+{
+	struct evl_channel_state *state = ch->state;
+	struct channel_tube *tube = ch->pending;
+	int idx;
+
+	idx = get_index(ch, buf);
+	if (idx < 0)
+		return idx;
+
+	evl_send_tube_rel(tube, (__u32)idx);
+	smp_mb();
+
+	/* Enter the kernel only if the receiving side is sleeping. */
+	if (atomic_load(&state->waiters))
+		return evl_post_flags(&ch->flags, 1);
+
+	return 0;
+}
+
+int evl_tryreceive_channel_buffer(struct evl_channel *ch, void **bufp)
+{
+	struct channel_tube *tube = ch->pending;
+	__u32 idx;
+
+	if (!evl_receive_tube_rel(tube, idx))
+		return -EAGAIN;
+
+	*bufp = get_buffer(ch, idx);
+
+	return 0;
+}
+
+/*
+ * Receivers advertise themselves before rechecking the pending tube
+ * then sleeping on the flag group, so that senders know when to post
+ * it. Since a post wakes up a single receiver, the one which gets a
+ * message passes the wake up on if others are still waiting.
+ */
+static int receive_buffer(struct evl_channel *ch, void **bufp,
+			const struct timespec *timeout)
+{
+	struct evl_channel_state *state = ch->state;
+	int ret, bits, nrwait;
+
+	for (;;) {
+		ret = evl_tryreceive_channel_buffer(ch, bufp);
+		if (ret != -EAGAIN)
+			return ret;
+
+		__sync_fetch_and_add(&state->waiters, 1);
+
+		ret = evl_tryreceive_channel_buffer(ch, bufp);
+		if (ret != -EAGAIN) {
+			__sync_fetch_and_sub(&state->waiters, 1);
+			return ret;
+		}
+
+		if (timeout)
+			ret = evl_timedwait_flags(&ch->flags, timeout, &bits);
+		else
+			ret = evl_wait_flags(&ch->flags, &bits);
+
+		nrwait = __sync_sub_and_fetch(&state->waiters, 1);
+		if (ret)
+			return ret;
+
+		ret = evl_tryreceive_channel_buffer(ch, bufp);
+		if (ret == -EAGAIN)
+			continue;
+
+		if (nrwait > 0)
+			evl_post_flags(&ch->flags, 1);
+
+		return ret;
+	}
+}
+
+int evl_timedreceive_channel_buffer(struct evl_channel *ch, void **bufp,
+				const struct timespec *timeout)
+{
+	if (timeout == NULL)
+		return -EINVAL;
+
+	return receive_buffer(ch, bufp, timeout);
+}
+
+int evl_receive_channel_buffer(struct evl_channel *ch, void **bufp)
+{
+	return receive_buffer(ch, bufp, NULL);
+}
+
+int evl_send_channel(struct evl_channel *ch, const void *item)
+{
+	void *buf;
+
+	buf = evl_get_channel_buffer(ch);
+	if (buf == NULL)
+		return -EAGAIN;
+
+	memcpy(buf, item, ch->state->item_size);
+
+	return evl_send_channel_buffer(ch, buf);
+}
+
+static int receive_item(struct evl_channel *ch, void *item,
+			const struct timespec *timeout)
+{
+	void *buf;
+	int ret;
+
+	ret = receive_buffer(ch, &buf, timeout);
+	if (ret)
+		return ret;
+
+	memcpy(item, buf, ch->state->item_size);
+
+	return evl_release_channel_buffer(ch, buf);
+}
+
+int evl_timedreceive_channel(struct evl_channel *ch, void *item,
+			const struct timespec *timeout)
+{
+	if (timeout == NULL)
+		return -EINVAL;
+
+	return receive_item(ch, item, timeout);
+}
+
+int evl_receive_channel(struct evl_channel *ch, void *item)
+{
+	return receive_item(ch, item, NULL);
+}
+
+size_t evl_get_channel_item_size(struct evl_channel *ch)
+{
+	return ch->state->item_size;
+}
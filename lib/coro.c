@@ -0,0 +1,293 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/syscall.h>
+#include <evl/sem.h>
+#include <evl/poll.h>
+#include <evl/coro.h>
+#include <asm/evl/coro.h>
+
+#define CORO_READY	0
+#define CORO_WAITING	1
+#define CORO_DONE	2
+
+#ifndef __evl_sem_fd
+#define __evl_sem_fd(__sem)	((__sem)->u.active.efd)
+#endif
+
+/* The scheduler running on the current thread, if any. */
+static __thread struct evl_coro_sched *current_sched;
+
+int evl_init_coro_sched(struct evl_coro_sched *sched, int batch)
+{
+	if (batch <= 0)
+		return -EINVAL;
+
+	sched->events = malloc(batch * sizeof(*sched->events));
+	if (sched->events == NULL)
+		return -ENOMEM;
+
+	sched->pollfd = evl_new_poll();
+	if (sched->pollfd < 0) {
+		free(sched->events);
+		return sched->pollfd;
+	}
+
+	sched->batch = batch;
+	sched->nr_coros = 0;
+	sched->current = NULL;
+	list_init(&sched->runq);
+
+	return 0;
+}
+
+static void switch_to_sched(struct evl_coro *coro)
+{
+	__evl_coro_switch(&coro->sp, coro->sched->sp);
+}
+
+static void coro_entry(void *arg)
+{
+	struct evl_coro *coro = arg;
+
+	coro->fn(coro->arg);
+	coro->state = CORO_DONE;
+	switch_to_sched(coro);
+	/* The scheduler never switches back to a dead coroutine. */
+}
+
+/*
+ * Stacks grow down, an inaccessible page below each of them turns an
+ * overflow into a fault instead of silent memory corruption. The
+ * pages are populated upfront, so that running the coroutine does
+ * not fault them in.
+ */
+static void *alloc_stack(size_t *pstacksz)
+{
+	size_t pagesz = sysconf(_SC_PAGESIZE), mapsz;
+	void *stack;
+
+	mapsz = ((*pstacksz + pagesz - 1) & ~(pagesz - 1)) + pagesz;
+	stack = mmap(NULL, mapsz, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK|MAP_POPULATE, -1, 0);
+	if (stack == MAP_FAILED)
+		return NULL;
+
+	if (mprotect(stack, pagesz, PROT_NONE)) {
+		munmap(stack, mapsz);
+		return NULL;
+	}
+
+	*pstacksz = mapsz;
+
+	return stack;
+}
+
+static void free_stack(struct evl_coro *coro)
+{
+	munmap(coro->stack, coro->stack_size);
+	coro->stack = NULL;
+}
+
+/*
+ * Coroutines may be spawned before the scheduler runs, or by other
+ * coroutines. The stack is released when @fn returns.
+ */
+int evl_spawn_coro(struct evl_coro_sched *sched,
+		struct evl_coro *coro,
+		evl_coro_fn_t fn, void *arg,
+		size_t stacksz)
+{
+	if (stacksz == 0)
+		stacksz = EVL_CORO_STACK_SIZE;
+
+	coro->stack = alloc_stack(&stacksz);
+	if (coro->stack == NULL)
+		return -errno;
+
+	coro->stack_size = stacksz;
+
+	coro->fn = fn;
+	coro->arg = arg;
+	coro->sched = sched;
+	coro->state = CORO_READY;
+	coro->wait_fd = -1;
+	coro->revents = 0;
+	coro->sp = evl_coro_init_stack((char *)coro->stack + stacksz,
+				coro_entry, coro);
+	list_append(&coro->next, &sched->runq);
+	sched->nr_coros++;
+
+	return 0;
+}
+
+static void wake_coro(struct evl_coro_sched *sched,
+		struct evl_coro *coro, unsigned int revents)
+{
+	/* The descriptor may have been closed meanwhile. */
+	evl_del_pollfd(sched->pollfd, coro->wait_fd);
+	coro->wait_fd = -1;
+	coro->revents = revents;
+	coro->state = CORO_READY;
+	list_append(&coro->next, &sched->runq);
+}
+
+/*
+ * Run coroutines until all of them have returned. The calling
+ * thread waits for the descriptors parked coroutines depend on when
+ * none is ready to run.
+ */
+int evl_run_coro_sched(struct evl_coro_sched *sched)
+{
+	struct evl_coro *coro;
+	int nr, n, ret = 0;
+
+	if (current_sched)
+		return -EBUSY;
+
+	current_sched = sched;
+
+	while (sched->nr_coros > 0) {
+		while (!list_empty(&sched->runq)) {
+			coro = list_pop_entry(&sched->runq,
+					struct evl_coro, next);
+			sched->current = coro;
+			__evl_coro_switch(&sched->sp, coro->sp);
+			sched->current = NULL;
+			if (coro->state == CORO_DONE) {
+				free_stack(coro);
+				sched->nr_coros--;
+			}
+		}
+
+		if (sched->nr_coros == 0)
+			break;
+
+		nr = evl_poll(sched->pollfd, sched->events, sched->batch);
+		if (nr < 0) {
+			if (nr == -EINTR)
+				continue;
+			ret = nr;
+			break;
+		}
+
+		for (n = 0; n < nr; n++)
+			wake_coro(sched, sched->events[n].pollval.ptr,
+				sched->events[n].events);
+	}
+
+	current_sched = NULL;
+
+	return ret;
+}
+
+int evl_close_coro_sched(struct evl_coro_sched *sched)
+{
+	if (sched->nr_coros > 0)
+		return -EBUSY;
+
+	close(sched->pollfd);
+	free(sched->events);
+
+	return 0;
+}
+
+struct evl_coro *evl_current_coro(void)
+{
+	return current_sched ? current_sched->current : NULL;
+}
+
+void evl_yield_coro(void)
+{
+	struct evl_coro *coro = evl_current_coro();
+
+	if (coro) {
+		list_append(&coro->next, &coro->sched->runq);
+		switch_to_sched(coro);
+	}
+}
+
+/*
+ * Park the current coroutine until @fd reports any of @events,
+ * returning the events received. A descriptor may be waited for by
+ * a single coroutine at a time.
+ */
+int evl_coro_poll(int fd, unsigned int events)
+{
+	struct evl_coro *coro = evl_current_coro();
+	int ret;
+
+	if (coro == NULL)
+		return -EPERM;
+
+	ret = evl_add_pollfd(coro->sched->pollfd, fd, events,
+			evl_ptrval(coro));
+	if (ret)
+		return ret;
+
+	coro->wait_fd = fd;
+	coro->state = CORO_WAITING;
+	switch_to_sched(coro);
+
+	return coro->revents;
+}
+
+/*
+ * The I/O wrappers follow the oob_read() and oob_write() conventions.
+ * @fd should be in non-blocking mode, otherwise the whole scheduler
+ * may block on a partial transfer.
+ */
+ssize_t evl_coro_read(int fd, void *buf, size_t count)
+{
+	ssize_t ret;
+	int evret;
+
+	for (;;) {
+		ret = oob_read(fd, buf, count);
+		if (ret >= 0 || errno != EAGAIN)
+			return ret;
+		evret = evl_coro_poll(fd, POLLIN);
+		if (evret < 0) {
+			errno = -evret;
+			return -1;
+		}
+	}
+}
+
+ssize_t evl_coro_write(int fd, const void *buf, size_t count)
+{
+	ssize_t ret;
+	int evret;
+
+	for (;;) {
+		ret = oob_write(fd, buf, count);
+		if (ret >= 0 || errno != EAGAIN)
+			return ret;
+		evret = evl_coro_poll(fd, POLLOUT);
+		if (evret < 0) {
+			errno = -evret;
+			return -1;
+		}
+	}
+}
+
+int evl_coro_get_sem(struct evl_sem *sem)
+{
+	int ret;
+
+	for (;;) {
+		ret = evl_tryget_sem(sem);
+		if (ret != -EAGAIN)
+			return ret;
+		ret = evl_coro_poll(__evl_sem_fd(sem), POLLIN);
+		if (ret < 0)
+			return ret;
+	}
+}
@@ -79,6 +79,29 @@ static int init_event_static(struct evl_event *evt,
 	return efd;
 }
 
+/* Built aside, init_static_element() publishes the result. */
+static int create_static_event(void *element)
+{
+	struct evl_event *evt = element, tmp;
+	int efd;
+
+	efd = init_event_static(&tmp, evt->u.uninit.clockfd,
+				evt->u.uninit.flags,
+				evt->u.uninit.name);
+	if (efd < 0)
+		return efd;
+
+	evt->u = tmp.u;
+
+	return 0;
+}
+
+int init_static_event(void *element)
+{
+	return init_static_element(element, __EVENT_UNINIT_MAGIC,
+				__EVENT_ACTIVE_MAGIC, create_static_event);
+}
+
 static int open_event_vargs(struct evl_event *evt,
 			const char *fmt, va_list ap)
 {
@@ -127,6 +150,49 @@ int evl_create_event(struct evl_event *evt,
 	return efd;
 }
 
+struct event_vec_args {
+	int clockfd;
+	int flags;
+};
+
+static int create_event_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct event_vec_args *args = arg;
+
+	return evl_create_event(element, args->clockfd, args->flags,
+			name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_event_member(void *element)
+{
+	return evl_close_event(element);
+}
+
+/*
+ * Create @nr events at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_event_vec(struct evl_event *evts, int nr,
+		int clockfd, int flags,
+		const char *fmt, ...)
+{
+	struct event_vec_args args = {
+		.clockfd = clockfd,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(evts, sizeof(*evts), nr,
+			create_event_member, close_event_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
 int evl_open_event(struct evl_event *evt, const char *fmt, ...)
 {
 	va_list ap;
@@ -163,16 +229,8 @@ int evl_close_event(struct evl_event *evt)
 
 static int check_event_sanity(struct evl_event *evt)
 {
-	int efd;
-
-	if (evt->magic == __EVENT_UNINIT_MAGIC) {
-		efd = init_event_static(evt, evt->u.uninit.clockfd,
-					evt->u.uninit.flags,
-					evt->u.uninit.name);
-		if (efd < 0)
-			return efd;
-	} else if (evt->magic != __EVENT_ACTIVE_MAGIC)
-		return -EINVAL;
+	if (evt->magic != __EVENT_ACTIVE_MAGIC)
+		return init_static_event(evt);
 
 	return 0;
 }
@@ -0,0 +1,664 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/thread.h>
+#include <evl/flags.h>
+#include <evl/executor.h>
+
+#define OOB_CPU_LIST	"/sys/devices/virtual/evl/control/cpus"
+
+#define DEQUE_MASK	(EVL_EXECUTOR_DEQUE_SIZE - 1)
+
+#define STEAL_EMPTY	((struct evl_task *)0)
+#define STEAL_ABORT	((struct evl_task *)1)
+
+/*
+ * Chase-Lev work-stealing deque (as revised by Lê et al. for weak
+ * memory models): the owner pushes and takes tasks at the bottom
+ * end, thieves steal from the top end. Only a thief racing with
+ * another thief or with the owner for the last task may have to
+ * retry.
+ */
+struct evl_executor_deque {
+	long top __attribute__((aligned(64)));
+	long bottom __attribute__((aligned(64)));
+	struct evl_task *slots[EVL_EXECUTOR_DEQUE_SIZE];
+};
+
+struct executor_start;
+
+struct evl_executor_worker {
+	struct evl_executor_deque deque;
+	struct evl_pool_executor *exec;
+	struct executor_start *start;
+	struct evl_flags wakeup;
+	pthread_t thread;
+	int parked;
+	int index;
+	int cpu;
+	int status;
+	unsigned int seed;
+};
+
+/* Startup handshake with the workers. */
+struct executor_start {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int nr_started;
+	const char *name;
+};
+
+static __thread struct evl_executor_worker *current_worker;
+
+static bool push_task(struct evl_executor_deque *dq, struct evl_task *task)
+{
+	long b, t;
+
+	b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+	t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+	if (b - t > DEQUE_MASK)
+		return false;
+
+	__atomic_store_n(&dq->slots[b & DEQUE_MASK], task, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+static struct evl_task *take_task(struct evl_executor_deque *dq)
+{
+	struct evl_task *task = NULL;
+	long b, t;
+
+	b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+	if (t <= b) {
+		task = __atomic_load_n(&dq->slots[b & DEQUE_MASK],
+				__ATOMIC_RELAXED);
+		if (t != b)
+			return task;
+		/* Last task, race with thieves. */
+		if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			task = NULL;
+	}
+
+	__atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+
+	return task;
+}
+
+static struct evl_task *steal_task(struct evl_executor_deque *dq)
+{
+	struct evl_task *task;
+	long b, t;
+
+	t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+		return STEAL_EMPTY;
+
+	task = __atomic_load_n(&dq->slots[t & DEQUE_MASK], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return STEAL_ABORT;
+
+	return task;
+}
+
+static inline bool deque_empty(struct evl_executor_deque *dq)
+{
+	return __atomic_load_n(&dq->top, __ATOMIC_SEQ_CST) >=
+		__atomic_load_n(&dq->bottom, __ATOMIC_SEQ_CST);
+}
+
+static void wake_workers(struct evl_pool_executor *exec, int nr)
+{
+	struct evl_executor_worker *w;
+	int n;
+
+	/* Order the publication of the work with the check. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&exec->nr_parked, __ATOMIC_SEQ_CST) == 0)
+		return;
+
+	for (n = 0; n < exec->nr_workers && nr > 0; n++) {
+		w = exec->workers + n;
+		if (__sync_bool_compare_and_swap(&w->parked, 1, 0)) {
+			evl_post_flags(&w->wakeup, 1);
+			nr--;
+		}
+	}
+}
+
+static void complete_task(struct evl_task *task)
+{
+	struct evl_task_group *group = task->group;
+
+	/*
+	 * @task may be released by its owner from now on, and so may
+	 * @group once the last completer has posted.
+	 */
+	if (group && __sync_sub_and_fetch(&group->pending, 1) == 0)
+		evl_put_sem(&group->done);
+}
+
+static void run_task(struct evl_task *task)
+{
+	task->fn(task);
+	complete_task(task);
+}
+
+/*
+ * Move the tasks submitted by non-workers to our own deque, in
+ * submission order. We run those which do not fit right away.
+ */
+static struct evl_task *grab_injected(struct evl_executor_worker *w)
+{
+	struct evl_pool_executor *exec = w->exec;
+	struct evl_task *task, *next, *fifo = NULL;
+
+	if (atomic_load(&exec->injected) == NULL)
+		return NULL;
+
+	task = __sync_lock_test_and_set(&exec->injected, NULL);
+
+	while (task) {
+		next = task->next;
+		task->next = fifo;
+		fifo = task;
+		task = next;
+	}
+
+	if (fifo == NULL)
+		return NULL;
+
+	task = fifo;
+	for (fifo = fifo->next; fifo; fifo = next) {
+		next = fifo->next;
+		if (!push_task(&w->deque, fifo))
+			run_task(fifo);
+	}
+
+	if (!deque_empty(&w->deque))
+		wake_workers(exec, 1);
+
+	return task;
+}
+
+static struct evl_task *steal_work(struct evl_executor_worker *w)
+{
+	struct evl_pool_executor *exec = w->exec;
+	struct evl_task *task;
+	bool retry;
+	int n, victim;
+
+	do {
+		retry = false;
+		w->seed = w->seed * 1103515245 + 12345;
+		victim = (w->seed >> 16) % exec->nr_workers;
+		for (n = 0; n < exec->nr_workers; n++) {
+			if (victim != w->index) {
+				task = steal_task(&exec->workers[victim].deque);
+				if (task == STEAL_ABORT)
+					retry = true;
+				else if (task)
+					return task;
+			}
+			if (++victim == exec->nr_workers)
+				victim = 0;
+		}
+	} while (retry);
+
+	return NULL;
+}
+
+static bool has_work(struct evl_pool_executor *exec)
+{
+	int n;
+
+	if (atomic_load(&exec->injected))
+		return true;
+
+	for (n = 0; n < exec->nr_workers; n++)
+		if (!deque_empty(&exec->workers[n].deque))
+			return true;
+
+	return false;
+}
+
+/*
+ * Announce that we are about to park before checking for work a
+ * last time, submitters do the converse, so that no wake-up is
+ * missed.
+ */
+static void park_worker(struct evl_executor_worker *w)
+{
+	struct evl_pool_executor *exec = w->exec;
+	int bits;
+
+	__atomic_store_n(&w->parked, 1, __ATOMIC_SEQ_CST);
+	__sync_add_and_fetch(&exec->nr_parked, 1);
+
+	if (!has_work(exec) && !atomic_load(&exec->stop))
+		evl_wait_flags(&w->wakeup, &bits);
+
+	__sync_sub_and_fetch(&exec->nr_parked, 1);
+	__atomic_store_n(&w->parked, 0, __ATOMIC_SEQ_CST);
+}
+
+static void run_worker(struct evl_executor_worker *w)
+{
+	struct evl_pool_executor *exec = w->exec;
+	struct evl_task *task;
+
+	for (;;) {
+		task = take_task(&w->deque);
+		if (task == NULL)
+			task = grab_injected(w);
+		if (task == NULL)
+			task = steal_work(w);
+		if (task) {
+			run_task(task);
+			continue;
+		}
+		/* Pending work is drained before leaving. */
+		if (atomic_load(&exec->stop))
+			break;
+		park_worker(w);
+	}
+}
+
+static void *worker_main(void *arg)
+{
+	struct evl_executor_worker *w = arg;
+	struct executor_start *start = w->start;
+	int ret;
+
+	ret = evl_attach_self("%s.%d", start->name, w->index);
+	if (ret >= 0)
+		ret = evl_new_flags(&w->wakeup, "%s.%d.wakeup",
+				start->name, w->index);
+
+	current_worker = w;
+
+	pthread_mutex_lock(&start->lock);
+	w->status = ret < 0 ? ret : 0;
+	start->nr_started++;
+	pthread_cond_signal(&start->cond);
+	pthread_mutex_unlock(&start->lock);
+
+	if (ret < 0)
+		return NULL;
+
+	run_worker(w);
+
+	evl_close_flags(&w->wakeup);
+	evl_detach_self();
+
+	return NULL;
+}
+
+static void parse_cpu_list(const char *path, cpu_set_t *cpuset)
+{
+	char *p, *range, *range_p = NULL, *id, *id_r;
+	int start, end, cpu;
+	char buf[BUFSIZ];
+	FILE *fp;
+
+	CPU_ZERO(cpuset);
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+
+	if (!fgets(buf, sizeof(buf), fp))
+		goto out;
+
+	p = buf;
+	while ((range = strtok_r(p, ",", &range_p)) != NULL) {
+		if (*range == '\0' || *range == '\n')
+			goto next;
+		end = -1;
+		id = strtok_r(range, "-", &id_r);
+		if (id) {
+			start = atoi(id);
+			id = strtok_r(NULL, "-", &id_r);
+			if (id)
+				end = atoi(id);
+			else if (end < 0)
+				end = start;
+			for (cpu = start; cpu <= end && cpu < CPU_SETSIZE; cpu++)
+				CPU_SET(cpu, cpuset);
+		}
+	next:
+		p = NULL;
+	}
+out:
+	fclose(fp);
+}
+
+/*
+ * Workers go to the out-of-band capable CPUs we may run on, or to
+ * any CPU we may run on if the core does not tell (e.g. libeshi).
+ */
+static int get_worker_cpus(int *cpus)
+{
+	cpu_set_t oob_cpus, allowed;
+	int cpu, nr = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		return -errno;
+
+	parse_cpu_list(OOB_CPU_LIST, &oob_cpus);
+	if (CPU_COUNT(&oob_cpus) > 0)
+		CPU_AND(&oob_cpus, &oob_cpus, &allowed);
+	else
+		oob_cpus = allowed;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &oob_cpus))
+			cpus[nr++] = cpu;
+
+	return nr ?: -ENODEV;
+}
+
+static int start_worker(struct evl_executor_worker *w, int prio)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	cpu_set_t affinity;
+	int ret;
+
+	CPU_ZERO(&affinity);
+	CPU_SET(w->cpu, &affinity);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	param.sched_priority = prio;
+	pthread_attr_setschedpolicy(&attr, prio ? SCHED_FIFO : SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+	pthread_attr_setaffinity_np(&attr, sizeof(affinity), &affinity);
+	ret = pthread_create(&w->thread, &attr, worker_main, w);
+	pthread_attr_destroy(&attr);
+
+	return -ret;
+}
+
+static void stop_workers(struct evl_pool_executor *exec, int nr)
+{
+	struct evl_executor_worker *w;
+	int n;
+
+	atomic_store(&exec->stop, 1);
+	smp_mb();
+
+	for (n = 0; n < nr; n++) {
+		w = exec->workers + n;
+		if (w->status == 0)
+			evl_post_flags(&w->wakeup, 1);
+	}
+
+	for (n = 0; n < nr; n++)
+		pthread_join(exec->workers[n].thread, NULL);
+}
+
+/*
+ * Start @nr_workers threads, or one per out-of-band capable CPU if
+ * zero, scheduled in SCHED_FIFO at @prio, or SCHED_OTHER if
+ * zero. Workers are named after @name, and spread over the CPUs
+ * round-robin. Returns once all of them are attached to the core.
+ */
+int evl_init_pool_executor(struct evl_pool_executor *exec,
+			int nr_workers, int prio,
+			const char *name)
+{
+	struct executor_start start;
+	struct evl_executor_worker *w;
+	int ret, n, nr_cpus, *cpus;
+
+	if (nr_workers < 0 || name == NULL)
+		return -EINVAL;
+
+	cpus = malloc(CPU_SETSIZE * sizeof(int));
+	if (cpus == NULL)
+		return -ENOMEM;
+
+	nr_cpus = get_worker_cpus(cpus);
+	if (nr_cpus < 0) {
+		ret = nr_cpus;
+		goto out;
+	}
+
+	if (nr_workers == 0)
+		nr_workers = nr_cpus;
+
+	ret = posix_memalign((void **)&exec->workers, 64,
+			nr_workers * sizeof(*exec->workers));
+	if (ret) {
+		ret = -ret;
+		goto out;
+	}
+
+	memset(exec->workers, 0, nr_workers * sizeof(*exec->workers));
+	exec->nr_workers = nr_workers;
+	exec->nr_parked = 0;
+	exec->stop = 0;
+	exec->injected = NULL;
+
+	pthread_mutex_init(&start.lock, NULL);
+	pthread_cond_init(&start.cond, NULL);
+	start.nr_started = 0;
+	start.name = name;
+
+	for (n = 0; n < nr_workers; n++) {
+		w = exec->workers + n;
+		w->exec = exec;
+		w->start = &start;
+		w->index = n;
+		w->cpu = cpus[n % nr_cpus];
+		w->seed = n + 1;
+		ret = start_worker(w, prio);
+		if (ret)
+			break;
+	}
+
+	pthread_mutex_lock(&start.lock);
+	while (start.nr_started < n)
+		pthread_cond_wait(&start.cond, &start.lock);
+	pthread_mutex_unlock(&start.lock);
+
+	if (ret == 0) {
+		for (n = 0; n < nr_workers; n++) {
+			ret = exec->workers[n].status;
+			if (ret)
+				break;
+		}
+		n = nr_workers;
+	}
+
+	if (ret) {
+		stop_workers(exec, n);
+		free(exec->workers);
+	}
+
+	pthread_cond_destroy(&start.cond);
+	pthread_mutex_destroy(&start.lock);
+out:
+	free(cpus);
+
+	return ret;
+}
+
+/* A group becoming busy owes its waiter a post. */
+static inline void add_pending(struct evl_task_group *group, int nr)
+{
+	if (group && __sync_fetch_and_add(&group->pending, nr) == 0)
+		__sync_add_and_fetch(&group->busy, 1);
+}
+
+/*
+ * A worker queues to its own deque, other threads to the injection
+ * list any worker picks from.
+ */
+static void queue_tasks(struct evl_pool_executor *exec,
+			struct evl_task *first, struct evl_task *last,
+			int nr)
+{
+	struct evl_executor_worker *w = current_worker;
+	struct evl_task *task, *next, *head;
+
+	if (w && w->exec == exec) {
+		for (task = first; nr > 0; task = next, nr--) {
+			next = task->next;
+			if (!push_task(&w->deque, task))
+				break;
+		}
+		if (nr == 0) {
+			wake_workers(exec, 1);
+			return;
+		}
+		first = task;
+	}
+
+	do {
+		head = atomic_load(&exec->injected);
+		last->next = head;
+	} while (!__sync_bool_compare_and_swap(&exec->injected, head, first));
+
+	wake_workers(exec, 1);
+}
+
+/*
+ * @task must stay valid until it has run. If @group is non-NULL, the
+ * task is accounted for in this completion group.
+ */
+int evl_submit_task(struct evl_pool_executor *exec,
+		struct evl_task *task,
+		evl_task_fn_t fn, void *arg,
+		struct evl_task_group *group)
+{
+	if (atomic_load(&exec->stop))
+		return -EPERM;
+
+	task->fn = fn;
+	task->arg = arg;
+	task->group = group;
+	task->next = NULL;
+	add_pending(group, 1);
+	queue_tasks(exec, task, task, 1);
+
+	return 0;
+}
+
+/*
+ * Submit @nr tasks which fn and arg fields were set by the caller,
+ * with a single atomic operation from a non-worker thread.
+ */
+int evl_submit_tasks(struct evl_pool_executor *exec,
+		struct evl_task *tasks, int nr,
+		struct evl_task_group *group)
+{
+	int n;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	if (atomic_load(&exec->stop))
+		return -EPERM;
+
+	if (nr == 0)
+		return 0;
+
+	/*
+	 * Chain the tasks in reverse order, the injection list is
+	 * LIFO.
+	 */
+	for (n = 0; n < nr; n++) {
+		tasks[n].group = group;
+		tasks[n].next = n > 0 ? tasks + n - 1 : NULL;
+	}
+
+	add_pending(group, nr);
+
+	if (current_worker && current_worker->exec == exec) {
+		for (n = 0; n < nr; n++) {
+			tasks[n].next = NULL;
+			queue_tasks(exec, tasks + n, tasks + n, 1);
+		}
+		return 0;
+	}
+
+	queue_tasks(exec, tasks + nr - 1, tasks, nr);
+	wake_workers(exec, nr - 1);
+
+	return 0;
+}
+
+/* Pending tasks are run before the workers exit. */
+int evl_close_pool_executor(struct evl_pool_executor *exec)
+{
+	if (current_worker && current_worker->exec == exec)
+		return -EDEADLK;
+
+	stop_workers(exec, exec->nr_workers);
+	free(exec->workers);
+
+	return 0;
+}
+
+int evl_init_task_group(struct evl_task_group *group)
+{
+	int ret;
+
+	group->pending = 0;
+	group->busy = 0;
+	ret = evl_new_sem(&group->done, NULL);
+
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Wait for all tasks submitted to @group to complete. This may not
+ * be called from a task, nor by concurrent waiters. We collect the
+ * post which ends every busy period, since seeing no pending task
+ * does not mean that the last completer is done with @group, which
+ * the caller may release on return.
+ */
+int evl_wait_task_group(struct evl_task_group *group)
+{
+	int ret;
+
+	while (atomic_load(&group->busy) > 0) {
+		ret = evl_get_sem(&group->done);
+		if (ret)
+			return ret;
+		__sync_sub_and_fetch(&group->busy, 1);
+	}
+
+	smp_mb();
+
+	return 0;
+}
+
+int evl_close_task_group(struct evl_task_group *group)
+{
+	return evl_close_sem(&group->done);
+}
@@ -18,6 +18,7 @@
 #include <evl/atomic.h>
 #include <evl/evl.h>
 #include <evl/flags.h>
+#include <evl/clock.h>
 #include <evl/thread.h>
 #include <evl/syscall.h>
 #include <linux/types.h>
@@ -67,6 +68,51 @@ int evl_create_flags(struct evl_flags *flg, int clockfd,
 	return efd;
 }
 
+struct flags_vec_args {
+	int clockfd;
+	int initval;
+	int flags;
+};
+
+static int create_flags_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct flags_vec_args *args = arg;
+
+	return evl_create_flags(element, args->clockfd, args->initval,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_flags_member(void *element)
+{
+	return evl_close_flags(element);
+}
+
+/*
+ * Create @nr flag groups at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_flags_vec(struct evl_flags *flgs, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...)
+{
+	struct flags_vec_args args = {
+		.clockfd = clockfd,
+		.initval = initval,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(flgs, sizeof(*flgs), nr,
+			create_flags_member, close_flags_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
 int evl_open_flags(struct evl_flags *flg, const char *fmt, ...)
 {
 	struct evl_monitor_binding bind;
@@ -125,20 +171,37 @@ int evl_close_flags(struct evl_flags *flg)
 	return 0;
 }
 
-static int check_sanity(struct evl_flags *flg)
+/* Built aside, init_static_element() publishes the result. */
+static int create_static_flags(void *element)
 {
+	struct evl_flags *flg = element, tmp;
 	int efd;
 
-	if (flg->magic == __FLAGS_UNINIT_MAGIC) {
-		efd = evl_create_flags(flg,
-				flg->u.uninit.clockfd,
-				flg->u.uninit.initval,
-				flg->u.uninit.flags,
-				flg->u.uninit.name);
-		return efd < 0 ? efd : 0;
-	}
+	efd = evl_create_flags(&tmp,
+			flg->u.uninit.clockfd,
+			flg->u.uninit.initval,
+			flg->u.uninit.flags,
+			flg->u.uninit.name);
+	if (efd < 0)
+		return efd;
 
-	return flg->magic != __FLAGS_ACTIVE_MAGIC ? -EINVAL : 0;
+	flg->u = tmp.u;
+
+	return 0;
+}
+
+int init_static_flags(void *element)
+{
+	return init_static_element(element, __FLAGS_UNINIT_MAGIC,
+				__FLAGS_ACTIVE_MAGIC, create_static_flags);
+}
+
+static int check_sanity(struct evl_flags *flg)
+{
+	if (flg->magic != __FLAGS_ACTIVE_MAGIC)
+		return init_static_flags(flg);
+
+	return 0;
 }
 
 static int try_wait(struct evl_monitor_state *state)
@@ -231,6 +294,55 @@ int evl_trywait_flags(struct evl_flags *flg, int *r_bits)
 	return 0;
 }
 
+/*
+ * Consume the bits of @mask which are set, provided the condition
+ * stated by @mode is met. Other bits are left untouched.
+ */
+static int try_wait_mask(struct evl_monitor_state *state,
+			int mask, int mode)
+{
+	int val, prev, match;
+
+	val = atomic_read(&state->u.event.value);
+
+	do {
+		match = val & mask;
+		if (!match || (mode == EVL_FLAGS_ALL && match != mask))
+			return 0;
+		prev = val;
+		val = atomic_cmpxchg(&state->u.event.value, prev, prev & ~match);
+	} while (val != prev);
+
+	return match;
+}
+
+/*
+ * The core gives all pending bits to a waiter at once, and does not
+ * block as long as any bit is pending, so there is no way to sleep
+ * until some particular bits are posted: only the non-blocking form
+ * is available.
+ */
+int evl_trywait_flags_mask(struct evl_flags *flg,
+			int mask, int mode, int *r_bits)
+{
+	int ret;
+
+	ret = check_sanity(flg);
+	if (ret)
+		return ret;
+
+	if (!mask || (mode != EVL_FLAGS_ANY && mode != EVL_FLAGS_ALL))
+		return -EINVAL;
+
+	ret = try_wait_mask(flg->u.active.state, mask, mode);
+	if (!ret)
+		return -EAGAIN;
+
+	*r_bits = ret;
+
+	return 0;
+}
+
 int evl_post_flags(struct evl_flags *flg, int bits)
 {
 	struct evl_monitor_state *state;
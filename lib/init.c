@@ -47,6 +47,8 @@ int evl_ctlfd = -1;
 
 void *evl_shared_memory = NULL;
 
+int evl_nr_cpus = 1;
+
 static void atfork_unmap_shmem(void)
 {
 	if (evl_shared_memory) {
@@ -59,6 +61,8 @@ static void atfork_unmap_shmem(void)
 		evl_ctlfd = -1;
 	}
 
+	reset_evl_factories();
+	reset_lockstat();
 	init_once = PTHREAD_ONCE_INIT;
 }
 
@@ -72,7 +76,7 @@ static inline int generic_init(void)
 	 * sign that we have no EVL core in there. Return with -ENOSYS
 	 * to give a clear hint about this.
 	 */
-	ctlfd = open(RROS_CONTROL_DEV, O_RDWR);
+	ctlfd = open(RROS_CONTROL_DEV, O_RDWR|O_CLOEXEC);
 	DEBUG_PRINT("the value of ctlfd is %d\n", ctlfd);
 	if (ctlfd < 0) {
 		if (errno == ENOENT) {
@@ -82,18 +86,6 @@ static inline int generic_init(void)
 		return -errno;
 	}
 
-	ret = fcntl(ctlfd, F_GETFD, 0);
-	if (ret < 0) {
-		ret = -errno;
-		goto fail;
-	}
-
-	ret = fcntl(ctlfd, F_SETFD, ret | O_CLOEXEC);
-	if (ret < 0) {
-		ret = -errno;
-		goto fail;
-	}
-
 	ret = ioctl(ctlfd, EVL_CTLIOC_GET_COREINFO, &core_info);
 	// DEBUG_PRINT("the value of EVL_CTLIOC_GET_COREINFO is %ld\n", EVL_CTLIOC_GET_COREINFO);
 	// DEBUG_PRINT("the value of EVL_CTLIOC_SCHEDCTL is %ld\n", EVL_CTLIOC_SCHEDCTL);
@@ -207,6 +199,10 @@ static int do_init(void)
 
 	resolve_vdso_calls();
 
+	ret = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ret > 0)
+		evl_nr_cpus = ret;
+
 	ret = mlockall(MCL_CURRENT | MCL_FUTURE);
 	if (ret)
 		return -errno;
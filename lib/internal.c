@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <linux/types.h>
 #include <uapi/evl/factory.h>
@@ -29,31 +30,98 @@ static void lart_once(void)
 	pthread_once(&lart_once, do_lart_once);
 }
 
-static int flip_fd_flags(int efd, int cmd, int flags)
+/*
+ * Clone devices are opened once per element type and kept open for
+ * the lifetime of the process, since the factories are stateless
+ * from the user's standpoint. The few element types we know of fit
+ * in the cache, we fall back to a transient descriptor otherwise.
+ */
+#define EVL_FACTORY_CACHE_SIZE	16
+
+static struct evl_factory_cache {
+	const char *type;
+	int fd;
+} factory_cache[EVL_FACTORY_CACHE_SIZE];
+
+static pthread_mutex_t factory_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int get_factory_fd(const char *type, bool *r_cached)
 {
-	int ret;
+	struct evl_factory_cache *c, *slot = NULL;
+	char *fdevname;
+	int ffd, ret;
+
+	pthread_mutex_lock(&factory_lock);
+
+	for (c = factory_cache;
+	     c < factory_cache + EVL_FACTORY_CACHE_SIZE; c++) {
+		if (c->type == NULL) {
+			if (slot == NULL)
+				slot = c;
+			continue;
+		}
+		if (!strcmp(c->type, type)) {
+			ffd = c->fd;
+			*r_cached = true;
+			goto out;
+		}
+	}
 
-	DEBUG_PRINT("clone flags %d\n", 1);
-	ret = fcntl(efd, cmd == F_SETFD ? F_GETFD : F_GETFL, 0);
+	ret = asprintf(&fdevname, "/dev/rros/%s/clone", type);
+	if (ret < 0) {
+		ffd = -ENOMEM;
+		goto out;
+	}
 
-	DEBUG_PRINT("clone flags %d\n", 2);
-	if (ret < 0)
-		return -errno;
+	DEBUG_PRINT("fdevname: %s\n", fdevname);
+	ffd = open(fdevname, O_RDWR|O_CLOEXEC);
+	free(fdevname);
+	if (ffd < 0) {
+		ffd = -errno;
+		goto out;
+	}
 
-	DEBUG_PRINT("clone flags %d\n", 4);
-	ret = fcntl(efd, cmd, ret | flags);
+	*r_cached = slot != NULL;
+	if (slot) {
+		slot->type = type;
+		slot->fd = ffd;
+	}
+out:
+	pthread_mutex_unlock(&factory_lock);
 
-	DEBUG_PRINT("clone flags %d\n", 3);
-	if (ret)
-		return -errno;
+	return ffd;
+}
 
-	return 0;
+static void put_factory_fd(int ffd, bool cached)
+{
+	if (!cached)
+		close(ffd);
+}
+
+/*
+ * The child of a fork() has to initialize again, drop the cached
+ * descriptors.
+ */
+void reset_evl_factories(void)
+{
+	struct evl_factory_cache *c;
+
+	for (c = factory_cache;
+	     c < factory_cache + EVL_FACTORY_CACHE_SIZE; c++) {
+		if (c->type) {
+			close(c->fd);
+			c->type = NULL;
+		}
+	}
+
+	pthread_mutex_init(&factory_lock, NULL);
 }
 
 /*
  * Creating an EVL element is done in the following steps:
  *
- * 1. open the clone device of the proper element class.
+ * 1. get a descriptor on the clone device of the proper element
+ * class, opening it on first use.
  *
  * 2. issue ioctl(EVL_IOC_CLONE) to create a new element, passing
  * an attribute structure.
@@ -70,31 +138,16 @@ int create_evl_element(const char *type, const char *name,
 		void *attrs, int clone_flags,
 		struct evl_element_ids *eids)
 {
-	char *fdevname, *edevname = NULL;
 	struct evl_clone_req clone;
+	char *edevname;
 	int ffd, efd, ret;
-	bool nonblock;
+	bool nonblock, cached;
 
 	nonblock = !!(clone_flags & EVL_CLONE_NONBLOCK);
 	/* Strip off user-only bits. */
 	clone_flags &= EVL_CLONE_MASK;
 	clone_flags &= ~EVL_CLONE_NONBLOCK;
 
-	ret = asprintf(&fdevname, "/dev/rros/%s/clone", type);
-	if (ret < 0)
-		return -ENOMEM;
-
-	DEBUG_PRINT("fdevname: %s\n", fdevname);
-	ffd = open(fdevname, O_RDWR);
-	if (ffd < 0) {
-		DEBUG_PRINT("open fdevname failed, the ffd is %d\n", ffd);
-		ret = -errno;
-		goto out_factory;
-	}
-
-	DEBUG_PRINT("ffd = %d\n",ffd);
-	DEBUG_PRINT("fdevname: %s\n", fdevname);
-
 	/*
 	 * Turn on public mode if the user-provided name starts with a
 	 * slash.  Anonymous elements must be private by definition.
@@ -107,81 +160,62 @@ int create_evl_element(const char *type, const char *name,
 		name++;
 	}
 
-	DEBUG_PRINT("fdevname: %s\n", fdevname);
+	ffd = get_factory_fd(type, &cached);
+	if (ffd < 0) {
+		DEBUG_PRINT("cannot open %s factory, ret=%d\n", type, ffd);
+		return ffd;
+	}
+
 	clone.name_ptr = __evl_ptr64(name);
 	clone.attrs_ptr = __evl_ptr64(attrs);
 	clone.clone_flags = clone_flags;
 	ret = ioctl(ffd, EVL_IOC_CLONE, &clone);
 	if (ret) {
 		DEBUG_PRINT("ffd failed, ret=%d\n", ret);
-		fflush(stdout);
 		ret = -errno;
 		if (ret == -ENXIO)
 			lart_once();
-		goto out_new;
+		goto out;
 	}
-	DEBUG_PRINT("clone flags %d\n", clone_flags);
+
 	if (clone_flags & EVL_CLONE_PUBLIC) {
 		ret = asprintf(&edevname, "/dev/rros/%s/%s", type, name);
 		if (ret < 0) {
 			ret = -ENOMEM;
-			goto out_new;
+			goto out;
 		}
 		DEBUG_PRINT("edevname: %s\n", edevname);
-		efd = open(edevname, O_RDWR);
+		efd = open(edevname, O_RDWR|O_CLOEXEC|
+			(nonblock ? O_NONBLOCK : 0));
+		free(edevname);
 		if (efd < 0) {
-			DEBUG_PRINT("edevname: %s failed\n", edevname);
 			ret = -errno;
-			goto out_element;
+			goto out;
 		}
 	} else {
+		/*
+		 * The descriptor we got from the core is fresh, no
+		 * need to read its flags back before updating them.
+		 */
 		efd = clone.efd;
-	}
-	DEBUG_PRINT("efd is in the user space %d %d \n ", clone.efd, efd);
-	DEBUG_PRINT("clone flags %d\n", clone_flags);
-	ret = flip_fd_flags(efd, F_SETFD, O_CLOEXEC);
-
-	DEBUG_PRINT("clone flags %d\n", clone_flags);
-	DEBUG_PRINT("flip_fd_flags, ret=%d\n", ret);
-	fflush(stdout);
-	if (ret)
-		goto out_element;
-
-	DEBUG_PRINT("flip_fd_flags, ret=%d\n", ret);
-	if (nonblock) {
-		ret = flip_fd_flags(efd, F_SETFL, O_NONBLOCK);
-		DEBUG_PRINT("flip_fd_flags, ret=%d\n", ret);
-		if (ret)
-			goto out_element;
+		ret = fcntl(efd, F_SETFD, FD_CLOEXEC);
+		if (!ret && nonblock)
+			ret = fcntl(efd, F_SETFL, O_NONBLOCK);
+		if (ret) {
+			ret = -errno;
+			close(efd);
+			goto out;
+		}
 	}
 
-	DEBUG_PRINT("flip_fd_flags, ret=%d\n", ret);
-	DEBUG_PRINT("the filp of fdevname is %p, the fdevname is %s\n", fdevname, fdevname);
-	fflush(stdout);
+	DEBUG_PRINT("efd is in the user space %d %d\n", clone.efd, efd);
 
-	if (eids) {
-		DEBUG_PRINT("the filp of eids is %p\n", eids);
+	if (eids)
 		*eids = clone.eids;
-	}
 
 	ret = efd;
-
-out_element:
-	if (edevname)
-		free(edevname);
-out_new:
-	DEBUG_PRINT("before close ffd\n");
-	DEBUG_PRINT("ffd = %d\n",ffd);
-	fflush(stdout);
-	close(ffd);
-	DEBUG_PRINT("after close ffd\n");
-	fflush(stdout);
-out_factory:
-	DEBUG_PRINT("before free fdevname\n");
-	fflush(stdout);
-	free(fdevname);
-	DEBUG_PRINT("free fdevname success\n");
-	fflush(stdout);
+out:
+	put_factory_fd(ffd, cached);
 
 	return ret;
 }
@@ -201,34 +235,13 @@ int open_evl_element_vargs(const char *type,
 	if (ret < 0)
 		return -ENOMEM;
 
-	efd = open(path, O_RDWR);
-	if (efd < 0) {
-		ret = -errno;
-		goto fail_open;
-	}
-
-	ret = fcntl(efd, F_GETFD, 0);
-	if (ret < 0) {
-		ret = -errno;
-		goto fail;
-	}
-
-	ret = fcntl(efd, F_SETFD, ret | O_CLOEXEC);
-	if (ret) {
-		ret = -errno;
-		goto fail;
-	}
+	efd = open(path, O_RDWR|O_CLOEXEC);
+	if (efd < 0)
+		efd = -errno;
 
 	free(path);
 
 	return efd;
-
-fail:
-	close(efd);
-fail_open:
-	free(path);
-
-	return ret;
 }
 
 int open_evl_element(const char *type, const char *fmt, ...)
@@ -252,24 +265,11 @@ int create_evl_file(const char *type)
 	if (ret < 0)
 		return -ENOMEM;
 
-	efd = open(devname, O_RDWR);
-	if (efd < 0) {
-		ret = -errno;
-		goto fail;
-	}
-
-	ret = flip_fd_flags(efd, F_SETFD, O_CLOEXEC);
-	if (ret)
-		goto fail_setfd;
+	efd = open(devname, O_RDWR|O_CLOEXEC);
+	if (efd < 0)
+		efd = -errno;
 
 	free(devname);
 
 	return efd;
-
-fail_setfd:
-	close(efd);
-fail:
-	free(devname);
-
-	return ret;
 }
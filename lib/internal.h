@@ -135,6 +135,39 @@ int open_evl_element(const char *type,
 
 int create_evl_file(const char *type);
 
+void reset_evl_factories(void);
+
+struct evl_lockstat;
+
+int register_lockstat(const char *name, int efd);
+
+void unregister_lockstat(int stat_id);
+
+struct evl_lockstat *get_lockstat(int stat_id);
+
+void reset_lockstat(void);
+
+int create_element_vec(void *elements, size_t size, int nr,
+		int (*create)(void *element, const char *name,
+			int index, void *arg),
+		int (*close)(void *element),
+		void *arg, const char *fmt, va_list ap);
+
+int init_static_element(void *element,
+			unsigned int uninit_magic,
+			unsigned int active_magic,
+			int (*init)(void *element));
+
+int init_static_mutex(void *element);
+
+int init_static_event(void *element);
+
+int init_static_sem(void *element);
+
+int init_static_flags(void *element);
+
+int init_static_rwlock(void *element);
+
 extern int (*__evl_clock_gettime)(clockid_t clk_id,
 				struct timespec *tp);
 
@@ -142,6 +175,8 @@ extern void *evl_shared_memory;
 
 extern int evl_ctlfd;
 
+extern int evl_nr_cpus;
+
 extern int evl_mono_clockfd;
 
 extern int evl_real_clockfd;
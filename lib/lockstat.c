@@ -0,0 +1,304 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <evl/atomic.h>
+#include <evl/mutex.h>
+#include <evl/lockstat.h>
+#include "internal.h"
+
+/* Marks a thread which could not get a row. */
+#define NO_ROW  ((struct evl_lockstat *)-1L)
+
+static struct evl_lockstat_file *lockstat_file;
+
+static pthread_mutex_t lockstat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t lockstat_key;
+
+static bool lockstat_key_valid;
+
+static char lockstat_shm[32];
+
+static pid_t lockstat_pid;
+
+static bool lockstat_warned;
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+struct evl_lockstat *lockstat_row;
+
+static __thread __attribute__ ((tls_model (EVL_TLS_MODEL)))
+int lockstat_idx;
+
+static void unlink_lockstat(void)
+{
+	/* Children inherit this handler, but not the file. */
+	if (lockstat_pid == getpid())
+		shm_unlink(lockstat_shm);
+}
+
+/* Fold the counts of an exiting thread into row #0, release its row. */
+static void retire_lockstat_row(void *arg)
+{
+	struct evl_lockstat *row = arg, *retired;
+	int slot, idx, n;
+	__u32 gen;
+
+	pthread_mutex_lock(&lockstat_lock);
+
+	if (lockstat_file == NULL || row == NO_ROW)
+		goto out;
+
+	retired = lockstat_file->rows[0];
+	idx = (row - retired) / EVL_LOCKSTAT_MAX_MUTEXES;
+
+	for (slot = 0; slot < EVL_LOCKSTAT_MAX_MUTEXES; slot++) {
+		gen = lockstat_file->gen[slot];
+		if (lockstat_file->row_gen[idx][slot] != gen)
+			continue;
+		/* Row #0 is only written to under lockstat_lock. */
+		if (lockstat_file->row_gen[0][slot] != gen) {
+			memset(&retired[slot], 0, sizeof(*retired));
+			lockstat_file->row_gen[0][slot] = gen;
+		}
+		retired[slot].fast += row[slot].fast;
+		retired[slot].slow += row[slot].slow;
+		retired[slot].trylock_failed += row[slot].trylock_failed;
+		retired[slot].recursive += row[slot].recursive;
+		retired[slot].pp_slow += row[slot].pp_slow;
+		for (n = 0; n < EVL_LOCKSTAT_HIST_SIZE; n++) {
+			retired[slot].wait_hist[n] += row[slot].wait_hist[n];
+			retired[slot].hold_hist[n] += row[slot].hold_hist[n];
+		}
+	}
+
+	/* Our counts are no longer valid, then no longer ours. */
+	memset(lockstat_file->row_gen[idx], 0,
+		sizeof(lockstat_file->row_gen[idx]));
+	smp_mb();
+	memset(row, 0, sizeof(*row) * EVL_LOCKSTAT_MAX_MUTEXES);
+	smp_mb();
+	atomic_store(&lockstat_file->busy[idx], 0);
+out:
+	pthread_mutex_unlock(&lockstat_lock);
+}
+
+static int map_lockstat_file(void)
+{
+	struct evl_lockstat_file *file;
+	int fd, ret, slot;
+
+	if (!lockstat_key_valid) {
+		ret = pthread_key_create(&lockstat_key, retire_lockstat_row);
+		if (ret)
+			return -ret;
+		lockstat_key_valid = true;
+		atexit(unlink_lockstat);
+	}
+
+	lockstat_pid = getpid();
+	snprintf(lockstat_shm, sizeof(lockstat_shm),
+		EVL_LOCKSTAT_SHM_FMT, lockstat_pid);
+
+	fd = shm_open(lockstat_shm, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	ret = ftruncate(fd, sizeof(*file));
+	if (ret) {
+		ret = -errno;
+		goto fail;
+	}
+
+	file = mmap(NULL, sizeof(*file), PROT_READ|PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (file == MAP_FAILED) {
+		ret = -errno;
+		goto fail;
+	}
+
+	close(fd);
+
+	/*
+	 * Fault in all pages now, out-of-band threads must not take
+	 * a minor fault when updating their row.
+	 */
+	memset(file, 0, sizeof(*file));
+	file->busy[0] = 1;	/* Retired threads. */
+	for (slot = 0; slot < EVL_LOCKSTAT_MAX_MUTEXES; slot++)
+		file->gen[slot] = 1;
+	file->magic = EVL_LOCKSTAT_MAGIC;
+	lockstat_file = file;
+
+	return 0;
+fail:
+	close(fd);
+	shm_unlink(lockstat_shm);
+
+	return ret;
+}
+
+/* Creating a mutex is an in-band operation, we may complain. */
+static void warn_lockstat(const char *name, int efd, const char *why)
+{
+	if (lockstat_warned)
+		return;
+
+	lockstat_warned = true;
+	if (name)
+		fprintf(stderr, "evl: no lock statistics for %s: %s\n",
+			name, why);
+	else
+		fprintf(stderr, "evl: no lock statistics for @%d: %s\n",
+			efd, why);
+}
+
+/*
+ * Returns a slot number + 1 for the mutex, zero if statistics are
+ * not available, which we do not consider as an error.
+ */
+int register_lockstat(const char *name, int efd)
+{
+	int slot, ret = 0;
+
+	pthread_mutex_lock(&lockstat_lock);
+
+	if (lockstat_file == NULL && map_lockstat_file()) {
+		warn_lockstat(name, efd, "cannot create the shared file");
+		goto out;
+	}
+
+	for (slot = 0; slot < EVL_LOCKSTAT_MAX_MUTEXES; slot++) {
+		if (lockstat_file->names[slot][0] == '\0') {
+			if (name)
+				snprintf(lockstat_file->names[slot],
+					EVL_LOCKSTAT_NAMELEN, "%s", name);
+			else
+				snprintf(lockstat_file->names[slot],
+					EVL_LOCKSTAT_NAMELEN, "@%d", efd);
+			ret = slot + 1;
+			goto out;
+		}
+	}
+
+	lockstat_file->dropped_mutexes++;
+	warn_lockstat(name, efd, "too many mutexes");
+out:
+	pthread_mutex_unlock(&lockstat_lock);
+
+	return ret;
+}
+
+/*
+ * Other threads may still be updating their counts for this slot,
+ * moving to the next generation invalidates them without touching
+ * their rows. Every thread clears its own stale counts on next use.
+ */
+void unregister_lockstat(int stat_id)
+{
+	int slot = stat_id - 1;
+	__u32 gen;
+
+	pthread_mutex_lock(&lockstat_lock);
+
+	if (lockstat_file) {
+		gen = lockstat_file->gen[slot] + 1;
+		atomic_store(&lockstat_file->gen[slot], gen ?: 1);
+		lockstat_file->names[slot][0] = '\0';
+	}
+
+	pthread_mutex_unlock(&lockstat_lock);
+}
+
+/*
+ * Get the current thread's counters for a mutex. A row is claimed
+ * on the first event, which only involves atomic ops and no system
+ * call, so that out-of-band callers stay put. Running out of rows is
+ * accounted for in the file.
+ */
+struct evl_lockstat *get_lockstat(int stat_id)
+{
+	struct evl_lockstat_file *file = lockstat_file;
+	int slot = stat_id - 1, n;
+	struct evl_lockstat *st;
+	__u32 gen;
+
+	if (lockstat_row == NULL) {
+		if (file == NULL)
+			return NULL;
+		lockstat_row = NO_ROW;
+		for (n = 1; n < EVL_LOCKSTAT_MAX_ROWS; n++) {
+			if (__sync_bool_compare_and_swap(&file->busy[n], 0, 1)) {
+				lockstat_row = file->rows[n];
+				lockstat_idx = n;
+				pthread_setspecific(lockstat_key, lockstat_row);
+				break;
+			}
+		}
+		if (lockstat_row == NO_ROW)
+			__sync_fetch_and_add(&file->dropped_rows, 1);
+	}
+
+	if (lockstat_row == NO_ROW)
+		return NULL;
+
+	st = lockstat_row + slot;
+	gen = atomic_load(&file->gen[slot]);
+	if (file->row_gen[lockstat_idx][slot] != gen) {
+		memset(st, 0, sizeof(*st));
+		smp_mb();
+		atomic_store(&file->row_gen[lockstat_idx][slot], gen);
+	}
+
+	return st;
+}
+
+/* Called in the child after fork(), the file is the parent's. */
+void reset_lockstat(void)
+{
+	if (lockstat_file) {
+		munmap(lockstat_file, sizeof(*lockstat_file));
+		lockstat_file = NULL;
+	}
+
+	lockstat_row = NULL;
+	if (lockstat_key_valid)
+		pthread_setspecific(lockstat_key, NULL);
+
+	pthread_mutex_init(&lockstat_lock, NULL);
+}
+
+int evl_get_mutex_lockstat(struct evl_mutex *mutex,
+			struct evl_lockstat *stat)
+{
+	int ret = 0;
+
+	if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	if (!mutex->u.active.stat_id)
+		return -ENOENT;
+
+	pthread_mutex_lock(&lockstat_lock);
+
+	if (lockstat_file)
+		evl_sum_lockstat(lockstat_file,
+				mutex->u.active.stat_id - 1, stat);
+	else
+		ret = -ENOENT;
+
+	pthread_mutex_unlock(&lockstat_lock);
+
+	return ret;
+}
@@ -19,14 +19,29 @@
 #include <evl/atomic.h>
 #include <evl/evl.h>
 #include <evl/mutex.h>
+#include <evl/lockstat.h>
 #include <evl/thread.h>
 #include <evl/syscall.h>
 #include <linux/types.h>
 #include <uapi/evl/mutex.h>
+#include <asm/evl/processor.h>
 #include "internal.h"
 
 #define __MUTEX_DEAD_MAGIC	0
 
+/*
+ * Spinning is pointless on uniprocessor systems, and is not
+ * available to priority-protected mutexes which assign the ceiling
+ * lazily on the fast acquisition path.
+ */
+static void set_spin(struct evl_mutex *mutex, unsigned int spin_ns)
+{
+	if (mutex->u.active.protocol == EVL_GATE_PP || evl_nr_cpus < 2)
+		spin_ns = 0;
+
+	mutex->u.active.spin_ns = spin_ns;
+}
+
 static int init_mutex_vargs(struct evl_mutex *mutex,
 			int protocol, int clockfd,
 			unsigned int ceiling, int flags,
@@ -65,10 +80,12 @@ static int init_mutex_vargs(struct evl_mutex *mutex,
 	attrs.clockfd = clockfd;
 	attrs.initval = ceiling;
 	efd = create_evl_element(EVL_MONITOR_DEV, name, &attrs,	flags, &eids);
-	if (name)
-		free(name);
 	if (efd < 0)
-		return efd;
+		goto out;
+
+	mutex->u.active.stat_id = 0;
+	if (flags & EVL_MUTEX_LOCKSTAT)
+		mutex->u.active.stat_id = register_lockstat(name, efd);
 
 	gst = evl_shared_memory + eids.state_offset;
 	gst->u.gate.recursive = !!(flags & EVL_MUTEX_RECURSIVE);
@@ -80,7 +97,13 @@ static int init_mutex_vargs(struct evl_mutex *mutex,
 	mutex->u.active.monitor = EVL_MONITOR_GATE;
 	mutex->u.active.protocol = protocol;
 	mutex->u.active.efd = efd;
+	mutex->u.active.spin_ns = 0;
+	if (flags & EVL_MUTEX_ADAPTIVE)
+		set_spin(mutex, EVL_MUTEX_SPIN_NS);
 	mutex->magic = __MUTEX_ACTIVE_MAGIC;
+out:
+	if (name)
+		free(name);
 
 	return efd;
 }
@@ -100,6 +123,39 @@ static int init_mutex_static(struct evl_mutex *mutex,
 	return efd;
 }
 
+/* Built aside, init_static_element() publishes the result. */
+static int create_static_mutex(void *element)
+{
+	struct evl_mutex *mutex = element, tmp;
+	unsigned int spin_ns;
+	int efd;
+
+	if (mutex->u.uninit.monitor != EVL_MONITOR_GATE)
+		return -EINVAL;
+
+	spin_ns = mutex->u.uninit.spin_ns;
+	efd = init_mutex_static(&tmp,
+				mutex->u.uninit.clockfd,
+				mutex->u.uninit.ceiling,
+				mutex->u.uninit.flags,
+				mutex->u.uninit.name);
+	if (efd < 0)
+		return efd;
+
+	if (tmp.u.active.spin_ns && spin_ns)
+		set_spin(&tmp, spin_ns);
+
+	mutex->u = tmp.u;
+
+	return 0;
+}
+
+int init_static_mutex(void *element)
+{
+	return init_static_element(element, __MUTEX_UNINIT_MAGIC,
+				__MUTEX_ACTIVE_MAGIC, create_static_mutex);
+}
+
 static int open_mutex_vargs(struct evl_mutex *mutex,
 			const char *fmt, va_list ap)
 {
@@ -130,6 +186,8 @@ static int open_mutex_vargs(struct evl_mutex *mutex,
 	mutex->u.active.monitor = bind.type;
 	mutex->u.active.protocol = bind.protocol;
 	mutex->u.active.efd = efd;
+	mutex->u.active.spin_ns = 0;
+	mutex->u.active.stat_id = 0;
 	mutex->magic = __MUTEX_ACTIVE_MAGIC;
 
 	return 0;
@@ -155,6 +213,51 @@ int evl_create_mutex(struct evl_mutex *mutex,
 	return efd;
 }
 
+struct mutex_vec_args {
+	int clockfd;
+	unsigned int ceiling;
+	int flags;
+};
+
+static int create_mutex_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct mutex_vec_args *args = arg;
+
+	return evl_create_mutex(element, args->clockfd, args->ceiling,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_mutex_member(void *element)
+{
+	return evl_close_mutex(element);
+}
+
+/*
+ * Create @nr mutexes at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_mutex_vec(struct evl_mutex *mutexes, int nr,
+		int clockfd, unsigned int ceiling, int flags,
+		const char *fmt, ...)
+{
+	struct mutex_vec_args args = {
+		.clockfd = clockfd,
+		.ceiling = ceiling,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(mutexes, sizeof(*mutexes), nr,
+			create_mutex_member, close_mutex_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
 int evl_open_mutex(struct evl_mutex *mutex, const char *fmt, ...)
 {
 	va_list ap;
@@ -182,6 +285,11 @@ int evl_close_mutex(struct evl_mutex *mutex)
 	compiler_barrier();
 	close(efd);
 
+	if (mutex->u.active.stat_id) {
+		unregister_lockstat(mutex->u.active.stat_id);
+		mutex->u.active.stat_id = 0;
+	}
+
 	mutex->u.active.fundle = EVL_NO_HANDLE;
 	mutex->u.active.state = NULL;
 	mutex->magic = __MUTEX_DEAD_MAGIC;
@@ -189,10 +297,72 @@ int evl_close_mutex(struct evl_mutex *mutex)
 	return 0;
 }
 
+static inline long long get_mono_ns(void)
+{
+	struct timespec now;
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * Lockstat accounting, only for mutexes created with
+ * EVL_MUTEX_LOCKSTAT. Only the owner updates the acquisition date
+ * in its own row.
+ */
+static inline struct evl_lockstat *get_stat(struct evl_mutex *mutex)
+{
+	return mutex->u.active.stat_id ?
+		get_lockstat(mutex->u.active.stat_id) : NULL;
+}
+
+static void stat_acquired(struct evl_mutex *mutex, long long start,
+			bool slow)
+{
+	struct evl_lockstat *st = get_stat(mutex);
+	long long now;
+
+	if (st == NULL)
+		return;
+
+	now = get_mono_ns();
+	if (slow) {
+		st->slow++;
+		if (mutex->u.active.protocol == EVL_GATE_PP)
+			st->pp_slow++;
+	} else {
+		st->fast++;
+	}
+
+	if (start)
+		st->wait_hist[evl_lockstat_bucket(now - start)]++;
+
+	st->since = now;
+}
+
+/* Spinning got us the lock from the fast path, account for the wait. */
+static void stat_waited(struct evl_mutex *mutex, long long start)
+{
+	struct evl_lockstat *st = get_stat(mutex);
+
+	if (st)
+		st->wait_hist[evl_lockstat_bucket(get_mono_ns() - start)]++;
+}
+
+static void stat_released(struct evl_mutex *mutex)
+{
+	struct evl_lockstat *st = get_stat(mutex);
+
+	if (st)
+		st->hold_hist[evl_lockstat_bucket(get_mono_ns() - st->since)]++;
+}
+
 static int try_lock(struct evl_mutex *mutex)
 {
 	struct evl_user_window *u_window;
 	struct evl_monitor_state *gst;
+	struct evl_lockstat *st;
 	bool protect = false;
 	fundle_t current;
 	int mode, ret;
@@ -201,17 +371,11 @@ static int try_lock(struct evl_mutex *mutex)
 	if (current == EVL_NO_HANDLE)
 		return -EPERM;
 
-	if (mutex->magic == __MUTEX_UNINIT_MAGIC &&
-		mutex->u.uninit.monitor == EVL_MONITOR_GATE) {
-		ret = init_mutex_static(mutex,
-				mutex->u.uninit.clockfd,
-				mutex->u.uninit.ceiling,
-				mutex->u.uninit.flags,
-				mutex->u.uninit.name);
-		if (ret < 0)
+	if (mutex->magic != __MUTEX_ACTIVE_MAGIC) {
+		ret = init_static_mutex(mutex);
+		if (ret)
 			return ret;
-	} else if (mutex->magic != __MUTEX_ACTIVE_MAGIC)
-		return -EINVAL;
+	}
 
 	gst = mutex->u.active.state;
 
@@ -236,6 +400,8 @@ static int try_lock(struct evl_mutex *mutex)
 		if (ret == 0) {
 			gst->u.gate.nesting = 1;
 			gst->flags &= ~EVL_MONITOR_SIGNALED;
+			if (mutex->u.active.stat_id)
+				stat_acquired(mutex, 0, false);
 			return 0;
 		}
 	} else {
@@ -254,6 +420,9 @@ static int try_lock(struct evl_mutex *mutex)
 				gst->u.gate.nesting = ~0;
 				return -EAGAIN;
 			}
+			st = get_stat(mutex);
+			if (st)
+				st->recursive++;
 			return 0;
 		}
 
@@ -263,28 +432,83 @@ static int try_lock(struct evl_mutex *mutex)
 	return -ENODATA;
 }
 
+/*
+ * Adaptive mode: with short critical sections, the owner is likely
+ * to release the lock before we would be done entering the core for
+ * sleeping, so spin for a while waiting for the lock word to clear.
+ * The core does not export whether the owner is currently running,
+ * but it raises EVL_MUTEX_FLCLAIM as soon as some thread sleeps on
+ * the lock, which will be handed over directly to that waiter on
+ * release: spinning is pointless from that point, stop early.
+ */
+static int spin_lock(struct evl_mutex *mutex)
+{
+	struct evl_monitor_state *gst = mutex->u.active.state;
+	long long deadline;
+	fundle_t owner;
+	int ret, n = 0;
+
+	if (evl_get_current_mode() & (T_INBAND|T_WEAK|T_WOLI))
+		return -ENODATA;
+
+	deadline = get_mono_ns() + mutex->u.active.spin_ns;
+
+	for (;;) {
+		owner = atomic_read(&gst->u.gate.owner);
+		if (owner == EVL_NO_HANDLE) {
+			ret = try_lock(mutex);
+			if (ret != -ENODATA)
+				return ret;
+		} else if (owner & EVL_MUTEX_FLCLAIM) {
+			break;
+		}
+		cpu_relax();
+		/* Reading the clock is cheap, but not free either. */
+		if ((++n & 15) == 0 && get_mono_ns() >= deadline)
+			break;
+	}
+
+	return -ENODATA;
+}
+
 int evl_timedlock_mutex(struct evl_mutex *mutex,
 			const struct timespec *timeout)
 {
 	struct evl_monitor_state *gst;
 	struct __evl_timespec kts;
+	long long start = 0;
 	int ret;
 
 	ret = try_lock(mutex);
 	if (ret != -ENODATA)
 		return ret;
 
+	if (mutex->u.active.stat_id)
+		start = get_mono_ns();
+
+	if (mutex->u.active.spin_ns) {
+		ret = spin_lock(mutex);
+		if (ret != -ENODATA) {
+			if (ret == 0 && start)
+				stat_waited(mutex, start);
+			return ret;
+		}
+	}
+
 	do
 		ret = oob_ioctl(mutex->u.active.efd, EVL_MONIOC_ENTER,
 				__evl_ktimespec(timeout, kts));
 	while (ret && errno == EINTR);
 
-	if (ret == 0) {
-		gst = mutex->u.active.state;
-		gst->u.gate.nesting = 1;
-	}
+	if (ret)
+		return -errno;
 
-	return ret ? -errno : 0;
+	gst = mutex->u.active.state;
+	gst->u.gate.nesting = 1;
+	if (start)
+		stat_acquired(mutex, start, true);
+
+	return 0;
 }
 
 int evl_lock_mutex(struct evl_mutex *mutex)
@@ -296,6 +520,7 @@ int evl_lock_mutex(struct evl_mutex *mutex)
 
 int evl_trylock_mutex(struct evl_mutex *mutex)
 {
+	struct evl_lockstat *st;
 	int ret;
 
 	ret = try_lock(mutex);
@@ -306,7 +531,18 @@ int evl_trylock_mutex(struct evl_mutex *mutex)
 		ret = oob_ioctl(mutex->u.active.efd, EVL_MONIOC_TRYENTER);
 	while (ret && errno == EINTR);
 
-	return ret ? -errno : 0;
+	if (ret) {
+		ret = -errno;
+		st = get_stat(mutex);
+		if (st)
+			st->trylock_failed++;
+		return ret;
+	}
+
+	if (mutex->u.active.stat_id)
+		stat_acquired(mutex, 0, true);
+
+	return 0;
 }
 
 int evl_unlock_mutex(struct evl_mutex *mutex)
@@ -329,6 +565,9 @@ int evl_unlock_mutex(struct evl_mutex *mutex)
 		return 0;
 	}
 
+	if (mutex->u.active.stat_id)
+		stat_released(mutex);
+
 	/* Do we have waiters on a signaled event we are gating? */
 	if (gst->flags & EVL_MONITOR_SIGNALED)
 		goto slow_path;
@@ -405,3 +644,31 @@ int evl_get_mutex_ceiling(struct evl_mutex *mutex)
 
 	return mutex->u.active.state->u.gate.ceiling;
 }
+
+/*
+ * Set the spinning time of an adaptive mutex, zero disabling
+ * adaptive mode. A static mutex keeps the setting until it is
+ * created on first use.
+ */
+int evl_set_mutex_spin(struct evl_mutex *mutex,
+		unsigned int spin_ns)
+{
+	if (mutex->magic == __MUTEX_UNINIT_MAGIC) {
+		if (mutex->u.uninit.monitor != EVL_MONITOR_GATE)
+			return -EINVAL;
+		if (spin_ns)
+			mutex->u.uninit.flags |= EVL_MUTEX_ADAPTIVE;
+		else
+			mutex->u.uninit.flags &= ~EVL_MUTEX_ADAPTIVE;
+		mutex->u.uninit.spin_ns = spin_ns;
+		return 0;
+	}
+
+	if (mutex->magic != __MUTEX_ACTIVE_MAGIC ||
+		mutex->u.active.monitor != EVL_MONITOR_GATE)
+		return -EINVAL;
+
+	set_spin(mutex, spin_ns);
+
+	return 0;
+}
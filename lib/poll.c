@@ -50,6 +50,29 @@ int evl_mod_pollfd(int efd, int fd,
 	return update_pollset(efd, EVL_POLL_CTLMOD, fd, events, pollval);
 }
 
+/*
+ * Apply @nr add/mod/del requests to a poll set, storing the outcome
+ * of each one to @status, i.e. zero or a negated error code. Returns
+ * the number of failed requests. The core has no vectored request,
+ * so this issues one EVL_POLIOC_CTL per entry.
+ */
+int evl_ctl_pollfds(int efd, struct evl_poll_ctlreq *vec,
+		int nr, int *status)
+{
+	int n, nrfail = 0;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	for (n = 0; n < nr; n++) {
+		status[n] = update_pollset(efd, vec[n].action, vec[n].fd,
+					vec[n].events, vec[n].pollval);
+		nrfail += status[n] != 0;
+	}
+
+	return nrfail;
+}
+
 static int do_poll(int efd, struct evl_poll_event *pollset,
 		int nrset, const struct timespec *timeout)
 {
@@ -0,0 +1,307 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/mutex.h>
+#include <evl/sem.h>
+#include <evl/flags.h>
+#include <evl/pool.h>
+
+/*
+ * Free elements are linked into a lock-free stack of indices. The
+ * head word carries a modification tag in its upper half, which
+ * prevents ABA issues when an element is checked out then back in
+ * while a concurrent pop is in flight.
+ */
+#define POOL_NIL	0
+
+static inline __u64 make_head(__u64 old, int idx)
+{
+	return ((old >> 32) + 1) << 32 | (__u32)(idx + 1);
+}
+
+static void push_element(struct evl_element_pool *pool, int idx)
+{
+	__u64 old, new;
+
+	do {
+		old = atomic_load(&pool->head);
+		pool->next[idx] = (__u32)old;
+		new = make_head(old, idx);
+	} while (!__sync_bool_compare_and_swap(&pool->head, old, new));
+
+	__sync_fetch_and_add(&pool->nr_free, 1);
+}
+
+static int pop_element(struct evl_element_pool *pool)
+{
+	__u64 old, new;
+	__u32 top;
+
+	do {
+		old = atomic_load(&pool->head);
+		top = (__u32)old;
+		if (top == POOL_NIL)
+			return -1;
+		new = make_head(old, (int)atomic_load(&pool->next[top - 1]) - 1);
+	} while (!__sync_bool_compare_and_swap(&pool->head, old, new));
+
+	__sync_fetch_and_sub(&pool->nr_free, 1);
+
+	return top - 1;
+}
+
+static int create_element(struct evl_element_pool *pool, int idx)
+{
+	union evl_pool_element *e = pool->elements + idx;
+	int efd;
+
+	switch (pool->type) {
+	case EVL_POOL_MUTEX:
+		efd = evl_create_mutex(&e->mutex, pool->clockfd, 0,
+				EVL_MUTEX_NORMAL|pool->flags, NULL);
+		break;
+	case EVL_POOL_SEM:
+		efd = evl_create_sem(&e->sem, pool->clockfd, 0,
+				pool->flags, NULL);
+		break;
+	default:
+		efd = evl_create_flags(&e->flags, pool->clockfd, 0,
+				pool->flags, NULL);
+	}
+
+	return efd < 0 ? efd : 0;
+}
+
+static void close_element(struct evl_element_pool *pool, int idx)
+{
+	union evl_pool_element *e = pool->elements + idx;
+
+	switch (pool->type) {
+	case EVL_POOL_MUTEX:
+		evl_close_mutex(&e->mutex);
+		break;
+	case EVL_POOL_SEM:
+		evl_close_sem(&e->sem);
+		break;
+	default:
+		evl_close_flags(&e->flags);
+	}
+}
+
+/*
+ * Only the refiller creates elements once the pool is live, so it
+ * is the single writer of nr_created. We top up the pool to twice
+ * the low watermark, within the capacity limit.
+ */
+static void fill_pool(struct evl_element_pool *pool)
+{
+	int n;
+
+	while (atomic_load(&pool->nr_free) < pool->low_mark * 2) {
+		n = pool->nr_created;
+		if (n >= pool->capacity || create_element(pool, n))
+			break;
+		atomic_store(&pool->nr_created, n + 1);
+		push_element(pool, n);
+	}
+}
+
+static void *refill_pool(void *arg)
+{
+	struct evl_element_pool *pool = arg;
+	static int serial;
+	int ret;
+
+	ret = evl_attach_self("pool-refill:%d.%d", getpid(),
+			__sync_fetch_and_add(&serial, 1));
+	if (ret < 0)
+		return NULL;
+
+	for (;;) {
+		ret = evl_get_sem(&pool->refill);
+		if (ret || atomic_load(&pool->stop))
+			break;
+		/*
+		 * Clear the request before filling, a consumer
+		 * dipping below the watermark meanwhile would post
+		 * another one, which is harmless.
+		 */
+		atomic_store(&pool->refill_pending, 0);
+		smp_mb();
+		fill_pool(pool);
+	}
+
+	evl_detach_self();
+
+	return NULL;
+}
+
+static void request_refill(struct evl_element_pool *pool)
+{
+	if (!pool->has_refiller ||
+		atomic_load(&pool->nr_created) >= pool->capacity)
+		return;
+
+	if (__sync_bool_compare_and_swap(&pool->refill_pending, 0, 1))
+		evl_put_sem(&pool->refill);
+}
+
+/* In-band only. */
+int evl_init_element_pool(struct evl_element_pool *pool,
+			int type, int capacity,
+			int prefill, int low_mark,
+			int clockfd, int flags)
+{
+	int ret, n;
+
+	if (type != EVL_POOL_MUTEX && type != EVL_POOL_SEM &&
+		type != EVL_POOL_FLAGS)
+		return -EINVAL;
+
+	if (capacity <= 0 || prefill < 0 || prefill > capacity ||
+		low_mark < 0 || low_mark > capacity)
+		return -EINVAL;
+
+	pool->elements = calloc(capacity, sizeof(*pool->elements));
+	if (pool->elements == NULL)
+		return -ENOMEM;
+
+	pool->next = calloc(capacity, sizeof(*pool->next));
+	if (pool->next == NULL) {
+		ret = -ENOMEM;
+		goto fail_next;
+	}
+
+	pool->head = 0;
+	pool->nr_free = 0;
+	pool->refill_pending = 0;
+	pool->nr_created = 0;
+	pool->stop = 0;
+	pool->type = type;
+	pool->capacity = capacity;
+	pool->low_mark = low_mark;
+	pool->clockfd = clockfd;
+	pool->flags = flags;
+	pool->has_refiller = false;
+
+	for (n = 0; n < prefill; n++) {
+		ret = create_element(pool, n);
+		if (ret)
+			goto fail_create;
+		pool->nr_created = n + 1;
+		push_element(pool, n);
+	}
+
+	if (low_mark == 0)
+		return 0;
+
+	ret = evl_create_sem(&pool->refill, EVL_CLOCK_MONOTONIC, 0, 0, NULL);
+	if (ret < 0)
+		goto fail_create;
+
+	ret = -pthread_create(&pool->refiller, NULL, refill_pool, pool);
+	if (ret)
+		goto fail_thread;
+
+	pool->has_refiller = true;
+
+	return 0;
+
+fail_thread:
+	evl_close_sem(&pool->refill);
+fail_create:
+	while (--n >= 0)
+		close_element(pool, n);
+	free(pool->next);
+fail_next:
+	free(pool->elements);
+
+	return ret;
+}
+
+/*
+ * Check out an element. This never enters the kernel, except for
+ * waking up the refiller when the pool runs low. NULL is returned
+ * if no element is available at the moment.
+ */
+void *evl_get_pool_element(struct evl_element_pool *pool)
+{
+	int idx;
+
+	idx = pop_element(pool);
+	if (atomic_load(&pool->nr_free) < pool->low_mark)
+		request_refill(pool);
+
+	return idx < 0 ? NULL : pool->elements + idx;
+}
+
+/*
+ * Check an element back in. Mutexes must be unlocked; pending
+ * semaphore units and flag bits are discarded so that the next user
+ * starts from a clean state.
+ */
+int evl_put_pool_element(struct evl_element_pool *pool, void *element)
+{
+	union evl_pool_element *e = element;
+	int idx, bits;
+
+	idx = e - pool->elements;
+	if (e < pool->elements || idx >= atomic_load(&pool->nr_created) ||
+		(union evl_pool_element *)element != pool->elements + idx)
+		return -EINVAL;
+
+	switch (pool->type) {
+	case EVL_POOL_SEM:
+		while (evl_tryget_sem(&e->sem) == 0)
+			;
+		break;
+	case EVL_POOL_FLAGS:
+		evl_trywait_flags(&e->flags, &bits);
+		break;
+	}
+
+	push_element(pool, idx);
+
+	return 0;
+}
+
+int evl_get_pool_free(struct evl_element_pool *pool)
+{
+	return atomic_load(&pool->nr_free);
+}
+
+/* In-band only, no element may be checked out. */
+int evl_destroy_element_pool(struct evl_element_pool *pool)
+{
+	int n;
+
+	if (pool->has_refiller) {
+		atomic_store(&pool->stop, 1);
+		smp_mb();
+		evl_put_sem(&pool->refill);
+		pthread_join(pool->refiller, NULL);
+		evl_close_sem(&pool->refill);
+		pool->has_refiller = false;
+	}
+
+	for (n = 0; n < pool->nr_created; n++)
+		close_element(pool, n);
+
+	free(pool->next);
+	free(pool->elements);
+	pool->next = NULL;
+	pool->elements = NULL;
+
+	return 0;
+}
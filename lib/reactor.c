@@ -0,0 +1,359 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/syscall.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/flags.h>
+#include <evl/poll.h>
+#include <evl/reactor.h>
+
+/*
+ * The reactor API is not thread-safe, except evl_defer_reactor_call()
+ * and evl_stop_reactor(): sources are added and removed by the
+ * reactor thread, usually from the handlers it runs.
+ */
+
+static void handle_wakeup(struct evl_reactor_source *src,
+			unsigned int revents)
+{
+	struct evl_reactor *reactor = src->arg;
+	int bits;
+
+	evl_trywait_flags(&reactor->wakeup, &bits);
+}
+
+int evl_init_reactor(struct evl_reactor *reactor, int batch)
+{
+	int ret, efd;
+
+	if (batch <= 0)
+		return -EINVAL;
+
+	reactor->events = malloc(batch * sizeof(*reactor->events));
+	reactor->ready = malloc(batch * sizeof(*reactor->ready));
+	if (reactor->events == NULL || reactor->ready == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	reactor->pollfd = evl_new_poll();
+	if (reactor->pollfd < 0) {
+		ret = reactor->pollfd;
+		goto fail_alloc;
+	}
+
+	efd = evl_new_flags(&reactor->wakeup, NULL);
+	if (efd < 0) {
+		ret = efd;
+		goto fail_flags;
+	}
+
+	reactor->batch = batch;
+	reactor->nr_ready = 0;
+	reactor->stop = 0;
+	reactor->serial = 0;
+	reactor->calls = NULL;
+	list_init(&reactor->sources);
+
+	/* Runs first, deferred calls run last. */
+	ret = evl_add_reactor_fd(reactor, &reactor->wakeup_src, efd,
+				POLLIN, INT_MAX, handle_wakeup, reactor);
+	if (ret)
+		goto fail_wakeup;
+
+	return 0;
+
+fail_wakeup:
+	evl_close_flags(&reactor->wakeup);
+fail_flags:
+	close(reactor->pollfd);
+fail_alloc:
+	free(reactor->ready);
+	free(reactor->events);
+
+	return ret;
+}
+
+static int add_source(struct evl_reactor *reactor,
+		struct evl_reactor_source *src,
+		int fd, unsigned int events, int prio,
+		evl_reactor_handler_t handler, void *arg,
+		bool is_timer)
+{
+	int ret;
+
+	if (handler == NULL)
+		return -EINVAL;
+
+	src->fd = fd;
+	src->events = events;
+	src->prio = prio;
+	src->handler = handler;
+	src->arg = arg;
+	src->ticks = 0;
+	src->revents = 0;
+	src->is_timer = is_timer;
+
+	ret = evl_add_pollfd(reactor->pollfd, fd, events, evl_ptrval(src));
+	if (ret)
+		return ret;
+
+	src->serial = reactor->serial++;
+	src->reactor = reactor;
+	list_append(&src->next, &reactor->sources);
+
+	return 0;
+}
+
+int evl_add_reactor_fd(struct evl_reactor *reactor,
+		struct evl_reactor_source *src,
+		int fd, unsigned int events, int prio,
+		evl_reactor_handler_t handler, void *arg)
+{
+	return add_source(reactor, src, fd, events, prio,
+			handler, arg, false);
+}
+
+/*
+ * Arm a timer firing at the absolute @date, then every @period if
+ * the latter is non-NULL and non-zero. The handler finds the number
+ * of expiries since the previous dispatch in src->ticks.
+ */
+int evl_add_reactor_timer(struct evl_reactor *reactor,
+			struct evl_reactor_source *src,
+			int clockfd, const struct timespec *date,
+			const struct timespec *period, int prio,
+			evl_reactor_handler_t handler, void *arg)
+{
+	struct itimerspec its;
+	int tfd, ret;
+
+	tfd = evl_new_timer(clockfd);
+	if (tfd < 0)
+		return tfd;
+
+	its.it_value = *date;
+	if (period)
+		its.it_interval = *period;
+	else
+		its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+
+	ret = evl_set_timer(tfd, &its, NULL);
+	if (ret)
+		goto fail;
+
+	ret = add_source(reactor, src, tfd, POLLIN, prio,
+			handler, arg, true);
+	if (ret)
+		goto fail;
+
+	return 0;
+fail:
+	close(tfd);
+
+	return ret;
+}
+
+/*
+ * A source may be removed from any handler, including its own. It
+ * is not dispatched anymore from that point, even if it is part of
+ * the current batch. Timers are disarmed and released. The caller
+ * may free @src on return.
+ */
+int evl_del_reactor_source(struct evl_reactor_source *src)
+{
+	struct evl_reactor *reactor = src->reactor;
+	int ret, n;
+
+	if (reactor == NULL)
+		return -EINVAL;
+
+	/* The batch must not refer to @src anymore. */
+	for (n = 0; n < reactor->nr_ready; n++) {
+		if (reactor->ready[n] == src)
+			reactor->ready[n] = NULL;
+	}
+
+	ret = evl_del_pollfd(reactor->pollfd, src->fd);
+	list_remove(&src->next);
+	src->reactor = NULL;
+
+	if (src->is_timer)
+		close(src->fd);
+
+	return ret;
+}
+
+/*
+ * Have @fn run by the reactor thread, after the events of its next
+ * wake-up were dispatched. Calls run in the order they were
+ * deferred. This may be called from any thread.
+ */
+int evl_defer_reactor_call(struct evl_reactor *reactor,
+			struct evl_reactor_call *call,
+			evl_reactor_fn_t fn, void *arg)
+{
+	struct evl_reactor_call *head;
+
+	call->fn = fn;
+	call->arg = arg;
+
+	do {
+		head = atomic_load(&reactor->calls);
+		call->next = head;
+	} while (!__sync_bool_compare_and_swap(&reactor->calls, head, call));
+
+	/* Only the first pending call needs to kick the reactor. */
+	if (head == NULL)
+		return evl_post_flags(&reactor->wakeup, 1);
+
+	return 0;
+}
+
+static void run_calls(struct evl_reactor *reactor)
+{
+	struct evl_reactor_call *call, *next, *fifo = NULL;
+
+	call = __sync_lock_test_and_set(&reactor->calls, NULL);
+
+	while (call) {
+		next = call->next;
+		call->next = fifo;
+		fifo = call;
+		call = next;
+	}
+
+	while (fifo) {
+		next = fifo->next;
+		fifo->fn(fifo);
+		fifo = next;
+	}
+}
+
+static inline bool dispatch_before(const struct evl_reactor_source *a,
+				const struct evl_reactor_source *b)
+{
+	if (a->prio != b->prio)
+		return a->prio > b->prio;
+
+	return (int)(a->serial - b->serial) < 0;
+}
+
+static void dispatch_source(struct evl_reactor_source *src)
+{
+	unsigned int revents = src->revents;
+	ssize_t ret;
+
+	src->revents = 0;
+
+	if (src->is_timer && (revents & POLLIN)) {
+		ret = oob_read(src->fd, &src->ticks, sizeof(src->ticks));
+		if (ret != sizeof(src->ticks))
+			return;
+	}
+
+	src->handler(src, revents);
+}
+
+/*
+ * Wait for events until the absolute @timeout based on the monotonic
+ * clock, or indefinitely if NULL, then dispatch all of them. Returns
+ * the number of events received.
+ */
+int evl_run_reactor(struct evl_reactor *reactor,
+		const struct timespec *timeout)
+{
+	struct evl_reactor_source *src;
+	struct timespec ts;
+	int nr, n, k;
+
+	if (timeout) {
+		ts = *timeout;
+		nr = evl_timedpoll(reactor->pollfd, reactor->events,
+				reactor->batch, &ts);
+	} else {
+		nr = evl_poll(reactor->pollfd, reactor->events,
+			reactor->batch);
+	}
+
+	if (nr < 0)
+		return nr;
+
+	/* Batches are short, an insertion sort does fine. */
+	for (n = 0; n < nr; n++) {
+		src = reactor->events[n].pollval.ptr;
+		src->revents = reactor->events[n].events;
+		for (k = n; k > 0; k--) {
+			if (!dispatch_before(src, reactor->ready[k - 1]))
+				break;
+			reactor->ready[k] = reactor->ready[k - 1];
+		}
+		reactor->ready[k] = src;
+	}
+
+	/* Handlers may delete sources, which clears their ready slot. */
+	reactor->nr_ready = nr;
+
+	for (n = 0; n < nr; n++) {
+		src = reactor->ready[n];
+		if (src && src->revents)
+			dispatch_source(src);
+	}
+
+	reactor->nr_ready = 0;
+
+	run_calls(reactor);
+
+	return nr;
+}
+
+int evl_loop_reactor(struct evl_reactor *reactor)
+{
+	int ret;
+
+	while (!atomic_load(&reactor->stop)) {
+		ret = evl_run_reactor(reactor, NULL);
+		if (ret < 0 && ret != -EINTR)
+			return ret;
+	}
+
+	atomic_store(&reactor->stop, 0);
+
+	return 0;
+}
+
+/* Have evl_loop_reactor() return, this may be called from any thread. */
+void evl_stop_reactor(struct evl_reactor *reactor)
+{
+	atomic_store(&reactor->stop, 1);
+	evl_post_flags(&reactor->wakeup, 1);
+}
+
+int evl_close_reactor(struct evl_reactor *reactor)
+{
+	struct evl_reactor_source *src, *tmp;
+
+	list_for_each_entry_safe(src, tmp, &reactor->sources, next) {
+		list_remove(&src->next);
+		src->reactor = NULL;
+		if (src->is_timer)
+			close(src->fd);
+	}
+
+	close(reactor->pollfd);
+	evl_close_flags(&reactor->wakeup);
+	free(reactor->ready);
+	free(reactor->events);
+
+	return 0;
+}
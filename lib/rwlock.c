@@ -0,0 +1,403 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <evl/rwlock.h>
+#include "internal.h"
+
+#define __RWLOCK_ACTIVE_MAGIC	0x7a1d7a1d
+#define __RWLOCK_DEAD_MAGIC	0
+
+/*
+ * Lock word layout: the low bits count the readers holding the
+ * lock, RW_WRITER is set by the writer owning the gate mutex,
+ * RW_DRAIN tells the last reader to leave that this writer sleeps
+ * until the read side is empty.
+ */
+#define RW_WRITER	(1U << 31)
+#define RW_DRAIN	(1U << 30)
+#define RW_READERS	(RW_DRAIN - 1)
+
+static int init_rwlock_vargs(struct evl_rwlock *rwlock,
+			int clockfd, int flags,
+			const char *fmt, va_list ap)
+{
+	char *name = NULL;
+	int efd, ret;
+
+	/*
+	 * The lock word lives in the caller's memory, which other
+	 * processes could not share the gate mutex with.
+	 */
+	if (flags & EVL_CLONE_PUBLIC)
+		return -EINVAL;
+
+	if (fmt) {
+		ret = vasprintf(&name, fmt, ap);
+		if (ret < 0)
+			return -ENOMEM;
+		/* A leading slash would turn on public mode. */
+		if (*name == '/') {
+			free(name);
+			return -EINVAL;
+		}
+	}
+
+	efd = evl_create_mutex(&rwlock->u.active.lock, clockfd, 0,
+			EVL_MUTEX_NORMAL|flags, name ? "%s" : NULL, name);
+	if (efd < 0)
+		goto out;
+
+	ret = evl_create_event(&rwlock->u.active.rdq, clockfd, flags,
+			name ? "%s.rd" : NULL, name);
+	if (ret < 0)
+		goto fail_rdq;
+
+	ret = evl_create_event(&rwlock->u.active.wrq, clockfd, flags,
+			name ? "%s.wr" : NULL, name);
+	if (ret < 0)
+		goto fail_wrq;
+
+	rwlock->u.active.word = 0;
+	rwlock->u.active.rd_waiters = 0;
+	rwlock->u.active.wr_waiters = 0;
+	rwlock->magic = __RWLOCK_ACTIVE_MAGIC;
+	goto out;
+
+fail_wrq:
+	evl_close_event(&rwlock->u.active.rdq);
+fail_rdq:
+	evl_close_mutex(&rwlock->u.active.lock);
+	efd = ret;
+out:
+	if (name)
+		free(name);
+
+	return efd;
+}
+
+static int init_rwlock_static(struct evl_rwlock *rwlock,
+			int clockfd, int flags,
+			const char *fmt, ...)
+{
+	va_list ap;
+	int efd;
+
+	va_start(ap, fmt);
+	efd = init_rwlock_vargs(rwlock, clockfd, flags, fmt, ap);
+	va_end(ap);
+
+	return efd;
+}
+
+int evl_create_rwlock(struct evl_rwlock *rwlock,
+		int clockfd, int flags,
+		const char *fmt, ...)
+{
+	va_list ap;
+	int efd;
+
+	va_start(ap, fmt);
+	efd = init_rwlock_vargs(rwlock, clockfd, flags, fmt, ap);
+	va_end(ap);
+
+	return efd;
+}
+
+int evl_close_rwlock(struct evl_rwlock *rwlock)
+{
+	if (rwlock->magic == __RWLOCK_UNINIT_MAGIC)
+		return 0;
+
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	rwlock->magic = __RWLOCK_DEAD_MAGIC;
+	evl_close_event(&rwlock->u.active.wrq);
+	evl_close_event(&rwlock->u.active.rdq);
+
+	return evl_close_mutex(&rwlock->u.active.lock);
+}
+
+/*
+ * Built aside, init_static_element() publishes the result. The
+ * sub-elements are plain handles, copying them is fine.
+ */
+static int create_static_rwlock(void *element)
+{
+	struct evl_rwlock *rwlock = element, tmp;
+	int efd;
+
+	efd = init_rwlock_static(&tmp,
+				rwlock->u.uninit.clockfd,
+				rwlock->u.uninit.flags,
+				rwlock->u.uninit.name);
+	if (efd < 0)
+		return efd;
+
+	rwlock->u = tmp.u;
+
+	return 0;
+}
+
+int init_static_rwlock(void *element)
+{
+	return init_static_element(element, __RWLOCK_UNINIT_MAGIC,
+				__RWLOCK_ACTIVE_MAGIC, create_static_rwlock);
+}
+
+static int check_sanity(struct evl_rwlock *rwlock)
+{
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return init_static_rwlock(rwlock);
+
+	return 0;
+}
+
+static inline bool read_trylock(__u32 *word)
+{
+	__u32 val = atomic_load(word), prev;
+
+	while (!(val & RW_WRITER)) {
+		prev = __sync_val_compare_and_swap(word, val, val + 1);
+		if (prev == val)
+			return true;
+		val = prev;
+	}
+
+	return false;
+}
+
+/* Wake up everyone sleeping on the lock, gate mutex held. */
+static void wake_waiters(struct evl_rwlock *rwlock)
+{
+	if (rwlock->u.active.wr_waiters)
+		evl_broadcast_event(&rwlock->u.active.wrq);
+
+	if (rwlock->u.active.rd_waiters)
+		evl_broadcast_event(&rwlock->u.active.rdq);
+}
+
+/*
+ * A zero timeout means infinite wait to the core, as with the
+ * mutex and event services we build on.
+ */
+static int read_lock(struct evl_rwlock *rwlock,
+		const struct timespec *timeout)
+{
+	__u32 *word = &rwlock->u.active.word;
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	if (read_trylock(word))
+		return 0;
+
+	/*
+	 * A writer owns or claims the lock. If it is running its
+	 * write section, we block on the gate mutex it holds, which
+	 * boosts it.
+	 */
+	ret = evl_timedlock_mutex(&rwlock->u.active.lock, timeout);
+	if (ret)
+		return ret;
+
+	while (!read_trylock(word)) {
+		rwlock->u.active.rd_waiters++;
+		ret = evl_timedwait_event(&rwlock->u.active.rdq,
+					&rwlock->u.active.lock, timeout);
+		rwlock->u.active.rd_waiters--;
+		if (ret)
+			break;
+	}
+
+	evl_unlock_mutex(&rwlock->u.active.lock);
+
+	return ret;
+}
+
+int evl_timedrdlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout)
+{
+	return read_lock(rwlock, timeout);
+}
+
+int evl_rdlock_rwlock(struct evl_rwlock *rwlock)
+{
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 0 };
+
+	return read_lock(rwlock, &timeout);
+}
+
+int evl_tryrdlock_rwlock(struct evl_rwlock *rwlock)
+{
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	return read_trylock(&rwlock->u.active.word) ? 0 : -EAGAIN;
+}
+
+static int write_lock(struct evl_rwlock *rwlock,
+		const struct timespec *timeout)
+{
+	__u32 *word = &rwlock->u.active.word, prev;
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	ret = evl_timedlock_mutex(&rwlock->u.active.lock, timeout);
+	if (ret)
+		return ret;
+
+	/*
+	 * We may have been granted the gate mutex while another
+	 * writer waits for the readers to drain, let it go first.
+	 */
+	while (atomic_load(word) & RW_WRITER) {
+		rwlock->u.active.wr_waiters++;
+		ret = evl_timedwait_event(&rwlock->u.active.wrq,
+					&rwlock->u.active.lock, timeout);
+		rwlock->u.active.wr_waiters--;
+		if (ret)
+			goto fail;
+	}
+
+	/* From this point, new readers are held off. */
+	prev = __sync_fetch_and_or(word, RW_WRITER);
+
+	while (prev & RW_READERS) {
+		/*
+		 * Setting RW_DRAIN and sampling the reader count in
+		 * a single atomic op guarantees that the last reader
+		 * to leave sees it.
+		 */
+		prev = __sync_fetch_and_or(word, RW_DRAIN);
+		if (!(prev & RW_READERS))
+			break;
+		rwlock->u.active.wr_waiters++;
+		ret = evl_timedwait_event(&rwlock->u.active.wrq,
+					&rwlock->u.active.lock, timeout);
+		rwlock->u.active.wr_waiters--;
+		if (ret) {
+			__sync_fetch_and_and(word, ~(RW_WRITER|RW_DRAIN));
+			wake_waiters(rwlock);
+			goto fail;
+		}
+		prev = atomic_load(word);
+	}
+
+	__sync_fetch_and_and(word, ~RW_DRAIN);
+
+	return 0;
+fail:
+	evl_unlock_mutex(&rwlock->u.active.lock);
+
+	return ret;
+}
+
+int evl_timedwrlock_rwlock(struct evl_rwlock *rwlock,
+			const struct timespec *timeout)
+{
+	return write_lock(rwlock, timeout);
+}
+
+int evl_wrlock_rwlock(struct evl_rwlock *rwlock)
+{
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 0 };
+
+	return write_lock(rwlock, &timeout);
+}
+
+int evl_trywrlock_rwlock(struct evl_rwlock *rwlock)
+{
+	__u32 *word = &rwlock->u.active.word;
+	int ret;
+
+	ret = check_sanity(rwlock);
+	if (ret)
+		return ret;
+
+	if (atomic_load(word))
+		return -EAGAIN;
+
+	ret = evl_trylock_mutex(&rwlock->u.active.lock);
+	if (ret)
+		return ret;
+
+	if (!__sync_bool_compare_and_swap(word, 0, RW_WRITER)) {
+		evl_unlock_mutex(&rwlock->u.active.lock);
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+static int read_unlock(struct evl_rwlock *rwlock)
+{
+	__u32 val;
+	int ret;
+
+	val = __sync_sub_and_fetch(&rwlock->u.active.word, 1);
+	if (val != (RW_WRITER|RW_DRAIN))
+		return 0;
+
+	/*
+	 * We are the last reader, and a writer is waiting for us to
+	 * leave. It holds the gate mutex until it sleeps on wrq.
+	 */
+	ret = evl_lock_mutex(&rwlock->u.active.lock);
+	if (ret)
+		return ret;
+
+	if (rwlock->u.active.wr_waiters)
+		evl_broadcast_event(&rwlock->u.active.wrq);
+
+	return evl_unlock_mutex(&rwlock->u.active.lock);
+}
+
+static int write_unlock(struct evl_rwlock *rwlock)
+{
+	__sync_fetch_and_and(&rwlock->u.active.word, ~RW_WRITER);
+	wake_waiters(rwlock);
+
+	return evl_unlock_mutex(&rwlock->u.active.lock);
+}
+
+int evl_unlock_rwlock(struct evl_rwlock *rwlock)
+{
+	__u32 val;
+
+	if (rwlock->magic != __RWLOCK_ACTIVE_MAGIC)
+		return -EINVAL;
+
+	/*
+	 * Readers may only hold the lock while the reader count is
+	 * non-zero, a writer only when it dropped to zero.
+	 */
+	val = atomic_load(&rwlock->u.active.word);
+	if (val & RW_READERS)
+		return read_unlock(rwlock);
+
+	if (val & RW_WRITER)
+		return write_unlock(rwlock);
+
+	return -EPERM;
+}
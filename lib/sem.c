@@ -66,6 +66,51 @@ int evl_create_sem(struct evl_sem *sem, int clockfd,
 	return efd;
 }
 
+struct sem_vec_args {
+	int clockfd;
+	int initval;
+	int flags;
+};
+
+static int create_sem_member(void *element, const char *name,
+			int index, void *arg)
+{
+	struct sem_vec_args *args = arg;
+
+	return evl_create_sem(element, args->clockfd, args->initval,
+			args->flags, name ? "%s.%d" : NULL, name, index);
+}
+
+static int close_sem_member(void *element)
+{
+	return evl_close_sem(element);
+}
+
+/*
+ * Create @nr semaphores at once, named <name>.<index> when a name is
+ * given. Either all of them are created, or none.
+ */
+int evl_create_sem_vec(struct evl_sem *sems, int nr,
+		int clockfd, int initval, int flags,
+		const char *fmt, ...)
+{
+	struct sem_vec_args args = {
+		.clockfd = clockfd,
+		.initval = initval,
+		.flags = flags,
+	};
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = create_element_vec(sems, sizeof(*sems), nr,
+			create_sem_member, close_sem_member,
+			&args, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
 int evl_open_sem(struct evl_sem *sem, const char *fmt, ...)
 {
 	struct evl_monitor_binding bind;
@@ -127,20 +172,37 @@ int evl_close_sem(struct evl_sem *sem)
 	return 0;
 }
 
-static int check_sanity(struct evl_sem *sem)
+/* Built aside, init_static_element() publishes the result. */
+static int create_static_sem(void *element)
 {
+	struct evl_sem *sem = element, tmp;
 	int efd;
 
-	if (sem->magic == __SEM_UNINIT_MAGIC) {
-		efd = evl_create_sem(sem,
-				sem->u.uninit.clockfd,
-				sem->u.uninit.initval,
-				sem->u.uninit.flags,
-				sem->u.uninit.name);
-		return efd < 0 ? efd : 0;
-	}
+	efd = evl_create_sem(&tmp,
+			sem->u.uninit.clockfd,
+			sem->u.uninit.initval,
+			sem->u.uninit.flags,
+			sem->u.uninit.name);
+	if (efd < 0)
+		return efd;
+
+	sem->u = tmp.u;
+
+	return 0;
+}
+
+int init_static_sem(void *element)
+{
+	return init_static_element(element, __SEM_UNINIT_MAGIC,
+				__SEM_ACTIVE_MAGIC, create_static_sem);
+}
+
+static int check_sanity(struct evl_sem *sem)
+{
+	if (sem->magic != __SEM_ACTIVE_MAGIC)
+		return init_static_sem(sem);
 
-	return sem->magic != __SEM_ACTIVE_MAGIC ? -EINVAL : 0;
+	return 0;
 }
 
 /*
@@ -149,49 +211,40 @@ static int check_sanity(struct evl_sem *sem)
  * built-in does issue proper full memory barrier on successful swap,
  * so we should not have to emit them manually.
  */
-static int try_get(struct evl_monitor_state *state)
+static int try_get(struct evl_monitor_state *state, int count)
 {
 	int val, prev, next;
 
 	val = atomic_read(&state->u.event.value);
-	if (val <= 0)
+	if (val < count)
 		return -EAGAIN;
 
 	do {
 		prev = val;
-		next = prev - 1;
+		next = prev - count;
 		val = atomic_cmpxchg(&state->u.event.value, prev, next);
 		/*
-		 * If the semaphore's value was strictly positive and
-		 * we end up with a negative one after a swap attempt,
-		 * then cmpxchg must have failed, and the non-blocking
-		 * P operation failed.
+		 * If the semaphore's value was large enough and we
+		 * end up with a lower one after a swap attempt, then
+		 * cmpxchg must have failed, and the non-blocking P
+		 * operation failed.
 		 */
-		if (val <= 0)
+		if (val < count)
 			return -EAGAIN;
 	} while (val != prev);
 
 	return 0;
 }
 
-int evl_timedget_sem(struct evl_sem *sem, const struct timespec *timeout)
+static int get_sem(struct evl_sem *sem, const struct timespec *timeout)
 {
 	struct evl_monitor_state *state;
 	struct evl_monitor_waitreq req;
 	struct __evl_timespec kts;
-	fundle_t current;
 	int ret;
 
-	current = evl_get_current();
-	if (current == EVL_NO_HANDLE)
-		return -EPERM;
-
-	ret = check_sanity(sem);
-	if (ret)
-		return ret;
-
 	state = sem->u.active.state;
-	ret = try_get(state);
+	ret = try_get(state, 1);
 	if (ret != -EAGAIN)
 		return ret;
 
@@ -205,38 +258,16 @@ int evl_timedget_sem(struct evl_sem *sem, const struct timespec *timeout)
 	return ret ? -errno : req.status;
 }
 
-int evl_get_sem(struct evl_sem *sem)
-{
-	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 0 };
-
-	return evl_timedget_sem(sem, &timeout);
-}
-
-int evl_tryget_sem(struct evl_sem *sem)
-{
-	int ret;
-
-	ret = check_sanity(sem);
-	if (ret)
-		return ret;
-
-	return try_get(sem->u.active.state);
-}
-
 static inline bool is_polled(struct evl_monitor_state *state)
 {
 	return !!atomic_read(&state->u.event.pollrefs);
 }
 
-int evl_put_sem(struct evl_sem *sem)
+static int put_sem(struct evl_sem *sem, int count)
 {
 	struct evl_monitor_state *state;
 	int val, prev, next, ret;
-	__s32 sigval = 1;
-
-	ret = check_sanity(sem);
-	if (ret)
-		return ret;
+	__s32 sigval = count;
 
 	state = sem->u.active.state;
 	val = atomic_read(&state->u.event.value);
@@ -254,7 +285,7 @@ int evl_put_sem(struct evl_sem *sem)
 
 	do {
 		prev = val;
-		next = prev + 1;
+		next = prev + count;
 		val = atomic_cmpxchg(&state->u.event.value, prev, next);
 		/*
 		 * If somebody sneaked in the wait queue or started
@@ -274,6 +305,90 @@ int evl_put_sem(struct evl_sem *sem)
 	return 0;
 }
 
+int evl_timedget_sem(struct evl_sem *sem, const struct timespec *timeout)
+{
+	fundle_t current;
+	int ret;
+
+	current = evl_get_current();
+	if (current == EVL_NO_HANDLE)
+		return -EPERM;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	return get_sem(sem, timeout);
+}
+
+int evl_get_sem(struct evl_sem *sem)
+{
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 0 };
+
+	return evl_timedget_sem(sem, &timeout);
+}
+
+int evl_tryget_sem(struct evl_sem *sem)
+{
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	return try_get(sem->u.active.state, 1);
+}
+
+/*
+ * The core hands over a single unit to each waiter and does not
+ * block while any unit is available, so there is no way to sleep
+ * until @count units are: collecting them one at a time would not
+ * be atomic, and could deadlock callers each holding part of what
+ * they need. Only the non-blocking form is available.
+ */
+int evl_tryget_sem_n(struct evl_sem *sem, int count)
+{
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	return try_get(sem->u.active.state, count);
+}
+
+int evl_put_sem(struct evl_sem *sem)
+{
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	return put_sem(sem, 1);
+}
+
+/*
+ * All units are added in a single op, waiters are released by a
+ * single kernel entry if some are pending.
+ */
+int evl_put_sem_n(struct evl_sem *sem, int count)
+{
+	int ret;
+
+	ret = check_sanity(sem);
+	if (ret)
+		return ret;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	return put_sem(sem, count);
+}
+
 int evl_peek_sem(struct evl_sem *sem, int *r_val)
 {
 	if (sem->magic != __SEM_ACTIVE_MAGIC)
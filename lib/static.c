@@ -0,0 +1,112 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <sched.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/clock.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <evl/sem.h>
+#include <evl/flags.h>
+#include <evl/rwlock.h>
+#include <evl/static.h>
+#ifdef __ESHI__
+#include "../eshi/internal.h"
+#else
+#include "internal.h"
+#endif
+
+#define STATIC_BUSY_WAIT_US	50
+
+#ifdef __ESHI__
+/*
+ * The creator may be outranked by the threads waiting for it, make
+ * sure it can make progress.
+ */
+static void wait_static_element(void)
+{
+	evl_usleep(STATIC_BUSY_WAIT_US);
+}
+#else
+/*
+ * Creation happens in-band, the creator may be outranked by the
+ * threads waiting for it. Sleep out-of-band if we can, otherwise
+ * yield the CPU.
+ */
+static void wait_static_element(void)
+{
+	if (evl_usleep(STATIC_BUSY_WAIT_US))
+		sched_yield();
+}
+#endif
+
+/*
+ * Create a statically initialized element on first use. The thread
+ * which switches the magic word from @uninit_magic to the busy value
+ * creates the element, others wait for it to turn to @active_magic.
+ * @init must fill in the active part of the element, leaving the
+ * uninit part intact on error, we publish the result.
+ */
+int init_static_element(void *element,
+			unsigned int uninit_magic,
+			unsigned int active_magic,
+			int (*init)(void *element))
+{
+	unsigned int *magicp = element, magic;
+	int ret;
+
+	for (;;) {
+		magic = atomic_load(magicp);
+		if (magic == active_magic) {
+			smp_mb();
+			return 0;
+		}
+
+		if (magic == uninit_magic) {
+			if (!__sync_bool_compare_and_swap(magicp, magic,
+						__EVL_STATIC_BUSY_MAGIC))
+				continue;
+			ret = init(element);
+			if (ret) {
+				atomic_store(magicp, uninit_magic);
+				return ret;
+			}
+			smp_mb();
+			atomic_store(magicp, active_magic);
+			return 0;
+		}
+
+		if (magic != __EVL_STATIC_BUSY_MAGIC)
+			return -EINVAL;
+
+		wait_static_element();
+	}
+}
+
+int evl_init_static_element(void *element)
+{
+	for (;;) {
+		switch (atomic_load((unsigned int *)element)) {
+		case __MUTEX_UNINIT_MAGIC:
+			return init_static_mutex(element);
+		case __EVENT_UNINIT_MAGIC:
+			return init_static_event(element);
+		case __SEM_UNINIT_MAGIC:
+			return init_static_sem(element);
+		case __FLAGS_UNINIT_MAGIC:
+			return init_static_flags(element);
+		case __RWLOCK_UNINIT_MAGIC:
+			return init_static_rwlock(element);
+		case __EVL_STATIC_BUSY_MAGIC:
+			wait_static_element();
+			break;
+		default:
+			/* Already created. */
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#ifdef __ESHI__
+#include "../eshi/internal.h"
+#else
+#include "internal.h"
+#endif
+
+/*
+ * Create @nr elements of @size bytes each at once, named
+ * <name>.<index> when a name is given. @create builds a single
+ * element, @close drops one on error so that either all of them are
+ * created, or none.
+ */
+int create_element_vec(void *elements, size_t size, int nr,
+		int (*create)(void *element, const char *name,
+			int index, void *arg),
+		int (*close)(void *element),
+		void *arg, const char *fmt, va_list ap)
+{
+	char *name = NULL, *p = elements;
+	int efd, ret, n;
+
+	if (nr <= 0)
+		return -EINVAL;
+
+	if (fmt) {
+		ret = vasprintf(&name, fmt, ap);
+		if (ret < 0)
+			return -ENOMEM;
+	}
+
+	for (n = 0; n < nr; n++) {
+		efd = create(p + n * size, name, n, arg);
+		if (efd < 0) {
+			ret = efd;
+			goto fail;
+		}
+	}
+
+	free(name);
+
+	return 0;
+fail:
+	while (--n >= 0)
+		close(p + n * size);
+
+	free(name);
+
+	return ret;
+}
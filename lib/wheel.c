@@ -0,0 +1,377 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <evl/compiler.h>
+#include <evl/syscall.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/wheel.h>
+
+/*
+ * Level L of the wheel covers 64^(L+1) ticks, each of its slots
+ * spans 64^L ticks. A timer is queued to the lowest level which can
+ * tell its expiry bucket from the current one, in the slot indexed by
+ * that bucket. When the wheel time enters a new bucket at level L >
+ * 0, the timers queued to the matching slot are redistributed to the
+ * lower levels (cascading). Timers beyond the range of the top level
+ * wait in its farthest slot, and get requeued from there.
+ *
+ * The wheel does not step through empty slots: an occupancy bitmap
+ * per level gives the next tick at which some slot has to be
+ * processed, which is also the date we program the EVL timer for.
+ */
+
+#define NO_TICK		((__u64)-1)
+
+#define SLOT_MASK	(EVL_WHEEL_SLOTS - 1)
+
+static inline __u64 timespec_to_ns(const struct timespec *ts)
+{
+	return (__u64)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* Round up, a timer never fires early. */
+static __u64 date_to_tick(struct evl_timer_wheel *wheel,
+			const struct timespec *date)
+{
+	__u64 ns = timespec_to_ns(date);
+
+	if (ns <= wheel->origin)
+		return 0;
+
+	return (ns - wheel->origin + wheel->resolution - 1) /
+		wheel->resolution;
+}
+
+static inline unsigned int level_shift(int level)
+{
+	return level * EVL_WHEEL_SLOT_BITS;
+}
+
+static void enqueue_timer(struct evl_timer_wheel *wheel,
+			struct evl_wheel_timer *timer)
+{
+	__u64 now = wheel->now, bucket;
+	unsigned int shift;
+	int level;
+
+	for (level = 0; level < EVL_WHEEL_LEVELS; level++) {
+		shift = level_shift(level);
+		bucket = timer->expiry >> shift;
+		if (bucket - (now >> shift) < EVL_WHEEL_SLOTS)
+			break;
+	}
+
+	if (level == EVL_WHEEL_LEVELS) {
+		level--;
+		bucket = (now >> level_shift(level)) + EVL_WHEEL_SLOTS - 1;
+	}
+
+	timer->level = level;
+	timer->slot = bucket & SLOT_MASK;
+	list_append(&timer->next, &wheel->slots[level][timer->slot]);
+	wheel->occupied[level] |= 1ULL << timer->slot;
+}
+
+static void dequeue_timer(struct evl_timer_wheel *wheel,
+			struct evl_wheel_timer *timer)
+{
+	list_remove(&timer->next);
+	if (list_empty(&wheel->slots[timer->level][timer->slot]))
+		wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+}
+
+/*
+ * Return the distance in slots from @index to the next occupied one,
+ * from 1 to EVL_WHEEL_SLOTS.
+ */
+static inline int next_slot(__u64 occupied, unsigned int index)
+{
+	unsigned int start = (index + 1) & SLOT_MASK;
+	__u64 rot = occupied;
+
+	if (start)
+		rot = (occupied >> start) |
+			(occupied << (EVL_WHEEL_SLOTS - start));
+
+	return __builtin_ctzll(rot) + 1;
+}
+
+static __u64 next_event(struct evl_timer_wheel *wheel)
+{
+	__u64 tick, next = NO_TICK, bucket;
+	unsigned int shift;
+	int level;
+
+	for (level = 0; level < EVL_WHEEL_LEVELS; level++) {
+		if (!wheel->occupied[level])
+			continue;
+		shift = level_shift(level);
+		bucket = wheel->now >> shift;
+		tick = (bucket + next_slot(wheel->occupied[level],
+						bucket & SLOT_MASK)) << shift;
+		if (tick < next)
+			next = tick;
+	}
+
+	return next;
+}
+
+static int program_timer(struct evl_timer_wheel *wheel, __u64 tick)
+{
+	struct itimerspec its;
+	__u64 ns;
+	int ret;
+
+	ns = wheel->origin + tick * wheel->resolution;
+	its.it_value.tv_sec = ns / 1000000000ULL;
+	its.it_value.tv_nsec = ns % 1000000000ULL;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+
+	ret = evl_set_timer(wheel->fd, &its, NULL);
+	if (ret)
+		return ret;
+
+	wheel->armed = tick;
+
+	return 0;
+}
+
+int evl_init_timer_wheel(struct evl_timer_wheel *wheel,
+			int clockfd, long resolution_ns)
+{
+	struct timespec now;
+	int level, slot, ret;
+
+	if (resolution_ns <= 0)
+		return -EINVAL;
+
+	ret = evl_read_clock(clockfd, &now);
+	if (ret)
+		return ret;
+
+	wheel->fd = evl_new_timer(clockfd);
+	if (wheel->fd < 0)
+		return wheel->fd;
+
+	wheel->clockfd = clockfd;
+	wheel->running = 0;
+	wheel->resolution = resolution_ns;
+	wheel->origin = timespec_to_ns(&now);
+	wheel->now = 0;
+	wheel->armed = NO_TICK;
+
+	for (level = 0; level < EVL_WHEEL_LEVELS; level++) {
+		wheel->occupied[level] = 0;
+		for (slot = 0; slot < EVL_WHEEL_SLOTS; slot++)
+			list_init(&wheel->slots[level][slot]);
+	}
+
+	return wheel->fd;
+}
+
+void evl_init_wheel_timer(struct evl_wheel_timer *timer,
+			evl_wheel_handler_t handler, void *arg)
+{
+	timer->handler = handler;
+	timer->arg = arg;
+	timer->wheel = NULL;
+}
+
+/*
+ * Start @timer for the absolute @date, then every @interval if the
+ * latter is non-NULL and non-zero. Restarts a pending timer. The
+ * date is rounded up to the wheel resolution.
+ */
+int evl_start_wheel_timer(struct evl_timer_wheel *wheel,
+			struct evl_wheel_timer *timer,
+			const struct timespec *date,
+			const struct timespec *interval)
+{
+	__u64 ns = 0;
+
+	if (interval)
+		ns = timespec_to_ns(interval);
+
+	if (timer->wheel)
+		dequeue_timer(timer->wheel, timer);
+
+	timer->expiry = date_to_tick(wheel, date);
+	if (timer->expiry <= wheel->now)
+		timer->expiry = wheel->now + 1;
+
+	timer->interval = (ns + wheel->resolution - 1) / wheel->resolution;
+	timer->wheel = wheel;
+	enqueue_timer(wheel, timer);
+
+	/*
+	 * Only an earlier expiry requires to program the EVL timer,
+	 * which evl_run_timer_wheel() does on its way out anyway.
+	 */
+	if (!wheel->running && timer->expiry < wheel->armed)
+		return program_timer(wheel, timer->expiry);
+
+	return 0;
+}
+
+/*
+ * Stopping a timer leaves the EVL timer alone, at worst we will get
+ * a spurious wake-up.
+ */
+void evl_stop_wheel_timer(struct evl_wheel_timer *timer)
+{
+	if (timer->wheel) {
+		dequeue_timer(timer->wheel, timer);
+		timer->wheel = NULL;
+	}
+}
+
+static void cascade_slot(struct evl_timer_wheel *wheel,
+			int level, unsigned int slot)
+{
+	struct list_head *head = &wheel->slots[level][slot];
+	struct evl_wheel_timer *timer;
+
+	wheel->occupied[level] &= ~(1ULL << slot);
+
+	/* Timers never get requeued to the slot we are emptying. */
+	while (!list_empty(head)) {
+		timer = list_pop_entry(head, struct evl_wheel_timer, next);
+		enqueue_timer(wheel, timer);
+	}
+}
+
+static int fire_slot(struct evl_timer_wheel *wheel, unsigned int slot)
+{
+	struct list_head *head = &wheel->slots[0][slot];
+	struct evl_wheel_timer *timer;
+	__u64 now = wheel->now;
+	int count = 0;
+
+	wheel->occupied[0] &= ~(1ULL << slot);
+
+	/*
+	 * Handlers may start or stop any timer, including the one
+	 * being fired, so we pick them one at a time. Timers started
+	 * from there expire later than now, outside of this slot.
+	 */
+	while (!list_empty(head)) {
+		timer = list_pop_entry(head, struct evl_wheel_timer, next);
+		if (timer->interval) {
+			timer->expiry += ((now - timer->expiry) /
+					timer->interval + 1) * timer->interval;
+			enqueue_timer(wheel, timer);
+		} else {
+			timer->wheel = NULL;
+		}
+		timer->handler(timer);
+		count++;
+	}
+
+	return count;
+}
+
+static int advance_wheel(struct evl_timer_wheel *wheel, __u64 target)
+{
+	unsigned int shift;
+	int level, count = 0;
+	__u64 tick;
+
+	while (wheel->now < target) {
+		tick = next_event(wheel);
+		if (tick > target) {
+			wheel->now = target;
+			break;
+		}
+
+		wheel->now = tick;
+
+		for (level = EVL_WHEEL_LEVELS - 1; level > 0; level--) {
+			shift = level_shift(level);
+			if (tick & ((1ULL << shift) - 1))
+				continue;
+			if (wheel->occupied[level] &
+				(1ULL << ((tick >> shift) & SLOT_MASK)))
+				cascade_slot(wheel, level,
+					(tick >> shift) & SLOT_MASK);
+		}
+
+		if (wheel->occupied[0] & (1ULL << (tick & SLOT_MASK)))
+			count += fire_slot(wheel, tick & SLOT_MASK);
+	}
+
+	return count;
+}
+
+/*
+ * Fire all timers which have expired, then program the EVL timer for
+ * the next expiry. This should be called when the wheel file
+ * descriptor is readable. Returns the number of timers fired.
+ */
+int evl_run_timer_wheel(struct evl_timer_wheel *wheel)
+{
+	struct timespec now;
+	__u64 ns, target, next, ticks;
+	int ret, count;
+
+	ret = evl_read_clock(wheel->clockfd, &now);
+	if (ret)
+		return ret;
+
+	ns = timespec_to_ns(&now);
+	target = ns > wheel->origin ?
+		(ns - wheel->origin) / wheel->resolution : 0;
+
+	/*
+	 * If the EVL timer has elapsed, consume the event so that it
+	 * does not stay readable. Otherwise, we were called early and
+	 * reading would block.
+	 */
+	if (wheel->armed <= target) {
+		ret = oob_read(wheel->fd, &ticks, sizeof(ticks));
+		if (ret < 0)
+			return -errno;
+		wheel->armed = NO_TICK;
+	}
+
+	wheel->running = 1;
+	count = advance_wheel(wheel, target);
+	wheel->running = 0;
+
+	next = next_event(wheel);
+	if (next < wheel->armed) {
+		ret = program_timer(wheel, next);
+		if (ret)
+			return ret;
+	}
+
+	return count;
+}
+
+/* Pending timers are dropped. */
+int evl_close_timer_wheel(struct evl_timer_wheel *wheel)
+{
+	struct evl_wheel_timer *timer;
+	struct list_head *head;
+	int level, slot;
+
+	for (level = 0; level < EVL_WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < EVL_WHEEL_SLOTS; slot++) {
+			head = &wheel->slots[level][slot];
+			while (!list_empty(head)) {
+				timer = list_pop_entry(head,
+					struct evl_wheel_timer, next);
+				timer->wheel = NULL;
+			}
+		}
+		wheel->occupied[level] = 0;
+	}
+
+	return close(wheel->fd);
+}
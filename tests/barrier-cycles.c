@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/barrier.h>
+#include "helpers.h"
+
+#define NR_WORKERS  4
+#define NR_CYCLES   200
+
+static struct evl_barrier bar;
+
+static int arrivals;
+
+static int serials;
+
+static void *worker(void *arg)
+{
+	long n = (long)arg;
+	int tfd, ret, cycle;
+
+	__Tcall_assert(tfd, evl_attach_self("barrier-worker:%d.%ld",
+						getpid(), n));
+
+	for (cycle = 0; cycle < NR_CYCLES; cycle++) {
+		__sync_fetch_and_add(&arrivals, 1);
+		ret = evl_wait_barrier(&bar);
+		__Texpr_assert(ret == 0 || ret == EVL_BARRIER_SERIAL);
+		if (ret == EVL_BARRIER_SERIAL)
+			__sync_fetch_and_add(&serials, 1);
+		/* Nobody may leave before everyone arrived. */
+		__Texpr_assert(__sync_fetch_and_add(&arrivals, 0) >=
+			NR_WORKERS * (cycle + 1));
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t workers[NR_WORKERS];
+	char *name;
+	int ret;
+	long n;
+
+	__Tcall_assert(ret, evl_attach_self("barrier-cycles:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Texpr_assert(evl_new_barrier(&bar, 0, name) == -EINVAL);
+	__Tcall_assert(ret, evl_new_barrier(&bar, NR_WORKERS, name));
+
+	for (n = 0; n < NR_WORKERS; n++)
+		__Texpr_assert(pthread_create(workers + n, NULL,
+						worker, (void *)n) == 0);
+
+	for (n = 0; n < NR_WORKERS; n++)
+		pthread_join(workers[n], NULL);
+
+	__Texpr_assert(serials == NR_CYCLES);
+	__Texpr_assert(arrivals == NR_WORKERS * NR_CYCLES);
+	__Tcall_assert(ret, evl_close_barrier(&bar));
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/compiler.h>
+#include <evl/thread.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <evl/clock.h>
+#include <evl/bcast.h>
+#include "helpers.h"
+
+#define NR_READERS	3
+
+#define LOW_PRIO	1
+#define HIGH_PRIO	2
+
+#define RING_COUNT	16
+#define SEND_COUNT	1024
+
+struct test_item {
+	int seq;
+	int check;
+};
+
+static struct evl_mutex lock;
+
+static struct evl_event event;
+
+static struct evl_bcast bcast;
+
+struct test_context {
+	int serial;
+	int reader;
+};
+
+static void *bcast_reader(void *arg)
+{
+	struct test_context *p = arg;
+	struct test_item item;
+	int ret, tfd, n;
+
+	__Tcall_assert(tfd, evl_attach_self("bcast-reader:%d.%d",
+			getpid(), p->serial));
+
+	/* Every reader must see every item, in order. */
+	for (n = 0; n < SEND_COUNT; n++) {
+		__Tcall_assert(ret, evl_wait_bcast(&bcast, p->reader, &item));
+		__Texpr_assert(item.seq == n);
+		__Texpr_assert(item.check == ~n);
+	}
+
+	__Tcall_assert(ret, evl_get_bcast_backlog(&bcast, p->reader));
+	__Texpr_assert(ret == 0);
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct test_context c[NR_READERS];
+	pthread_t readers[NR_READERS];
+	struct sched_param param;
+	struct test_item item;
+	void *status = NULL;
+	int tfd, mfd, efd, ret, n;
+	size_t size;
+	char *name;
+	void *mem;
+
+	param.sched_priority = HIGH_PRIO;
+	__Texpr_assert(pthread_setschedparam(pthread_self(),
+				SCHED_FIFO, &param) == 0);
+
+	/* EVL inherits the inband scheduling params upon attachment. */
+	__Tcall_assert(tfd, evl_attach_self("bcast-fanout:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(mfd, evl_new_mutex(&lock, name));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 1);
+	__Tcall_assert(efd, evl_new_event(&event, name));
+
+	size = evl_get_bcast_size(sizeof(item), RING_COUNT, NR_READERS);
+	mem = malloc(size);
+	__Texpr_assert(mem != NULL);
+
+	/* Count must be a power of two. */
+	__Fcall_assert(ret, evl_init_bcast(&bcast, mem, size, sizeof(item),
+				RING_COUNT - 1, NR_READERS, &lock, &event));
+	__Texpr_assert(ret == -EINVAL);
+	__Tcall_assert(ret, evl_init_bcast(&bcast, mem, size, sizeof(item),
+				RING_COUNT, NR_READERS, &lock, &event));
+
+	for (n = 0; n < NR_READERS; n++) {
+		__Tcall_assert(c[n].reader, evl_add_bcast_reader(&bcast));
+		c[n].serial = n;
+	}
+
+	/* All reader slots are busy. */
+	__Fcall_assert(ret, evl_add_bcast_reader(&bcast));
+	__Texpr_assert(ret == -EAGAIN);
+
+	for (n = 0; n < NR_READERS; n++)
+		new_thread(readers + n, SCHED_FIFO, LOW_PRIO,
+			bcast_reader, c + n);
+
+	for (n = 0; n < SEND_COUNT; n++) {
+		item.seq = n;
+		item.check = ~n;
+		/* The slowest reader throttles us. */
+		while ((ret = evl_send_bcast(&bcast, &item)) == -EAGAIN)
+			__Tcall_assert(ret, evl_usleep(100));
+		__Texpr_assert(ret == 0);
+	}
+
+	for (n = 0; n < NR_READERS; n++) {
+		__Texpr_assert(pthread_join(readers[n], &status) == 0);
+		__Texpr_assert(status == NULL);
+		__Tcall_assert(ret, evl_del_bcast_reader(&bcast, c[n].reader));
+	}
+
+	/* Deleted readers may not read the ring anymore. */
+	__Fcall_assert(ret, evl_read_bcast(&bcast, c[0].reader, &item));
+	__Texpr_assert(ret == -EINVAL);
+
+	/* No reader left, the producer may run freely. */
+	for (n = 0; n < RING_COUNT * 2; n++)
+		__Tcall_assert(ret, evl_send_bcast(&bcast, &item));
+
+	__Tcall_assert(ret, evl_close_event(&event));
+	__Tcall_assert(ret, evl_close_mutex(&lock));
+	free(mem);
+
+	return 0;
+}
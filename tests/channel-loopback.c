@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/compiler.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/channel.h>
+#include "helpers.h"
+
+#define LOW_PRIO	1
+#define HIGH_PRIO	2
+
+#define NR_BUFFERS	8
+#define SEND_COUNT	1024
+
+struct test_message {
+	int seq;
+	char payload[60];
+};
+
+static char *channel_name;
+
+static void *channel_receiver(void *arg)
+{
+	struct test_message *msg, copy;
+	struct evl_channel peer;
+	int ret, tfd, cfd, n;
+
+	__Tcall_assert(tfd, evl_attach_self("channel-receiver:%d", getpid()));
+	__Tcall_assert(cfd, evl_open_channel(&peer, "%s", channel_name));
+	__Texpr_assert(evl_get_channel_item_size(&peer) == sizeof(*msg));
+
+	/* Zero-copy receive for the first half... */
+	for (n = 0; n < SEND_COUNT / 2; n++) {
+		__Tcall_assert(ret, evl_receive_channel_buffer(&peer, (void **)&msg));
+		__Texpr_assert(msg->seq == n);
+		__Tcall_assert(ret, evl_release_channel_buffer(&peer, msg));
+	}
+
+	/* ...copying for the rest. */
+	for (; n < SEND_COUNT; n++) {
+		__Tcall_assert(ret, evl_receive_channel(&peer, &copy));
+		__Texpr_assert(copy.seq == n);
+	}
+
+	__Tcall_assert(ret, evl_close_channel(&peer));
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sched_param param;
+	struct test_message *msg;
+	struct evl_channel ch;
+	void *status = NULL;
+	pthread_t receiver;
+	int tfd, cfd, ret, n;
+
+	param.sched_priority = HIGH_PRIO;
+	__Texpr_assert(pthread_setschedparam(pthread_self(),
+				SCHED_FIFO, &param) == 0);
+
+	/* EVL inherits the inband scheduling params upon attachment. */
+	__Tcall_assert(tfd, evl_attach_self("channel-loopback:%d", getpid()));
+
+	channel_name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(cfd, evl_create_channel(&ch, sizeof(*msg),
+				NR_BUFFERS, "%s", channel_name));
+
+	new_thread(&receiver, SCHED_FIFO, LOW_PRIO,
+		channel_receiver, NULL);
+
+	for (n = 0; n < SEND_COUNT; n++) {
+		/* Wait for the receiver to give buffers back. */
+		while ((msg = evl_get_channel_buffer(&ch)) == NULL)
+			__Tcall_assert(ret, evl_usleep(100));
+		msg->seq = n;
+		__Tcall_assert(ret, evl_send_channel_buffer(&ch, msg));
+	}
+
+	__Texpr_assert(pthread_join(receiver, &status) == 0);
+	__Texpr_assert(status == NULL);
+	__Tcall_assert(ret, evl_close_channel(&ch));
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/barrier.h>
+
+int main(int argc, char *argv[])
+{
+	struct evl_barrier bar;
+
+	evl_new_barrier(&bar, 2, "dynamic-barrier");
+	evl_create_barrier(&bar, EVL_CLOCK_MONOTONIC, 2, "dynamic-barrier");
+	evl_wait_barrier(&bar);
+	evl_close_barrier(&bar);
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <stdlib.h>
+#include <evl/bcast.h>
+
+int main(int argc, char *argv[])
+{
+	struct evl_mutex lock;
+	struct evl_event event;
+	struct evl_bcast bcast;
+	size_t size;
+	void *mem;
+	long item;
+	int reader;
+
+	size = evl_get_bcast_size(sizeof(item), 16, 4);
+	mem = malloc(size);
+	evl_init_bcast(&bcast, mem, size, sizeof(item), 16, 4, &lock, &event);
+	evl_bind_bcast(&bcast, mem, &lock, &event);
+	reader = evl_add_bcast_reader(&bcast);
+	evl_send_bcast(&bcast, &item);
+	evl_read_bcast(&bcast, reader, &item);
+	evl_wait_bcast(&bcast, reader, &item);
+	evl_get_bcast_backlog(&bcast, reader);
+	evl_del_bcast_reader(&bcast, reader);
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/channel.h>
+
+int main(int argc, char *argv[])
+{
+	struct evl_channel ch, peer;
+	struct timespec timeout;
+	void *buf;
+	long val;
+
+	evl_create_channel(&ch, sizeof(long), 16, "channel:%d", 1);
+	evl_open_channel(&peer, "/channel:%d", 1);
+	buf = evl_get_channel_buffer(&ch);
+	evl_send_channel_buffer(&ch, buf);
+	evl_receive_channel_buffer(&peer, &buf);
+	evl_timedreceive_channel_buffer(&peer, &buf, &timeout);
+	evl_tryreceive_channel_buffer(&peer, &buf);
+	evl_release_channel_buffer(&peer, buf);
+	evl_send_channel(&ch, &val);
+	evl_receive_channel(&peer, &val);
+	evl_timedreceive_channel(&peer, &val, &timeout);
+	evl_get_channel_item_size(&peer);
+	evl_close_channel(&peer);
+	evl_close_channel(&ch);
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/coro.h>
+
+static void body(void *arg)
+{
+	struct evl_sem *sem = (struct evl_sem *)arg;
+	char buf[16];
+
+	evl_yield_coro();
+	evl_coro_poll(0, POLLIN);
+	evl_coro_read(0, buf, sizeof(buf));
+	evl_coro_write(1, buf, sizeof(buf));
+	evl_coro_get_sem(sem);
+	evl_current_coro();
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_coro_sched sched;
+	struct evl_coro coro;
+	struct evl_sem sem;
+
+	evl_init_coro_sched(&sched, 16);
+	evl_spawn_coro(&sched, &coro, body, &sem, EVL_CORO_STACK_SIZE);
+	evl_run_coro_sched(&sched);
+	evl_close_coro_sched(&sched);
+
+	return 0;
+}
@@ -13,6 +13,7 @@ static struct evl_event event =
 int main(int argc, char *argv[])
 {
 	struct evl_event dynevent;
+	struct evl_event evts[4];
 	struct timespec timeout;
 	struct evl_mutex mutex;
 
@@ -21,6 +22,7 @@ int main(int argc, char *argv[])
 	evl_create_event(&dynevent, CLOCK_MONOTONIC, 0, "dynamic-event");
 	evl_open_event(&dynevent, "dynamic-event");
 	evl_close_event(&dynevent);
+	evl_create_event_vec(evts, 4, EVL_CLOCK_MONOTONIC, 0, "event-vec");
 	evl_wait_event(&event, &mutex);
 	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
 	evl_timedwait_event(&event, &mutex, &timeout);
@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/executor.h>
+
+static void run(struct evl_task *task)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_pool_executor exec;
+	struct evl_task_group group;
+	struct evl_task task, tasks[2];
+
+	evl_init_pool_executor(&exec, 0, 1, "executor");
+	evl_init_task_group(&group);
+	evl_submit_task(&exec, &task, run, NULL, &group);
+	tasks[0].fn = tasks[1].fn = run;
+	evl_submit_tasks(&exec, tasks, 2, &group);
+	evl_wait_task_group(&group);
+	evl_close_task_group(&group);
+	evl_close_pool_executor(&exec);
+
+	return 0;
+}
@@ -13,6 +13,7 @@ static struct evl_flags flags =
 int main(int argc, char *argv[])
 {
 	struct evl_flags dynflags;
+	struct evl_flags flgs[4];
 	struct timespec timeout;
 	int bits;
 
@@ -20,12 +21,14 @@ int main(int argc, char *argv[])
 	evl_create_flags(&dynflags, CLOCK_MONOTONIC, 0, 0, "dynamic-flags");
 	evl_open_flags(&dynflags, "dynamic-flags");
 	evl_close_flags(&dynflags);
+	evl_create_flags_vec(flgs, 4, EVL_CLOCK_MONOTONIC, 0, 0, "flags-vec");
 	evl_wait_flags(&flags, &bits);
 	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
 	evl_timedwait_flags(&flags, &timeout, &bits);
 	evl_trywait_flags(&flags, &bits);
 	evl_peek_flags(&flags, &bits);
 	evl_post_flags(&flags, bits);
+	evl_trywait_flags_mask(&flags, 0x3, EVL_FLAGS_ANY, &bits);
 
 	return 0;
 }
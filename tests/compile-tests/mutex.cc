@@ -6,6 +6,7 @@
 
 #include <evl/clock.h>
 #include <evl/mutex.h>
+#include <evl/lockstat.h>
 
 static struct evl_mutex mutex =
 	EVL_MUTEX_INITIALIZER("static-mutex",
@@ -15,6 +16,8 @@ static struct evl_mutex mutex =
 int main(int argc, char *argv[])
 {
 	struct evl_mutex dynmutex;
+	struct evl_mutex mutexes[4];
+	struct evl_lockstat stat;
 	struct timespec timeout;
 
 	evl_new_mutex(&dynmutex, "dynamic-mutex");
@@ -22,6 +25,8 @@ int main(int argc, char *argv[])
 			  EVL_MUTEX_NORMAL, "dynamic-mutex");
 	evl_open_mutex(&dynmutex, "dynamic-mutex");
 	evl_close_mutex(&dynmutex);
+	evl_create_mutex_vec(mutexes, 4, EVL_CLOCK_MONOTONIC, 0,
+			EVL_MUTEX_NORMAL, "mutex-vec");
 	evl_lock_mutex(&dynmutex);
 	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
 	evl_timedlock_mutex(&dynmutex, &timeout);
@@ -29,6 +34,12 @@ int main(int argc, char *argv[])
 	evl_unlock_mutex(&mutex);
 	evl_set_mutex_ceiling(&mutex, 0);
 	evl_get_mutex_ceiling(&mutex);
+	evl_create_mutex(&dynmutex, CLOCK_MONOTONIC, 0,
+			  EVL_MUTEX_ADAPTIVE, "adaptive-mutex");
+	evl_set_mutex_spin(&dynmutex, EVL_MUTEX_SPIN_NS);
+	evl_create_mutex(&dynmutex, CLOCK_MONOTONIC, 0,
+			  EVL_MUTEX_LOCKSTAT, "lockstat-mutex");
+	evl_get_mutex_lockstat(&dynmutex, &stat);
 
 	return 0;
 }
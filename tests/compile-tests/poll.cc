@@ -9,14 +9,20 @@
 
 int main(int argc, char *argv[])
 {
+	struct evl_poll_ctlreq vec[1];
 	struct evl_poll_event pollset;
 	struct timespec timeout;
-	int efd;
+	int efd, status[1];
 
 	efd = evl_new_poll();
 	evl_add_pollfd(efd, 1, POLLIN, evl_nil);
 	evl_del_pollfd(efd, 1);
 	evl_mod_pollfd(efd, 1, POLLOUT, evl_nil);
+	vec[0].action = EVL_POLL_CTLADD;
+	vec[0].fd = 1;
+	vec[0].events = POLLIN;
+	vec[0].pollval = evl_nil;
+	evl_ctl_pollfds(efd, vec, 1, status);
 	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
 	evl_poll(efd, &pollset, 1);
 	evl_timedpoll(efd, &pollset, 1, &timeout);
@@ -0,0 +1,23 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/pool.h>
+
+int main(int argc, char *argv[])
+{
+	struct evl_element_pool pool;
+	struct evl_sem *sem;
+
+	evl_init_element_pool(&pool, EVL_POOL_SEM, 16, 4, 2,
+			EVL_CLOCK_MONOTONIC, 0);
+	sem = (struct evl_sem *)evl_get_pool_element(&pool);
+	evl_put_pool_element(&pool, sem);
+	evl_get_pool_free(&pool);
+	evl_destroy_element_pool(&pool);
+
+	return 0;
+}
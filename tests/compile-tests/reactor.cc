@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/reactor.h>
+
+static void handler(struct evl_reactor_source *src, unsigned int revents)
+{
+}
+
+static void deferred(struct evl_reactor_call *call)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_reactor_source src, timer;
+	struct evl_reactor_call call;
+	struct evl_reactor reactor;
+	struct timespec date = { 0, 0 };
+
+	evl_init_reactor(&reactor, 16);
+	evl_add_reactor_fd(&reactor, &src, 0, POLLIN, 1, handler, NULL);
+	evl_add_reactor_timer(&reactor, &timer, EVL_CLOCK_MONOTONIC,
+			&date, &date, 2, handler, NULL);
+	evl_defer_reactor_call(&reactor, &call, deferred, NULL);
+	evl_run_reactor(&reactor, &date);
+	evl_loop_reactor(&reactor);
+	evl_stop_reactor(&reactor);
+	evl_del_reactor_source(&src);
+	evl_close_reactor(&reactor);
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/rwlock.h>
+
+static struct evl_rwlock rwlock =
+	EVL_RWLOCK_INITIALIZER("static-rwlock", EVL_CLOCK_MONOTONIC, 0);
+
+int main(int argc, char *argv[])
+{
+	struct evl_rwlock dynrwlock;
+	struct timespec timeout;
+
+	evl_new_rwlock(&dynrwlock, "dynamic-rwlock");
+	evl_create_rwlock(&dynrwlock, EVL_CLOCK_MONOTONIC, 0,
+			"dynamic-rwlock");
+	evl_close_rwlock(&dynrwlock);
+	evl_rdlock_rwlock(&rwlock);
+	evl_tryrdlock_rwlock(&rwlock);
+	evl_wrlock_rwlock(&rwlock);
+	evl_trywrlock_rwlock(&rwlock);
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
+	evl_timedrdlock_rwlock(&rwlock, &timeout);
+	evl_timedwrlock_rwlock(&rwlock, &timeout);
+	evl_unlock_rwlock(&rwlock);
+
+	return 0;
+}
@@ -14,18 +14,22 @@ int main(int argc, char *argv[])
 {
 	struct timespec timeout;
 	struct evl_sem dynsem;
+	struct evl_sem sems[4];
 	int val;
 
 	evl_new_sem(&dynsem, "dynamic-sem");
 	evl_create_sem(&dynsem, CLOCK_MONOTONIC, 0, 0, "dynamic-sem");
 	evl_open_sem(&dynsem, "dynamic-sem");
 	evl_close_sem(&dynsem);
+	evl_create_sem_vec(sems, 4, EVL_CLOCK_MONOTONIC, 0, 0, "sem-vec");
 	evl_get_sem(&sem);
 	evl_read_clock(EVL_CLOCK_MONOTONIC, &timeout);
 	evl_timedget_sem(&sem, &timeout);
 	evl_tryget_sem(&sem);
 	evl_peek_sem(&sem, &val);
 	evl_put_sem(&sem);
+	evl_put_sem_n(&sem, 2);
+	evl_tryget_sem_n(&sem, 2);
 
 	return 0;
 }
@@ -0,0 +1,21 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/sem.h>
+#include <evl/static.h>
+
+static struct evl_sem sem =
+	EVL_SEM_INITIALIZER("static-sem", EVL_CLOCK_MONOTONIC, 0, 0);
+EVL_STATIC_ELEMENT(sem);
+
+int main(int argc, char *argv[])
+{
+	evl_init_static_elements();
+	evl_init_static_element(&sem);
+
+	return 0;
+}
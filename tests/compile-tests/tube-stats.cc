@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#define EVL_TUBE_STATS
+#include <evl/tube.h>
+
+DECLARE_EVL_CANISTER(long_canister, long);
+static DECLARE_EVL_TUBE(tube_type, long_canister) tube;
+static struct long_canister long_items[16];
+
+DECLARE_EVL_CANISTER_REL(int_canister, int);
+DECLARE_EVL_TUBE_PRIO_REL(prio_rel_tube_type, int_canister, int, 4);
+
+int main(int argc, char *argv[])
+{
+	int count = sizeof(long_items) / sizeof(long_items[0]);
+	struct prio_rel_tube_type *tube_rel;
+	struct evl_tube_stats stats;
+	size_t size;
+	long val;
+	void *mem;
+	int ival = 0;
+
+	evl_init_tube(&tube, long_items, count);
+	evl_send_tube(&tube, 0);
+	evl_receive_tube(&tube, val);
+	evl_get_tube_stats(&tube, &stats);
+	(void)val;
+
+	size = evl_get_tube_prio_size_rel(prio_rel_tube_type, 100);
+	mem = malloc(size);
+	tube_rel = (struct prio_rel_tube_type *)
+		evl_init_tube_prio_rel(prio_rel_tube_type, int_canister, mem, size);
+	evl_send_tube_prio_rel(tube_rel, 0, 3);
+	evl_receive_tube_prio_rel(tube_rel, ival);
+	evl_get_tube_stats(tube_rel, &stats);
+
+	return ival;
+}
@@ -43,10 +43,65 @@ static int build_test_tube_rel(void)
 	return val;
 }
 
+static DECLARE_EVL_TUBE_PRIO(prio_tube_type, long_canister, 4) prio_tube;
+
+static int build_test_tube_heap(void)
+{
+	static char heap_mem[EVL_HEAP_RAW_SIZE(4096)];
+	struct tube_type *heap_tube;
+	struct evl_heap heap;
+	long val = 0;
+	int ret;
+
+	evl_init_heap(&heap, heap_mem, sizeof(heap_mem));
+	heap_tube = evl_create_tube(tube_type, &heap, 16);
+	evl_send_tube(heap_tube, 0);
+	ret = evl_resize_tube(heap_tube, &heap, 32);
+	evl_receive_tube(heap_tube, val);
+	ret = evl_resize_tube(heap_tube, &heap, 8);
+	evl_destroy_tube(heap_tube, &heap);
+
+	return ret + val;
+}
+
+static long build_test_tube_prio(void)
+{
+	int count = sizeof(long_items) / sizeof(long_items[0]);
+	long val = 0;
+
+	evl_init_tube_prio(&prio_tube, long_items, count);
+	evl_send_tube_prio(&prio_tube, 0, 3);
+	evl_receive_tube_prio(&prio_tube, val);
+
+	return val + (long)evl_get_tube_prio_size(prio_tube_type, count);
+}
+
+DECLARE_EVL_TUBE_PRIO_REL(prio_rel_tube_type, int_canister, int, 8);
+
+static int build_test_tube_prio_rel(void)
+{
+	struct prio_rel_tube_type *tube_rel;
+	size_t size;
+	void *mem;
+	int val = 0;
+
+	size = evl_get_tube_prio_size_rel(prio_rel_tube_type, 100);
+	mem = malloc(size);
+	tube_rel = (struct prio_rel_tube_type *)
+		evl_init_tube_prio_rel(prio_rel_tube_type, int_canister, mem, size);
+	evl_send_tube_prio_rel(tube_rel, 0, 7);
+	evl_receive_tube_prio_rel(tube_rel, val);
+
+	return val;
+}
+
 int main(int argc, char *argv[])
 {
 	build_test_tube();
 	build_test_tube_rel();
+	build_test_tube_heap();
+	build_test_tube_prio();
+	build_test_tube_prio_rel();
 
 	return 0;
 }
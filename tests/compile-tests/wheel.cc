@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * COMPILE-TESTING ONLY.
+ */
+
+#include <evl/clock.h>
+#include <evl/wheel.h>
+
+static void handler(struct evl_wheel_timer *timer)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_timer_wheel wheel;
+	struct evl_wheel_timer timer;
+	struct timespec date = { 0, 0 };
+
+	evl_init_timer_wheel(&wheel, EVL_CLOCK_MONOTONIC, 1000000);
+	evl_init_wheel_timer(&timer, handler, NULL);
+	evl_start_wheel_timer(&wheel, &timer, &date, NULL);
+	evl_wheel_timer_pending(&timer);
+	evl_stop_wheel_timer(&timer);
+	evl_run_timer_wheel(&wheel);
+	evl_close_timer_wheel(&wheel);
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Run many coroutines on a single EVL thread: ping-pong over
+ * semaphores, yield in round-robin, and wait for data written by
+ * another thread to non-blocking xbufs.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <evl/thread.h>
+#include <evl/sem.h>
+#include <evl/xbuf.h>
+#include <evl/coro.h>
+#include "helpers.h"
+
+#define NR_ROUNDS     1000
+#define NR_YIELDERS   200
+#define NR_YIELDS     20
+#define NR_READERS    8
+
+static struct evl_coro_sched sched;
+
+static struct evl_sem ping, pong;
+
+static struct evl_coro pinger, ponger;
+
+static struct evl_coro yielders[NR_YIELDERS];
+
+static int yield_trace[NR_YIELDERS], yield_clock;
+
+static struct evl_coro readers[NR_READERS];
+
+static int xfds[NR_READERS], nr_received;
+
+static void do_ping(void *arg)
+{
+	int n, ret;
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		__Tcall_assert(ret, evl_put_sem(&ping));
+		__Tcall_assert(ret, evl_coro_get_sem(&pong));
+	}
+}
+
+static void do_pong(void *arg)
+{
+	int n, ret;
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		__Tcall_assert(ret, evl_coro_get_sem(&ping));
+		__Tcall_assert(ret, evl_put_sem(&pong));
+	}
+}
+
+static void do_yield(void *arg)
+{
+	long me = (long)arg;
+	int n;
+
+	__Texpr_assert(evl_current_coro() == &yielders[me]);
+
+	/* Round-robin: everyone runs once per cycle. */
+	for (n = 0; n < NR_YIELDS; n++) {
+		__Texpr_assert(yield_trace[me] == n);
+		__Texpr_assert(yield_clock == n * NR_YIELDERS + me);
+		yield_trace[me]++;
+		yield_clock++;
+		evl_yield_coro();
+	}
+}
+
+static void do_read(void *arg)
+{
+	long me = (long)arg;
+	ssize_t ret;
+	long val;
+
+	ret = evl_coro_read(xfds[me], &val, sizeof(val));
+	__Texpr_assert(ret == sizeof(val));
+	__Texpr_assert(val == me);
+	nr_received++;
+}
+
+static void *writer(void *arg)
+{
+	ssize_t ret;
+	long n;
+
+	/* Let the readers park first. */
+	usleep(10000);
+
+	for (n = NR_READERS - 1; n >= 0; n--) {
+		ret = write(xfds[n], &n, sizeof(n));
+		__Texpr_assert(ret == sizeof(n));
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t tid;
+	int tfd, ret;
+	char *name;
+	long n;
+
+	__Tcall_assert(tfd, evl_attach_self("coro-sessions:%d", getpid()));
+
+	__Texpr_assert(evl_coro_poll(0, POLLIN) == -EPERM);
+	__Texpr_assert(evl_init_coro_sched(&sched, 0) == -EINVAL);
+	__Tcall_assert(ret, evl_init_coro_sched(&sched, 16));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(ret, evl_new_sem(&ping, name));
+	name = get_unique_name(EVL_MONITOR_DEV, 1);
+	__Tcall_assert(ret, evl_new_sem(&pong, name));
+
+	__Tcall_assert(ret, evl_spawn_coro(&sched, &ponger, do_pong, NULL, 0));
+	__Tcall_assert(ret, evl_spawn_coro(&sched, &pinger, do_ping, NULL, 0));
+	__Tcall_assert(ret, evl_run_coro_sched(&sched));
+
+	for (n = 0; n < NR_YIELDERS; n++)
+		__Tcall_assert(ret, evl_spawn_coro(&sched, yielders + n,
+						do_yield, (void *)n, 16384));
+	__Tcall_assert(ret, evl_run_coro_sched(&sched));
+	__Texpr_assert(yield_clock == NR_YIELDERS * NR_YIELDS);
+
+	for (n = 0; n < NR_READERS; n++) {
+		name = get_unique_name(EVL_XBUF_DEV, n);
+		__Tcall_assert(xfds[n], evl_create_xbuf(1024, 1024,
+				EVL_CLONE_PRIVATE|EVL_CLONE_NONBLOCK, name));
+		__Tcall_assert(ret, evl_spawn_coro(&sched, readers + n,
+						do_read, (void *)n, 0));
+	}
+
+	new_thread(&tid, SCHED_OTHER, 0, writer, NULL);
+	__Tcall_assert(ret, evl_run_coro_sched(&sched));
+	pthread_join(tid, NULL);
+	__Texpr_assert(nr_received == NR_READERS);
+
+	for (n = 0; n < NR_READERS; n++)
+		close(xfds[n]);
+
+	__Tcall_assert(ret, evl_close_coro_sched(&sched));
+	__Tcall_assert(ret, evl_close_sem(&pong));
+	__Tcall_assert(ret, evl_close_sem(&ping));
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/sem.h>
+#include <evl/pool.h>
+#include "helpers.h"
+
+#define POOL_CAPACITY  32
+#define POOL_PREFILL   4
+#define POOL_LOWMARK   2
+
+static struct evl_sem *sems[POOL_CAPACITY];
+
+int main(int argc, char *argv[])
+{
+	struct evl_element_pool pool;
+	int tfd, ret, n, tries;
+	struct evl_sem *sem;
+
+	__Tcall_assert(tfd, evl_attach_self("element-pool:%d", getpid()));
+
+	__Texpr_assert(evl_init_element_pool(&pool, EVL_POOL_SEM, 0, 0, 0,
+				EVL_CLOCK_MONOTONIC, 0) == -EINVAL);
+	__Tcall_assert(ret, evl_init_element_pool(&pool, EVL_POOL_SEM,
+				POOL_CAPACITY, POOL_PREFILL, POOL_LOWMARK,
+				EVL_CLOCK_MONOTONIC, 0));
+	__Texpr_assert(evl_get_pool_free(&pool) == POOL_PREFILL);
+
+	/* Drain the prefilled elements, the refiller must catch up. */
+	for (n = 0; n < POOL_PREFILL; n++) {
+		sems[n] = evl_get_pool_element(&pool);
+		__Texpr_assert(sems[n] != NULL);
+	}
+
+	for (tries = 0; tries < 100; tries++) {
+		if (evl_get_pool_free(&pool) >= POOL_LOWMARK)
+			break;
+		evl_usleep(10000);
+	}
+	__Texpr_assert(evl_get_pool_free(&pool) >= POOL_LOWMARK);
+
+	/* Checked in units must not leak to the next user. */
+	sem = evl_get_pool_element(&pool);
+	__Texpr_assert(sem != NULL);
+	__Tcall_assert(ret, evl_put_sem(sem));
+	__Tcall_assert(ret, evl_put_pool_element(&pool, sem));
+	__Texpr_assert(evl_get_pool_element(&pool) == sem);
+	__Texpr_assert(evl_tryget_sem(sem) == -EAGAIN);
+	__Tcall_assert(ret, evl_put_pool_element(&pool, sem));
+
+	__Texpr_assert(evl_put_pool_element(&pool, &pool) == -EINVAL);
+
+	for (n = 0; n < POOL_PREFILL; n++)
+		__Tcall_assert(ret, evl_put_pool_element(&pool, sems[n]));
+
+	__Tcall_assert(ret, evl_destroy_element_pool(&pool));
+
+	return 0;
+}
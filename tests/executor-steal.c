@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Run batches of tasks on a pool executor, with tasks spawning
+ * subtasks which idle workers have to steal.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <evl/thread.h>
+#include <evl/executor.h>
+#include "helpers.h"
+
+#define NR_WORKERS   4
+#define NR_BATCH     512
+#define NR_CHILDREN  16
+#define NR_ROUNDS    20
+
+static struct evl_pool_executor exec;
+
+static struct evl_task_group *group;
+
+static struct evl_task tasks[NR_BATCH];
+
+static struct evl_task children[NR_BATCH][NR_CHILDREN];
+
+static int counts[NR_BATCH];
+
+static void run_child(struct evl_task *task)
+{
+	__sync_fetch_and_add((int *)task->arg, 1);
+}
+
+static void run_parent(struct evl_task *task)
+{
+	long n = (long)task->arg;
+	int k, ret;
+
+	/* Spread the work from within a worker. */
+	if (n % 2) {
+		for (k = 0; k < NR_CHILDREN; k++)
+			__Tcall_assert(ret, evl_submit_task(&exec,
+					&children[n][k], run_child,
+					counts + n, group));
+	} else {
+		for (k = 0; k < NR_CHILDREN; k++) {
+			children[n][k].fn = run_child;
+			children[n][k].arg = counts + n;
+		}
+		__Tcall_assert(ret, evl_submit_tasks(&exec, children[n],
+						NR_CHILDREN, group));
+	}
+}
+
+static struct evl_task_group *new_group(void)
+{
+	struct evl_task_group *g;
+	int ret;
+
+	g = malloc(sizeof(*g));
+	__Texpr_assert(g != NULL);
+	__Tcall_assert(ret, evl_init_task_group(g));
+
+	return g;
+}
+
+static void drop_group(struct evl_task_group *g)
+{
+	int ret;
+
+	__Tcall_assert(ret, evl_close_task_group(g));
+	memset(g, 0xa5, sizeof(*g));
+	free(g);
+}
+
+int main(int argc, char *argv[])
+{
+	int ret, round;
+	long n;
+
+	__Texpr_assert(evl_init_pool_executor(&exec, -1, 0, "x") == -EINVAL);
+	__Tcall_assert(ret, evl_init_pool_executor(&exec, NR_WORKERS, 0,
+					get_unique_name(EVL_THREAD_DEV, 0)));
+	/*
+	 * Every group is dropped as soon as its last wait returns,
+	 * while the workers keep running.
+	 */
+	for (round = 0; round < NR_ROUNDS; round++) {
+		group = new_group();
+		for (n = 0; n < NR_BATCH; n++) {
+			counts[n] = 0;
+			tasks[n].fn = run_parent;
+			tasks[n].arg = (void *)n;
+		}
+		__Tcall_assert(ret, evl_submit_tasks(&exec, tasks,
+						NR_BATCH, group));
+		__Tcall_assert(ret, evl_wait_task_group(group));
+		drop_group(group);
+		for (n = 0; n < NR_BATCH; n++)
+			__Texpr_assert(counts[n] == NR_CHILDREN);
+	}
+
+	/* Single submissions from a non-worker thread. */
+	group = new_group();
+	for (n = 0; n < NR_BATCH; n++) {
+		counts[n] = 0;
+		__Tcall_assert(ret, evl_submit_task(&exec, tasks + n,
+					run_child, counts + n, group));
+	}
+	__Tcall_assert(ret, evl_wait_task_group(group));
+	drop_group(group);
+	for (n = 0; n < NR_BATCH; n++)
+		__Texpr_assert(counts[n] == 1);
+
+	__Tcall_assert(ret, evl_close_pool_executor(&exec));
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <evl/compiler.h>
+#include <evl/thread.h>
+#include <evl/flags.h>
+#include <evl/clock.h>
+#include <evl/poll.h>
+#include "helpers.h"
+
+static struct evl_flags flags;
+
+int main(int argc, char *argv[])
+{
+	struct evl_poll_event pollset;
+	struct timespec now, timeout;
+	int tfd, ffd, pfd, ret, bits;
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("flags-mask:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(ffd, evl_new_flags(&flags, name));
+
+	__Texpr_assert(evl_trywait_flags_mask(&flags, 0,
+					EVL_FLAGS_ANY, &bits) == -EINVAL);
+	__Texpr_assert(evl_trywait_flags_mask(&flags, 0x1,
+					0, &bits) == -EINVAL);
+
+	/* Only the bits matching the mask are consumed. */
+	__Tcall_assert(ret, evl_post_flags(&flags, 0x5));
+	__Tcall_assert(ret, evl_trywait_flags_mask(&flags, 0x1,
+						EVL_FLAGS_ANY, &bits));
+	__Texpr_assert(bits == 0x1);
+	__Texpr_assert(evl_trywait_flags_mask(&flags, 0x6,
+					EVL_FLAGS_ALL, &bits) == -EAGAIN);
+	__Tcall_assert(ret, evl_trywait_flags_mask(&flags, 0x6,
+						EVL_FLAGS_ANY, &bits));
+	__Texpr_assert(bits == 0x4);
+	__Texpr_assert(evl_trywait_flags_mask(&flags, ~0,
+					EVL_FLAGS_ANY, &bits) == -EAGAIN);
+
+	/*
+	 * Same with the group being polled: readiness follows the
+	 * bits left pending.
+	 */
+	__Tcall_assert(pfd, evl_new_poll());
+	__Tcall_assert(ret, evl_add_pollfd(pfd, ffd, POLLIN, evl_nil));
+	__Tcall_assert(ret, evl_post_flags(&flags, 0x16));
+	__Tcall_assert(ret, evl_poll(pfd, &pollset, 1));
+	__Texpr_assert(ret == 1);
+	__Tcall_assert(ret, evl_trywait_flags_mask(&flags, 0x6,
+						EVL_FLAGS_ALL, &bits));
+	__Texpr_assert(bits == 0x6);
+	__Tcall_assert(ret, evl_poll(pfd, &pollset, 1));
+	__Texpr_assert(ret == 1);
+	__Tcall_assert(ret, evl_trywait_flags(&flags, &bits));
+	__Texpr_assert(bits == 0x10);
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 10000000); /* 10ms */
+	__Texpr_assert(evl_timedpoll(pfd, &pollset, 1, &timeout) == -ETIMEDOUT);
+	close(pfd);
+
+	evl_close_flags(&flags);
+
+	return 0;
+}
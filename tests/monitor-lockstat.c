@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/mutex.h>
+#include <evl/lockstat.h>
+#include <evl/clock.h>
+#include "helpers.h"
+
+#define NR_LOCKS  100
+
+static struct evl_mutex lock;
+
+static void *contender(void *arg)
+{
+	int tfd;
+
+	__Tcall_assert(tfd, evl_attach_self("lockstat-contender:%d",
+						getpid()));
+	__Texpr_assert(evl_trylock_mutex(&lock) == -EBUSY);
+
+	return NULL;
+}
+
+static __u64 sum_hist(const __u64 *hist)
+{
+	__u64 sum = 0;
+	int n;
+
+	for (n = 0; n < EVL_LOCKSTAT_HIST_SIZE; n++)
+		sum += hist[n];
+
+	return sum;
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_lockstat stat;
+	pthread_t tid;
+	int tfd, ret, n;
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("monitor-lockstat:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(ret, evl_create_mutex(&lock, EVL_CLOCK_MONOTONIC, 0,
+				EVL_MUTEX_RECURSIVE|EVL_MUTEX_LOCKSTAT, name));
+
+	for (n = 0; n < NR_LOCKS; n++) {
+		__Tcall_assert(ret, evl_lock_mutex(&lock));
+		__Tcall_assert(ret, evl_unlock_mutex(&lock));
+	}
+
+	__Tcall_assert(ret, evl_lock_mutex(&lock));
+	__Tcall_assert(ret, evl_lock_mutex(&lock));
+	new_thread(&tid, SCHED_FIFO, 1, contender, NULL);
+	pthread_join(tid, NULL);
+	__Tcall_assert(ret, evl_unlock_mutex(&lock));
+	__Tcall_assert(ret, evl_unlock_mutex(&lock));
+
+	__Tcall_assert(ret, evl_get_mutex_lockstat(&lock, &stat));
+	__Texpr_assert(stat.fast + stat.slow == NR_LOCKS + 1);
+	__Texpr_assert(stat.recursive == 1);
+	__Texpr_assert(stat.trylock_failed == 1);
+	__Texpr_assert(sum_hist(stat.hold_hist) == NR_LOCKS + 1);
+
+	__Tcall_assert(ret, evl_close_mutex(&lock));
+	__Texpr_assert(evl_get_mutex_lockstat(&lock, &stat) == -EINVAL);
+
+	return 0;
+}
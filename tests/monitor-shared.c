@@ -0,0 +1,105 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Share public monitor elements between a parent process and its
+ * child, which opens them by name.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/mutex.h>
+#include <evl/event.h>
+#include <evl/flags.h>
+#include <evl/sem.h>
+#include <evl/clock.h>
+#include "helpers.h"
+
+struct test_context {
+	struct evl_mutex mutex;
+	struct evl_event event;
+	struct evl_flags flags;
+	struct evl_sem sem;
+};
+
+static void run_child(char *names[])
+{
+	struct test_context c;
+	int tfd, ret;
+
+	__Tcall_assert(tfd, evl_attach_self("monitor-shared-child:%d", getpid()));
+	__Tcall_assert(ret, evl_open_mutex(&c.mutex, "%s", names[0]));
+	__Tcall_assert(ret, evl_open_event(&c.event, "%s", names[1]));
+	__Tcall_assert(ret, evl_open_flags(&c.flags, "%s", names[2]));
+	__Tcall_assert(ret, evl_open_sem(&c.sem, "%s", names[3]));
+
+	/* Wait for the parent to hold the lock, then wake it up. */
+	__Tcall_assert(ret, evl_get_sem(&c.sem));
+	__Tcall_assert(ret, evl_lock_mutex(&c.mutex));
+	__Tcall_assert(ret, evl_signal_event(&c.event));
+	__Tcall_assert(ret, evl_unlock_mutex(&c.mutex));
+
+	__Tcall_assert(ret, evl_post_flags(&c.flags, 0x5));
+
+	__Tcall_assert(ret, evl_close_sem(&c.sem));
+	__Tcall_assert(ret, evl_close_flags(&c.flags));
+	__Tcall_assert(ret, evl_close_event(&c.event));
+	__Tcall_assert(ret, evl_close_mutex(&c.mutex));
+
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec now, timeout;
+	struct test_context c;
+	struct evl_sem dup;
+	char *names[4];
+	int tfd, ret, n, bits, status;
+	pid_t pid;
+
+	for (n = 0; n < 4; n++)
+		names[n] = get_unique_name_and_path(EVL_MONITOR_DEV, n, NULL);
+
+	__Tcall_assert(tfd, evl_attach_self("monitor-shared:%d", getpid()));
+	__Tcall_assert(ret, evl_new_mutex(&c.mutex, "/%s", names[0]));
+	__Tcall_assert(ret, evl_new_event(&c.event, "/%s", names[1]));
+	__Tcall_assert(ret, evl_new_flags(&c.flags, "/%s", names[2]));
+	__Tcall_assert(ret, evl_new_sem(&c.sem, "/%s", names[3]));
+
+	__Fcall_assert(ret, evl_new_sem(&dup, "/%s", names[3]));
+	__Texpr_assert(ret == -EEXIST);
+
+	__Fcall_assert(ret, evl_open_sem(&dup, "%s.nonexistent", names[3]));
+	__Texpr_assert(ret == -ENOENT);
+
+	pid = fork();
+	__Texpr_assert(pid >= 0);
+	if (pid == 0)
+		run_child(names);
+
+	__Tcall_assert(ret, evl_lock_mutex(&c.mutex));
+	__Tcall_assert(ret, evl_put_sem(&c.sem));
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 2000000000); /* 2s */
+	__Tcall_assert(ret, evl_timedwait_event(&c.event, &c.mutex, &timeout));
+	__Tcall_assert(ret, evl_unlock_mutex(&c.mutex));
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 2000000000); /* 2s */
+	__Tcall_assert(ret, evl_timedwait_flags(&c.flags, &timeout, &bits));
+	__Texpr_assert(bits == 0x5);
+
+	__Texpr_assert(waitpid(pid, &status, 0) == pid);
+	__Texpr_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	__Tcall_assert(ret, evl_close_sem(&c.sem));
+	__Tcall_assert(ret, evl_close_flags(&c.flags));
+	__Tcall_assert(ret, evl_close_event(&c.event));
+	__Tcall_assert(ret, evl_close_mutex(&c.mutex));
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that a closed observable is released, and that its file
+ * descriptor cannot be used as an observable anymore once recycled.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <evl/thread.h>
+#include <evl/observable.h>
+#include "helpers.h"
+
+static int count_fds(void)
+{
+	struct dirent *de;
+	int count = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/fd");
+	if (dir == NULL)
+		return -errno;
+
+	while ((de = readdir(dir)) != NULL)
+		if (de->d_name[0] != '.')
+			count++;
+
+	closedir(dir);
+
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_notice next;
+	int tfd, ofd, fd, nfds;
+	ssize_t ret;
+
+	__Tcall_assert(tfd, evl_attach_self("observable-closed:%d", getpid()));
+	__Tcall_assert(nfds, count_fds());
+
+	next.tag = EVL_NOTICE_USER;
+	next.event.lval = 1ULL;
+
+	/* Creating a new observable releases the closed ones. */
+	__Tcall_assert(ofd, evl_new_observable("observable-closed.0:%d", getpid()));
+	__Tcall_errno_assert(ret, close(ofd));
+	__Tcall_assert(ofd, evl_new_observable("observable-closed.1:%d", getpid()));
+	__Tcall_assert(ret, evl_subscribe(ofd, 4, 0));
+	__Tcall_assert(ret, evl_update_observable(ofd, &next, 1));
+	__Texpr_assert(ret == 1);
+	__Tcall_assert(ret, evl_unsubscribe(ofd));
+	__Tcall_errno_assert(ret, close(ofd));
+
+	/* The descriptor now refers to a different file. */
+	__Tcall_errno_assert(fd, open("/dev/null", O_RDONLY));
+	__Texpr_assert(fd == ofd);
+	__Fcall_assert(ret, evl_update_observable(fd, &next, 1));
+#ifdef __ESHI__
+	__Texpr_assert(ret == -EBADF);
+#endif
+	__Fcall_assert(ret, evl_subscribe(fd, 4, 0));
+	__Tcall_errno_assert(ret, close(fd));
+
+	/* Nothing should be left behind. */
+	__Texpr_assert(count_fds() == nfds);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Update a poll set with vectors of requests.
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/sem.h>
+#include <evl/clock.h>
+#include <evl/poll.h>
+#include "helpers.h"
+
+#define NR_SEMS  64
+
+static struct evl_sem sems[NR_SEMS];
+
+static int sfds[NR_SEMS];
+
+static int wait_events(int pfd, struct evl_poll_event *pollset, int nr)
+{
+	struct timespec now, timeout;
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 100000000); /* 100ms */
+
+	return evl_timedpoll(pfd, pollset, nr, &timeout);
+}
+
+int main(int argc, char *argv[])
+{
+	struct evl_poll_ctlreq vec[NR_SEMS + 2];
+	struct evl_poll_event pollset[NR_SEMS];
+	int tfd, pfd, ret, n, status[NR_SEMS + 2];
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("poll-ctlv:%d", getpid()));
+	__Tcall_assert(pfd, evl_new_poll());
+
+	for (n = 0; n < NR_SEMS; n++) {
+		name = get_unique_name(EVL_MONITOR_DEV, n);
+		__Tcall_assert(sfds[n], evl_new_sem(sems + n, name));
+		vec[n].action = EVL_POLL_CTLADD;
+		vec[n].fd = sfds[n];
+		vec[n].events = POLLIN;
+		vec[n].pollval = evl_intval(n);
+	}
+
+	/* A duplicate and a bad action fail, the rest is applied. */
+	vec[NR_SEMS] = vec[0];
+	vec[NR_SEMS + 1] = vec[1];
+	vec[NR_SEMS + 1].action = 42;
+
+	__Texpr_assert(evl_ctl_pollfds(pfd, vec, -1, status) == -EINVAL);
+	__Texpr_assert(evl_ctl_pollfds(pfd, vec, 0, status) == 0);
+	__Tcall_assert(ret, evl_ctl_pollfds(pfd, vec, NR_SEMS + 2, status));
+	__Texpr_assert(ret == 2);
+	for (n = 0; n < NR_SEMS; n++)
+		__Texpr_assert(status[n] == 0);
+	__Texpr_assert(status[NR_SEMS] == -EEXIST);
+	__Texpr_assert(status[NR_SEMS + 1] == -EINVAL);
+
+	__Tcall_assert(ret, evl_put_sem(sems + 7));
+	__Tcall_assert(ret, wait_events(pfd, pollset, NR_SEMS));
+	__Texpr_assert(ret == 1);
+	__Texpr_assert(pollset[0].fd == sfds[7]);
+	__Texpr_assert(pollset[0].pollval.lval == 7);
+
+	/* Change the pollvals of the even elements. */
+	for (n = 0; n < NR_SEMS / 2; n++) {
+		vec[n].action = EVL_POLL_CTLMOD;
+		vec[n].fd = sfds[n * 2];
+		vec[n].events = POLLIN;
+		vec[n].pollval = evl_intval(1000 + n * 2);
+	}
+
+	__Tcall_assert(ret, evl_ctl_pollfds(pfd, vec, NR_SEMS / 2, status));
+	__Texpr_assert(ret == 0);
+
+	__Tcall_assert(ret, evl_get_sem(sems + 7));
+	__Tcall_assert(ret, evl_put_sem(sems + 8));
+	__Tcall_assert(ret, wait_events(pfd, pollset, NR_SEMS));
+	__Texpr_assert(ret == 1);
+	__Texpr_assert(pollset[0].fd == sfds[8]);
+	__Texpr_assert(pollset[0].pollval.lval == 1008);
+	__Tcall_assert(ret, evl_get_sem(sems + 8));
+
+	for (n = 0; n < NR_SEMS; n++) {
+		vec[n].action = EVL_POLL_CTLDEL;
+		vec[n].fd = sfds[n];
+	}
+
+	__Tcall_assert(ret, evl_ctl_pollfds(pfd, vec, NR_SEMS, status));
+	__Texpr_assert(ret == 0);
+
+	__Tcall_assert(ret, evl_put_sem(sems + 9));
+	__Texpr_assert(wait_events(pfd, pollset, NR_SEMS) == -ETIMEDOUT);
+
+	for (n = 0; n < NR_SEMS; n++)
+		__Tcall_assert(ret, evl_close_sem(sems + n));
+
+	close(pfd);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/sem.h>
+#include <evl/clock.h>
+#include <evl/reactor.h>
+#include "helpers.h"
+
+#define LOW_PRIO   1
+#define HIGH_PRIO  2
+
+#define NR_TICKS   5
+
+static struct evl_reactor reactor;
+
+static struct evl_sem sem_low, sem_high;
+
+static struct evl_reactor_source src_low, src_high, oneshot, periodic;
+
+static struct evl_reactor_source *victim;
+
+static struct evl_reactor_call call;
+
+static int order[2], nr_dispatched;
+
+static int oneshot_count, periodic_ticks, deferred_count;
+
+static void handle_sem(struct evl_reactor_source *src,
+		unsigned int revents)
+{
+	struct evl_sem *sem = src->arg;
+	int ret;
+
+	__Texpr_assert(revents == POLLIN);
+	__Tcall_assert(ret, evl_get_sem(sem));
+	__Texpr_assert(nr_dispatched < 2);
+	order[nr_dispatched++] = src->prio;
+}
+
+/* Delete and free a source which is part of the same batch. */
+static void handle_killer(struct evl_reactor_source *src,
+			unsigned int revents)
+{
+	struct evl_sem *sem = src->arg;
+	int ret;
+
+	__Tcall_assert(ret, evl_get_sem(sem));
+	__Tcall_assert(ret, evl_del_reactor_source(victim));
+	free(victim);
+	victim = NULL;
+}
+
+static void handle_oneshot(struct evl_reactor_source *src,
+			unsigned int revents)
+{
+	__Texpr_assert(src->ticks == 1);
+	oneshot_count++;
+}
+
+static void handle_periodic(struct evl_reactor_source *src,
+			unsigned int revents)
+{
+	int ret;
+
+	__Texpr_assert(src->ticks >= 1);
+	periodic_ticks += src->ticks;
+
+	if (periodic_ticks >= NR_TICKS && deferred_count > 0) {
+		/* A source may remove itself from its own handler. */
+		__Tcall_assert(ret, evl_del_reactor_source(src));
+		evl_stop_reactor(&reactor);
+	}
+}
+
+static void run_deferred(struct evl_reactor_call *call)
+{
+	__Texpr_assert(call->arg == &reactor);
+	deferred_count++;
+}
+
+static void *deferrer(void *arg)
+{
+	int tfd, ret;
+
+	__Tcall_assert(tfd, evl_attach_self("reactor-deferrer:%d", getpid()));
+	__Tcall_assert(ret, evl_defer_reactor_call(&reactor, &call,
+						run_deferred, &reactor));
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec now, date, period, timeout;
+	int tfd, sfd_low, sfd_high, ret;
+	void *status = NULL;
+	pthread_t tid;
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("reactor-dispatch:%d", getpid()));
+
+	__Texpr_assert(evl_init_reactor(&reactor, 0) == -EINVAL);
+	__Tcall_assert(ret, evl_init_reactor(&reactor, 8));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(sfd_low, evl_new_sem(&sem_low, name));
+	name = get_unique_name(EVL_MONITOR_DEV, 1);
+	__Tcall_assert(sfd_high, evl_new_sem(&sem_high, name));
+
+	/*
+	 * Register the low priority source first, the high priority
+	 * one must be dispatched first nevertheless.
+	 */
+	__Tcall_assert(ret, evl_add_reactor_fd(&reactor, &src_low, sfd_low,
+					POLLIN, LOW_PRIO, handle_sem, &sem_low));
+	__Tcall_assert(ret, evl_add_reactor_fd(&reactor, &src_high, sfd_high,
+					POLLIN, HIGH_PRIO, handle_sem, &sem_high));
+	__Tcall_assert(ret, evl_put_sem(&sem_low));
+	__Tcall_assert(ret, evl_put_sem(&sem_high));
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 1000000000); /* 1s */
+	__Tcall_assert(ret, evl_run_reactor(&reactor, &timeout));
+	__Texpr_assert(ret == 2);
+	__Texpr_assert(nr_dispatched == 2);
+	__Texpr_assert(order[0] == HIGH_PRIO && order[1] == LOW_PRIO);
+
+	/* Nothing pending, we should time out. */
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 10000000); /* 10ms */
+	__Texpr_assert(evl_run_reactor(&reactor, &timeout) == -ETIMEDOUT);
+
+	/* A removed source is not dispatched anymore. */
+	__Tcall_assert(ret, evl_del_reactor_source(&src_low));
+	__Texpr_assert(evl_del_reactor_source(&src_low) == -EINVAL);
+	__Tcall_assert(ret, evl_put_sem(&sem_low));
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 10000000); /* 10ms */
+	__Texpr_assert(evl_run_reactor(&reactor, &timeout) == -ETIMEDOUT);
+	__Texpr_assert(nr_dispatched == 2);
+
+	/*
+	 * A handler may delete then free a source of lower priority
+	 * which is pending in the same batch.
+	 */
+	__Tcall_assert(ret, evl_del_reactor_source(&src_high));
+	victim = malloc(sizeof(*victim));
+	__Texpr_assert(victim != NULL);
+	__Tcall_assert(ret, evl_add_reactor_fd(&reactor, victim, sfd_high,
+					POLLIN, LOW_PRIO, handle_sem, &sem_high));
+	__Tcall_assert(ret, evl_add_reactor_fd(&reactor, &src_low, sfd_low,
+					POLLIN, HIGH_PRIO, handle_killer, &sem_low));
+	__Tcall_assert(ret, evl_put_sem(&sem_high));
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 1000000000); /* 1s */
+	__Tcall_assert(ret, evl_run_reactor(&reactor, &timeout));
+	__Texpr_assert(ret == 2);
+	__Texpr_assert(victim == NULL);
+	__Texpr_assert(nr_dispatched == 2);
+	__Tcall_assert(ret, evl_del_reactor_source(&src_low));
+	__Tcall_assert(ret, evl_get_sem(&sem_high));
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&date, &now, 5000000); /* 5ms */
+	period.tv_sec = 0;
+	period.tv_nsec = 5000000;
+	__Tcall_assert(ret, evl_add_reactor_timer(&reactor, &oneshot,
+					EVL_CLOCK_MONOTONIC, &date, NULL,
+					LOW_PRIO, handle_oneshot, NULL));
+	__Tcall_assert(ret, evl_add_reactor_timer(&reactor, &periodic,
+					EVL_CLOCK_MONOTONIC, &date, &period,
+					HIGH_PRIO, handle_periodic, NULL));
+
+	new_thread(&tid, SCHED_OTHER, 0, deferrer, NULL);
+
+	__Tcall_assert(ret, evl_loop_reactor(&reactor));
+	__Texpr_assert(pthread_join(tid, &status) == 0);
+
+	__Texpr_assert(oneshot_count == 1);
+	__Texpr_assert(periodic_ticks >= NR_TICKS);
+	__Texpr_assert(deferred_count == 1);
+
+	__Tcall_assert(ret, evl_close_reactor(&reactor));
+	__Tcall_assert(ret, evl_close_sem(&sem_high));
+	__Tcall_assert(ret, evl_close_sem(&sem_low));
+
+	return 0;
+}
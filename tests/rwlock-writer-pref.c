@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/compiler.h>
+#include <evl/atomic.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/rwlock.h>
+#include "helpers.h"
+
+#define LOW_PRIO	1
+#define HIGH_PRIO	2
+
+struct test_context {
+	struct evl_rwlock rwlock;
+	int written;
+};
+
+static void *rwlock_writer(void *arg)
+{
+	struct test_context *p = arg;
+	int ret, tfd;
+
+	__Tcall_assert(tfd, evl_attach_self("rwlock-writer:%d", getpid()));
+	__Tcall_assert(ret, evl_wrlock_rwlock(&p->rwlock));
+	atomic_store(&p->written, 1);
+	__Tcall_assert(ret, evl_unlock_rwlock(&p->rwlock));
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sched_param param;
+	struct test_context c;
+	void *status = NULL;
+	pthread_t writer;
+	int tfd, lfd, ret;
+	char *name;
+
+	param.sched_priority = HIGH_PRIO;
+	__Texpr_assert(pthread_setschedparam(pthread_self(),
+				SCHED_FIFO, &param) == 0);
+
+	__Tcall_assert(tfd, evl_attach_self("rwlock-writer-pref:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+
+	/* Only private locks are available. */
+	__Texpr_assert(evl_create_rwlock(&c.rwlock, EVL_CLOCK_MONOTONIC,
+				EVL_CLONE_PUBLIC, name) == -EINVAL);
+	__Texpr_assert(evl_create_rwlock(&c.rwlock, EVL_CLOCK_MONOTONIC,
+				EVL_CLONE_PRIVATE, "/%s", name) == -EINVAL);
+
+	__Tcall_assert(lfd, evl_new_rwlock(&c.rwlock, name));
+	c.written = 0;
+
+	/* Readers share the lock, exclusive of writers. */
+	__Tcall_assert(ret, evl_rdlock_rwlock(&c.rwlock));
+	__Tcall_assert(ret, evl_tryrdlock_rwlock(&c.rwlock));
+	__Texpr_assert(evl_trywrlock_rwlock(&c.rwlock) == -EAGAIN);
+	__Tcall_assert(ret, evl_unlock_rwlock(&c.rwlock));
+
+	/*
+	 * Once a writer waits for the readers to drain, new readers
+	 * are held off.
+	 */
+	new_thread(&writer, SCHED_FIFO, LOW_PRIO, rwlock_writer, &c);
+	__Tcall_assert(ret, evl_usleep(20000));
+	__Texpr_assert(atomic_load(&c.written) == 0);
+	__Texpr_assert(evl_tryrdlock_rwlock(&c.rwlock) == -EAGAIN);
+	__Tcall_assert(ret, evl_unlock_rwlock(&c.rwlock));
+
+	__Texpr_assert(pthread_join(writer, &status) == 0);
+	__Texpr_assert(status == NULL);
+	__Texpr_assert(atomic_load(&c.written) == 1);
+
+	__Tcall_assert(ret, evl_trywrlock_rwlock(&c.rwlock));
+	__Texpr_assert(evl_tryrdlock_rwlock(&c.rwlock) == -EAGAIN);
+	__Tcall_assert(ret, evl_unlock_rwlock(&c.rwlock));
+	__Tcall_assert(ret, evl_tryrdlock_rwlock(&c.rwlock));
+	__Tcall_assert(ret, evl_unlock_rwlock(&c.rwlock));
+
+	evl_close_rwlock(&c.rwlock);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/sem.h>
+#include "helpers.h"
+
+struct test_context {
+	struct evl_sem sem;
+	int done;
+};
+
+static void *sem_waiter(void *arg)
+{
+	struct test_context *p = arg;
+	struct timespec now, timeout;
+	int ret, tfd;
+
+	__Tcall_assert(tfd, evl_attach_self("sem-multi-waiter:%d.%ld",
+					getpid(), (long)pthread_self()));
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	timespec_add_ns(&timeout, &now, 2000000000); /* 2s */
+	__Tcall_assert(ret, evl_timedget_sem(&p->sem, &timeout));
+	__sync_fetch_and_add(&p->done, 1);
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct test_context c;
+	pthread_t waiters[2];
+	int tfd, sfd, ret, n;
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("sem-multi:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Tcall_assert(sfd, evl_new_sem(&c.sem, name));
+
+	/* Units are taken all at once, or not at all. */
+	__Tcall_assert(ret, evl_put_sem_n(&c.sem, 3));
+	__Texpr_assert(evl_tryget_sem_n(&c.sem, 4) == -EAGAIN);
+	__Tcall_assert(ret, evl_tryget_sem_n(&c.sem, 2));
+	__Tcall_assert(ret, evl_tryget_sem(&c.sem));
+	__Texpr_assert(evl_tryget_sem(&c.sem) == -EAGAIN);
+	__Texpr_assert(evl_tryget_sem_n(&c.sem, 0) == -EINVAL);
+	__Texpr_assert(evl_put_sem_n(&c.sem, 0) == -EINVAL);
+
+	/* A single multi-unit post releases as many waiters. */
+	c.done = 0;
+	for (n = 0; n < 2; n++)
+		new_thread(waiters + n, SCHED_FIFO, 1, sem_waiter, &c);
+
+	__Tcall_assert(ret, evl_usleep(10000));
+	__Tcall_assert(ret, evl_put_sem_n(&c.sem, 2));
+
+	for (n = 0; n < 2; n++)
+		pthread_join(waiters[n], NULL);
+
+	__Texpr_assert(c.done == 2);
+	__Texpr_assert(evl_tryget_sem(&c.sem) == -EAGAIN);
+
+	evl_close_sem(&c.sem);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/sem.h>
+#include "helpers.h"
+
+#define NR_SEMS  64
+#define NR_PUBLIC_SEMS  4
+
+static struct evl_sem sems[NR_SEMS];
+
+int main(int argc, char *argv[])
+{
+	struct evl_sem peer;
+	int tfd, ret, n;
+	char *name;
+
+	__Tcall_assert(tfd, evl_attach_self("sem-vec:%d", getpid()));
+
+	name = get_unique_name(EVL_MONITOR_DEV, 0);
+	__Texpr_assert(evl_create_sem_vec(sems, 0, EVL_CLOCK_MONOTONIC,
+					0, 0, name) == -EINVAL);
+	__Tcall_assert(ret, evl_create_sem_vec(sems, NR_SEMS,
+					EVL_CLOCK_MONOTONIC, 1, 0, name));
+
+	/* Every member must be a distinct semaphore. */
+	for (n = 0; n < NR_SEMS; n++)
+		__Tcall_assert(ret, evl_tryget_sem(sems + n));
+
+	for (n = 0; n < NR_SEMS; n++) {
+		__Texpr_assert(evl_tryget_sem(sems + n) == -EAGAIN);
+		__Tcall_assert(ret, evl_close_sem(sems + n));
+	}
+
+	/* Public members are named <name>.<index>. */
+	name = get_unique_name(EVL_MONITOR_DEV, 1);
+	__Tcall_assert(ret, evl_create_sem_vec(sems, NR_PUBLIC_SEMS,
+					EVL_CLOCK_MONOTONIC, 0,
+					EVL_CLONE_PUBLIC, name));
+	__Tcall_assert(ret, evl_open_sem(&peer, "%s.%d", name, 2));
+	__Tcall_assert(ret, evl_put_sem(&peer));
+	__Tcall_assert(ret, evl_tryget_sem(sems + 2));
+	__Tcall_assert(ret, evl_close_sem(&peer));
+	__Texpr_assert(evl_open_sem(&peer, "%s.%d", name,
+					NR_PUBLIC_SEMS) < 0);
+
+	for (n = 0; n < NR_PUBLIC_SEMS; n++)
+		__Tcall_assert(ret, evl_close_sem(sems + n));
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/mutex.h>
+#include <evl/sem.h>
+#include <evl/static.h>
+#include "helpers.h"
+
+#define NR_RACERS  4
+
+static struct evl_mutex lock =
+	EVL_MUTEX_INITIALIZER(NULL, EVL_CLOCK_MONOTONIC, 0, EVL_MUTEX_NORMAL);
+EVL_STATIC_ELEMENT(lock);
+
+static struct evl_sem presem =
+	EVL_SEM_INITIALIZER(NULL, EVL_CLOCK_MONOTONIC, 1, 0);
+EVL_STATIC_ELEMENT(presem);
+
+/* Not registered, created by the first racer. */
+static struct evl_sem racesem =
+	EVL_SEM_INITIALIZER(NULL, EVL_CLOCK_MONOTONIC, 0, 0);
+
+static struct evl_sem start;
+
+static void *racer(void *arg)
+{
+	long n = (long)arg;
+	int tfd, ret;
+
+	__Tcall_assert(tfd, evl_attach_self("static-racer:%d.%ld",
+						getpid(), n));
+	__Tcall_assert(ret, evl_get_sem(&start));
+	__Tcall_assert(ret, evl_put_sem(&racesem));
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t racers[NR_RACERS];
+	int tfd, ret;
+	long n;
+
+	__Tcall_assert(tfd, evl_attach_self("static-elements:%d", getpid()));
+	__Tcall_assert(ret, evl_init_static_elements());
+
+	__Tcall_assert(ret, evl_lock_mutex(&lock));
+	__Tcall_assert(ret, evl_unlock_mutex(&lock));
+	__Tcall_assert(ret, evl_tryget_sem(&presem));
+	__Texpr_assert(evl_tryget_sem(&presem) == -EAGAIN);
+
+	/* Racing on first use must yield a single element. */
+	__Tcall_assert(ret, evl_new_sem(&start, "static-start:%d", getpid()));
+
+	for (n = 0; n < NR_RACERS; n++)
+		__Texpr_assert(pthread_create(racers + n, NULL,
+						racer, (void *)n) == 0);
+
+	for (n = 0; n < NR_RACERS; n++)
+		__Tcall_assert(ret, evl_put_sem(&start));
+
+	for (n = 0; n < NR_RACERS; n++)
+		pthread_join(racers[n], NULL);
+
+	for (n = 0; n < NR_RACERS; n++)
+		__Tcall_assert(ret, evl_tryget_sem(&racesem));
+	__Texpr_assert(evl_tryget_sem(&racesem) == -EAGAIN);
+
+	evl_close_sem(&start);
+	evl_close_sem(&racesem);
+	evl_close_sem(&presem);
+	evl_close_mutex(&lock);
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/poll.h>
+#include <evl/wheel.h>
+#include "helpers.h"
+
+#define NR_TIMERS     1000
+#define RESOLUTION    100000	/* 100us */
+#define SPREAD_MS     500	/* Reaches the third level of the wheel */
+#define NR_PERIODS    10
+
+struct test_timer {
+	struct evl_wheel_timer timer;
+	struct timespec date;
+	int fired;
+	int stopped;
+};
+
+static struct test_timer timers[NR_TIMERS], periodic;
+
+static int nr_fired;
+
+static int timespec_before(const struct timespec *t1,
+			const struct timespec *t2)
+{
+	if (t1->tv_sec != t2->tv_sec)
+		return t1->tv_sec < t2->tv_sec;
+
+	return t1->tv_nsec < t2->tv_nsec;
+}
+
+static void handle_timer(struct evl_wheel_timer *timer)
+{
+	struct test_timer *t = timer->arg;
+	struct timespec now;
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+	__Texpr_assert(!timespec_before(&now, &t->date));
+	__Texpr_assert(!t->stopped);
+	__Texpr_assert(!evl_wheel_timer_pending(timer));
+	t->fired++;
+	nr_fired++;
+}
+
+static void handle_periodic(struct evl_wheel_timer *timer)
+{
+	struct test_timer *t = timer->arg;
+
+	__Texpr_assert(evl_wheel_timer_pending(timer));
+
+	if (++t->fired == NR_PERIODS)
+		evl_stop_wheel_timer(timer);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec now, date, interval, timeout;
+	int tfd, wfd, pfd, ret, n, expected = 0;
+	struct evl_poll_event pollset;
+	struct evl_timer_wheel wheel;
+
+	__Tcall_assert(tfd, evl_attach_self("timer-wheel:%d", getpid()));
+
+	__Texpr_assert(evl_init_timer_wheel(&wheel,
+				EVL_CLOCK_MONOTONIC, 0) == -EINVAL);
+	__Tcall_assert(wfd, evl_init_timer_wheel(&wheel,
+				EVL_CLOCK_MONOTONIC, RESOLUTION));
+	__Tcall_assert(pfd, evl_new_poll());
+	__Tcall_assert(ret, evl_add_pollfd(pfd, wfd, POLLIN, evl_nil));
+
+	evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+
+	for (n = 0; n < NR_TIMERS; n++) {
+		evl_init_wheel_timer(&timers[n].timer, handle_timer, timers + n);
+		timespec_add_ns(&timers[n].date, &now,
+				(n % SPREAD_MS + 1) * 1000000ULL);
+		__Tcall_assert(ret, evl_start_wheel_timer(&wheel,
+				&timers[n].timer, &timers[n].date, NULL));
+		__Texpr_assert(evl_wheel_timer_pending(&timers[n].timer));
+	}
+
+	/* Stop every third timer, push back every fifth. */
+	for (n = 0; n < NR_TIMERS; n++) {
+		if (n % 3 == 0) {
+			evl_stop_wheel_timer(&timers[n].timer);
+			__Texpr_assert(!evl_wheel_timer_pending(&timers[n].timer));
+			timers[n].stopped = 1;
+			continue;
+		}
+		if (n % 5 == 0) {
+			date = timers[n].date;
+			timespec_add_ns(&timers[n].date, &date,
+					100000000); /* 100ms */
+			__Tcall_assert(ret, evl_start_wheel_timer(&wheel,
+				&timers[n].timer, &timers[n].date, NULL));
+		}
+		expected++;
+	}
+
+	evl_init_wheel_timer(&periodic.timer, handle_periodic, &periodic);
+	timespec_add_ns(&date, &now, 1000000); /* 1ms */
+	interval.tv_sec = 0;
+	interval.tv_nsec = 2000000; /* 2ms */
+	__Tcall_assert(ret, evl_start_wheel_timer(&wheel, &periodic.timer,
+						&date, &interval));
+
+	while (nr_fired < expected || periodic.fired < NR_PERIODS) {
+		evl_read_clock(EVL_CLOCK_MONOTONIC, &now);
+		timespec_add_ns(&timeout, &now, 2000000000); /* 2s */
+		__Tcall_assert(ret, evl_timedpoll(pfd, &pollset, 1, &timeout));
+		__Texpr_assert(ret == 1);
+		__Texpr_assert(pollset.fd == wfd);
+		__Tcall_assert(ret, evl_run_timer_wheel(&wheel));
+	}
+
+	for (n = 0; n < NR_TIMERS; n++)
+		__Texpr_assert(timers[n].fired == !timers[n].stopped);
+
+	__Texpr_assert(nr_fired == expected);
+	__Texpr_assert(periodic.fired == NR_PERIODS);
+	__Texpr_assert(!evl_wheel_timer_pending(&periodic.timer));
+
+	__Tcall_assert(ret, evl_close_timer_wheel(&wheel));
+	close(pfd);
+
+	return 0;
+}
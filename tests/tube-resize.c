@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Grow and shrink a heap-backed tube.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <evl/thread.h>
+#include <evl/heap.h>
+#include <evl/tube.h>
+#include "helpers.h"
+
+#define HEAP_SIZE  8192
+
+DECLARE_EVL_CANISTER(long_canister, long);
+DECLARE_EVL_TUBE(tube_type, long_canister);
+
+static char heap_mem[EVL_HEAP_RAW_SIZE(HEAP_SIZE)];
+
+int main(int argc, char *argv[])
+{
+	struct tube_type *tube;
+	struct evl_heap heap;
+	size_t free_mem;
+	long val, n;
+	bool ok;
+	int tfd, ret;
+
+	__Tcall_assert(tfd, evl_attach_self("tube-resize:%d", getpid()));
+	__Tcall_assert(ret, evl_init_heap(&heap, heap_mem, sizeof(heap_mem)));
+
+	tube = evl_create_tube(tube_type, &heap, 2);
+	__Texpr_assert(tube != NULL);
+	free_mem = evl_heap_size(&heap) - evl_heap_used(&heap);
+
+	/* An idle tube can release all of its canisters. */
+	ret = evl_resize_tube(tube, &heap, 0);
+	__Texpr_assert(ret == 0);
+	ok = evl_send_tube(tube, 1);
+	__Texpr_assert(!ok);
+	ret = evl_resize_tube(tube, &heap, 2);
+	__Texpr_assert(ret == 2);
+	__Texpr_assert(evl_heap_size(&heap) - evl_heap_used(&heap) == free_mem);
+
+	/* Pending messages pin their canisters. */
+	ok = evl_send_tube(tube, 1);
+	__Texpr_assert(ok);
+	ok = evl_send_tube(tube, 2);
+	__Texpr_assert(ok);
+	ret = evl_resize_tube(tube, &heap, 1);
+	__Texpr_assert(ret == -EAGAIN);
+	__Texpr_assert(tube->max_items == 2);
+
+	/* A failed grow leaves the capacity unchanged. */
+	ret = evl_resize_tube(tube, &heap, HEAP_SIZE);
+	__Texpr_assert(ret == -ENOMEM);
+	__Texpr_assert(tube->max_items == 2);
+	__Texpr_assert(evl_heap_size(&heap) - evl_heap_used(&heap) == free_mem);
+
+	ret = evl_resize_tube(tube, &heap, 16);
+	__Texpr_assert(ret == 16);
+	for (n = 3; n <= 16; n++) {
+		ok = evl_send_tube(tube, n);
+		__Texpr_assert(ok);
+	}
+	ok = evl_send_tube(tube, n);
+	__Texpr_assert(!ok);
+
+	for (n = 1; n <= 16; n++) {
+		ok = evl_receive_tube(tube, val);
+		__Texpr_assert(ok);
+		__Texpr_assert(val == n);
+	}
+
+	/* Canisters have moved between queues, shrink again. */
+	ret = evl_resize_tube(tube, &heap, 1);
+	__Texpr_assert(ret == 1);
+	ok = evl_send_tube(tube, 42);
+	__Texpr_assert(ok);
+	ok = evl_send_tube(tube, 43);
+	__Texpr_assert(!ok);
+	ok = evl_receive_tube(tube, val);
+	__Texpr_assert(ok);
+	__Texpr_assert(val == 42);
+
+	evl_destroy_tube(tube, &heap);
+	__Texpr_assert(evl_heap_used(&heap) == 0);
+
+	return 0;
+}
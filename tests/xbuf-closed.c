@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that a closed xbuf is released, and that its file descriptor
+ * is served by the new file once recycled.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <evl/thread.h>
+#include <evl/xbuf.h>
+#include <evl/syscall.h>
+#include "helpers.h"
+
+static int count_fds(void)
+{
+	struct dirent *de;
+	int count = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/fd");
+	if (dir == NULL)
+		return -errno;
+
+	while ((de = readdir(dir)) != NULL)
+		if (de->d_name[0] != '.')
+			count++;
+
+	closedir(dir);
+
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	int tfd, xfd, fd, nfds;
+	char buf[4];
+	ssize_t ret;
+
+	__Tcall_assert(tfd, evl_attach_self("xbuf-closed:%d", getpid()));
+	__Tcall_assert(nfds, count_fds());
+
+	/* Creating a new xbuf releases the closed ones. */
+	__Tcall_assert(xfd, evl_new_xbuf(1024, "xbuf-closed.0:%d", getpid()));
+	__Tcall_errno_assert(ret, close(xfd));
+	__Tcall_assert(xfd, evl_new_xbuf(1024, "xbuf-closed.1:%d", getpid()));
+	__Tcall_errno_assert(ret, write(xfd, "ABCD", 4));
+	__Tcall_errno_assert(ret, oob_read(xfd, buf, 4));
+	__Texpr_assert(ret == 4 && buf[0] == 'A' && buf[3] == 'D');
+	__Tcall_errno_assert(ret, close(xfd));
+
+	/* The descriptor now refers to a different file. */
+	__Tcall_errno_assert(fd, open("/dev/null", O_RDONLY));
+	__Texpr_assert(fd == xfd);
+	__Tcall_errno_assert(ret, oob_read(fd, buf, 3));
+	__Texpr_assert(ret == 0);
+	__Tcall_errno_assert(ret, close(fd));
+
+	/* Nothing should be left behind. */
+	__Texpr_assert(count_fds() == nfds);
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Check that non-blocking out-of-band writes to an xbuf queue a
+ * message as a whole, or not at all.
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <evl/thread.h>
+#include <evl/xbuf.h>
+#include <evl/syscall.h>
+#include "helpers.h"
+
+#define RING_SIZE  1024
+
+int main(int argc, char *argv[])
+{
+	char msg[RING_SIZE * 2], buf[RING_SIZE * 2];
+	int tfd, xfd;
+	ssize_t ret;
+
+	__Tcall_assert(tfd, evl_attach_self("xbuf-nonblock:%d", getpid()));
+	__Tcall_assert(xfd, evl_create_xbuf(RING_SIZE, RING_SIZE,
+				EVL_CLONE_PRIVATE|EVL_CLONE_NONBLOCK,
+				"xbuf-nonblock:%d", getpid()));
+	memset(msg, 'x', sizeof(msg));
+
+	/* No message may exceed the ring. */
+	ret = oob_write(xfd, msg, RING_SIZE + 1);
+	__Texpr_assert(ret < 0 && errno == EFBIG);
+
+	/* The ring cannot hold a second message. */
+	__Tcall_errno_assert(ret, oob_write(xfd, msg, RING_SIZE * 3 / 4));
+	__Texpr_assert(ret == RING_SIZE * 3 / 4);
+	ret = oob_write(xfd, msg, RING_SIZE / 2);
+	__Texpr_assert(ret < 0 && errno == EAGAIN);
+
+	/* Nothing from the failed write was queued. */
+	__Tcall_errno_assert(ret, read(xfd, buf, sizeof(buf)));
+	__Texpr_assert(ret == RING_SIZE * 3 / 4);
+	ret = read(xfd, buf, sizeof(buf));
+	__Texpr_assert(ret < 0 && errno == EAGAIN);
+
+	/* Room is back once the reader consumed the first one. */
+	__Tcall_errno_assert(ret, oob_write(xfd, msg, RING_SIZE / 2));
+	__Texpr_assert(ret == RING_SIZE / 2);
+	__Tcall_errno_assert(ret, read(xfd, buf, sizeof(buf)));
+	__Texpr_assert(ret == RING_SIZE / 2);
+
+	close(xfd);
+
+	return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * Dump the lock statistics collected by a process for its mutexes
+ * created with EVL_MUTEX_LOCKSTAT.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <dirent.h>
+#include <error.h>
+#include <errno.h>
+#include <evl/lockstat.h>
+
+#define short_optlist "@hH"
+
+static const struct option options[] = {
+	{
+		.name = "histograms",
+		.has_arg = no_argument,
+		.val = 'H',
+	},
+	{
+		.name = "help",
+		.has_arg = no_argument,
+		.val = 'h',
+	},
+	{ /* Sentinel */ }
+};
+
+static bool show_histograms;
+
+static void print_histogram(const char *title, const __u64 *hist)
+{
+	unsigned long long lo, hi;
+	int n;
+
+	printf("  %s:\n", title);
+
+	for (n = 0; n < EVL_LOCKSTAT_HIST_SIZE; n++) {
+		if (hist[n] == 0)
+			continue;
+		lo = n ? 1ULL << (n + EVL_LOCKSTAT_HIST_SHIFT) : 0;
+		hi = 1ULL << (n + EVL_LOCKSTAT_HIST_SHIFT + 1);
+		if (n == EVL_LOCKSTAT_HIST_SIZE - 1)
+			printf("    %10llu ns - %12s : %llu\n", lo, "",
+				(unsigned long long)hist[n]);
+		else
+			printf("    %10llu ns - %10llu ns : %llu\n", lo, hi,
+				(unsigned long long)hist[n]);
+	}
+}
+
+static bool match_name(const char *name, int argc, char *const argv[])
+{
+	int n;
+
+	if (argc == 0)
+		return true;
+
+	for (n = 0; n < argc; n++)
+		if (!strcmp(name, argv[n]))
+			return true;
+
+	return false;
+}
+
+static int dump_process(pid_t pid, int argc, char *const argv[])
+{
+	const struct evl_lockstat_file *file;
+	struct evl_lockstat sum;
+	char shm[32];
+	int fd, slot;
+
+	snprintf(shm, sizeof(shm), EVL_LOCKSTAT_SHM_FMT, pid);
+	fd = shm_open(shm, O_RDONLY, 0);
+	if (fd < 0)
+		return -errno;
+
+	file = mmap(NULL, sizeof(*file), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED)
+		return -errno;
+
+	if (file->magic != EVL_LOCKSTAT_MAGIC) {
+		munmap((void *)file, sizeof(*file));
+		return -EINVAL;
+	}
+
+	printf("PID %d\n", pid);
+	if (file->dropped_mutexes || file->dropped_rows)
+		printf("  not accounted: %u mutex(es), %u thread(s)\n",
+			file->dropped_mutexes, file->dropped_rows);
+	printf("%-32s %12s %12s %10s %10s %10s\n",
+		"NAME", "FAST", "SLOW", "TRYFAIL", "RECURSE", "PPSLOW");
+
+	for (slot = 0; slot < EVL_LOCKSTAT_MAX_MUTEXES; slot++) {
+		if (file->names[slot][0] == '\0' ||
+			!match_name(file->names[slot], argc, argv))
+			continue;
+		evl_sum_lockstat(file, slot, &sum);
+		printf("%-32.*s %12llu %12llu %10llu %10llu %10llu\n",
+			EVL_LOCKSTAT_NAMELEN, file->names[slot],
+			(unsigned long long)sum.fast,
+			(unsigned long long)sum.slow,
+			(unsigned long long)sum.trylock_failed,
+			(unsigned long long)sum.recursive,
+			(unsigned long long)sum.pp_slow);
+		if (show_histograms) {
+			print_histogram("wait", sum.wait_hist);
+			print_histogram("hold", sum.hold_hist);
+		}
+	}
+
+	munmap((void *)file, sizeof(*file));
+
+	return 0;
+}
+
+static int dump_all(int argc, char *const argv[])
+{
+	struct dirent *de;
+	int pid, count = 0;
+	DIR *dir;
+
+	dir = opendir("/dev/shm");
+	if (dir == NULL)
+		return -errno;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (sscanf(de->d_name, "evl-lockstat.%d", &pid) != 1)
+			continue;
+		if (dump_process(pid, argc, argv) == 0)
+			count++;
+	}
+
+	closedir(dir);
+
+	return count ? 0 : -ENOENT;
+}
+
+static void usage(char *arg0)
+{
+        fprintf(stderr, "usage: %s [options] [<pid> [<mutex-name>...]]:\n",
+		basename(arg0));
+        fprintf(stderr, "-H --histograms        display wait and hold time histograms\n");
+        fprintf(stderr, "-h --help              this help\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	char *endp;
+	pid_t pid;
+	int c, ret;
+
+	opterr = 0;
+
+	for (;;) {
+		c = getopt_long(argc, argv, short_optlist, options, NULL);
+		if (c == EOF)
+			break;
+
+		switch (c) {
+		case 'H':
+			show_histograms = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		case '@':
+			printf("report lock statistics of EVL mutexes\n");
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind == argc) {
+		ret = dump_all(0, NULL);
+		if (ret)
+			error(1, -ret, "no lock statistics available");
+		return 0;
+	}
+
+	pid = strtol(argv[optind], &endp, 10);
+	if (*endp || pid <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ret = dump_process(pid, argc - optind - 1, argv + optind + 1);
+	if (ret)
+		error(1, -ret, "cannot read lock statistics of pid %d", pid);
+
+	return 0;
+}